@@ -23,6 +23,8 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 
 #include "spio_win.h"
 #include "alia_act.h"
@@ -43,6 +45,20 @@ int jhcBaijiuAct::Setup ()
   mapy = 0.0;
   ang  = 0.0;
   sf   = 1.0;
+  rot0 = 0.0;
+  rdone = 0;
+  bump0 = 0;
+  stuck = 0;
+  *spec = '\0';
+  sp = spec;
+  early = 0.8;
+  yn_end = 300;
+  barge = 1;
+  wake = 0;
+  nvis = 0;
+  vlen = 0;
+  vt0 = 0;
+  shape = -1;
   return 1;
 }
 
@@ -56,11 +72,13 @@ int jhcBaijiuAct::Setup ()
 
 int jhcBaijiuAct::Launch ()
 {
+  const char *rname = "Waldo Baijiu";
+
   // whistle to user after Bluetooth connected
   R2D2();
 
   // start reasoning engine (builds name list)
-  if (alia_reset(NULL, "Waldo Baijiu", "baijiu_act") <= 0)
+  if (alia_reset(NULL, rname, "baijiu_act") <= 0)
   {
     printf("  Problem with ALIA !\n");
     return 0;
@@ -73,6 +91,10 @@ int jhcBaijiuAct::Launch ()
     printf("  Problem with speech !\n");
     return 0;
   }
+
+  // possibly stream audio only after hearing robot name
+  if ((wake > 0) && (reco_wake(rname) <= 0))
+    printf("  No wake word spotter - always listening\n");
   return 1;
 }
 
@@ -129,15 +151,128 @@ void jhcBaijiuAct::set_commands ()
 ///////////////////////////////////////////////////////////////////////////
 
 //= Get any speech recognition results and set status flag.
+// can send a stable partial hypothesis before final result arrives, but only
+// if it is a complete sentence since ALIA cannot take back anything sent
+// final result then only passes along words not already sent (never resent)
+// user speaking over robot cuts off its current output (if barge-in allowed)
+// keeps full recognition running while ALIA is attending (if wake word gated)
 
 void jhcBaijiuAct::reco_update ()
 {
+  const char *msg, *rest;
+  float stab;
+
+  reco_attn(alia_attn);
   if ((alia_hear = reco_status()) == 2)
-    alia_spin(reco_heard(), reco_delay());
+  {
+    // full result (possibly confirming early words)
+    msg = reco_heard();
+    if ((barge > 0) && (shape >= 0))
+    {
+      tts_say();
+      nvis = 0;
+      shape = -1;
+    }
+    if ((rest = spec_rest(msg)) == NULL)
+      alia_spin(msg, reco_delay());
+    else if (*rest != '\0')
+      alia_spin(rest, reco_delay());
+  }
+  else if (alia_hear <= 0)
+    *spec = '\0';                                             // never confirmed
+  else if ((early > 0.0) && (*spec == '\0'))
+  {
+    // speculative dispatch if hypothesis is a settled sentence
+    msg = reco_partial(&stab);
+    if ((stab >= early) && (sentence(msg) > 0))
+    {
+      alia_spin(msg, reco_delay());
+      strcpy_s(spec, msg);
+      sp = spec;
+    }
+  }
+}
+
+
+//= See if final result agrees with words already sent early.
+// a run-on final arrives in chunks so speculative text may span several calls
+// early text was a whole sentence so any extra words start a new one
+// if recognizer changed its mind the final is dropped (early text already acted on)
+// returns remainder of msg not already sent, NULL if nothing sent early
+
+const char *jhcBaijiuAct::spec_rest (const char *msg)
+{
+  char w0[80], w1[80];
+  const char *m = msg, *m2, *s2;
+
+  if (*spec == '\0')
+    return NULL;
+  while (1)
+  {
+    // all words sent early now confirmed
+    s2 = next_word(w0, 80, sp);
+    if (*w0 == '\0')
+      break;
+
+    // all of this chunk matched (maybe more chunks later)
+    m2 = next_word(w1, 80, m);
+    if (*w1 == '\0')
+      return m2;
+
+    // recognizer changed its mind (cannot retract earlier words)
+    if (strcmp(w0, w1) != 0)
+    {
+      printf("  [early \"%s\" not confirmed by \"%s\"]\n", spec, msg);
+      *spec = '\0';
+      return "";
+    }
+    sp = s2;
+    m = m2;
+  }
+
+  // skip punctuation before any extra words
+  *spec = '\0';
+  while (ispunct((unsigned char) *m) || isspace((unsigned char) *m))
+    m++;
+  return m;
+}
+
+
+//= Tell if text is one or more complete sentences (ends with punctuation).
+
+int jhcBaijiuAct::sentence (const char *txt) const
+{
+  const char *end = txt + strlen(txt);
+
+  while ((end > txt) && isspace((unsigned char) end[-1]))
+    end--;
+  return(((end > txt) && (strchr(".?!", end[-1]) != NULL)) ? 1 : 0);
+}
+
+
+//= Get next word in lowercase without punctuation.
+// returns pointer to character after word, word is empty if none left
+
+const char *jhcBaijiuAct::next_word (char *word, int wsz, const char *src) const
+{
+  const char *s = src;
+  int n = 0;
+
+  while ((*s != '\0') && !isalnum((unsigned char) *s))
+    s++;
+  while ((*s != '\0') && (isalnum((unsigned char) *s) || (*s == '\'')))
+  {
+    if (n < (wsz - 1))
+      word[n++] = (char) tolower((unsigned char) *s);
+    s++;
+  }
+  word[n] = '\0';
+  return s;
 }
 
 
 //= Possibly speak output text and set status flag. 
+// expects a quick answer after a yes/no question
 
 void jhcBaijiuAct::tts_issue ()
 {
@@ -145,8 +280,70 @@ void jhcBaijiuAct::tts_issue ()
 
   output = alia_spout();
   if (*output != '\0')
+  {
     tts_say(output);
-  alia_talk = ((tts_status() > 0) ? 1 : 0);
+    reco_endpoint((yes_no(output) > 0) ? yn_end : 0);
+    nvis = -1;
+  }
+  shape = mouth_shape();
+  alia_talk = ((shape >= 0) ? 1 : 0);
+}
+
+
+//= Determine if output is a question that can be answered by yes or no.
+// checks for question mark at end and auxiliary verb at start
+
+int jhcBaijiuAct::yes_no (const char *msg) const
+{
+  const char *aux[] = {"is", "are", "am", "was", "were", "do", "does", "did", "have", "has",
+                       "can", "could", "will", "would", "shall", "should", "may", "might"};
+  char first[80];
+  const char *end = msg + strlen(msg);
+  int i;
+
+  while ((end > msg) && isspace((unsigned char) end[-1]))
+    end--;
+  if ((end <= msg) || (end[-1] != '?'))
+    return 0;
+  next_word(first, 80, msg);
+  for (i = 0; i < 18; i++)
+    if (strcmp(first, aux[i]) == 0)
+      return 1;
+  return 0;
+}
+
+
+//= Determine current mouth shape of utterance being spoken.
+// gets whole viseme timeline once playback starts then just checks clock
+// only polls TTS status if timeline is not available (direct speech)
+// returns viseme number (0 = silence), -1 if not talking
+
+int jhcBaijiuAct::mouth_shape ()
+{
+  unsigned long t;
+  int i, ago;
+
+  // possibly get timeline for new utterance
+  if (nvis < 0)
+  {
+    if ((nvis = tts_timeline(vt, vis, 500, &vlen, &ago)) < 0)
+      return(tts_status() - 1);
+    vt0 = timeGetTime() - ago;
+  }
+
+  // find last viseme started (if not finished)
+  if (nvis == 0)
+    return -1;
+  t = timeGetTime() - vt0;
+  if (t >= (unsigned long) vlen)
+  {
+    nvis = 0;
+    return -1;
+  }
+  for (i = nvis - 1; i > 0; i--)
+    if ((unsigned long) vt[i] <= t)
+      break;
+  return vis[i];
 }
 
 
@@ -168,12 +365,12 @@ void jhcBaijiuAct::body_update ()
 
 void jhcBaijiuAct::body_issue ()
 {
-  int shape;
-
-  // get talking status and possibly mute microphone input
-  shape = tts_status() - 1;
-  alia_talk = ((shape >= 0) ? 1 : 0);
-  reco_mute(shape + 1);
+  // mute microphone while talking unless echo of phrase is being removed
+  // (no timeline means speaking directly so no echo reference)
+  if ((barge <= 0) || (nvis < 0))
+    reco_mute(shape + 1);
+  else
+    reco_mute(0);
 
   // bright diamond if vowel (visemes 1-11, w -> 7) else dim
   if ((shape >= 1) && (shape <= 11) && (shape != 7))        
@@ -317,20 +514,74 @@ void jhcBaijiuAct::base_update ()
   alia_bx = (float) mapx;
   alia_by = (float) mapy;
   alia_bh = (float) ang;
+  base_stuck();
+}
+
+
+//= Note transient stuck status after sonar reflex stops base at an obstacle.
+// stays stuck until path ahead is clear (e.g. obstacle moved or robot turned)
+// ALIA has no blocked input so it just sees alia_bx and alia_by not advance
+// NOTE: base is not broken - turns and backing up are still allowed
+
+void jhcBaijiuAct::base_stuck ()
+{
+  int now = stuck;
+
+  if (Bumps() != bump0)
+  {
+    bump0 = Bumps();
+    now = 1;
+  }
+  else if ((Blocked() <= 0) && (Sonar() >= sstop + sclr))
+    now = 0;
+  if (now == stuck)
+    return;
+  stuck = now;
+  printf("  [base %s at %3.1f in]\n", ((stuck > 0) ? "stuck" : "free"), Sonar());
 }
 
 
 //= Set wheel velocities based on rate and sign of incremental amount.
+// pure rotations use closed-loop heading servo to reach requested angle
+// servo uses same summed odometry as alia_bh so both agree when finished
+// reverts to open-loop rotation if ALIA still wants more after a while
 
 void jhcBaijiuAct::base_issue ()
 {
   double ips, dps, msp = 5.0, tsp = 90.0;                
+  int settle = 500;
 
+  // open-loop translation and rotation speeds
   ips = msp * alia_bmv * sf;
   if (alia_bmt < 0.0)
     ips = -ips;
   dps = tsp * alia_brv * sf;
   if (alia_brt < 0.0)
     dps = -dps;
+
+  // start new heading goal if turn request grows or reverses
+  if ((ips != 0.0) || (dps == 0.0))
+  {
+    Turn(0.0, 0.0);
+    rot0 = 0.0;
+    rdone = 0;
+  }
+  else
+  {
+    if ((alia_brt * rot0 <= 0.0) || (fabs(alia_brt) > fabs(rot0) + 1.0))
+    {
+      Turn(alia_brt, fabs(dps));
+      rdone = 0;
+    }
+    if (Turning() <= 0)
+    {
+      // goal reached so hold still unless request persists (ms)
+      if (rdone == 0)
+        rdone = timeGetTime();
+      if ((int)(timeGetTime() - rdone) < settle)
+        dps = 0.0;
+    }
+    rot0 = alia_brt;
+  }
   Drive(ips, dps);
 }
@@ -37,12 +37,46 @@ private:
   // mood-based speed factor
   double sf;
 
+  // last rotation request and when heading servo finished it
+  double rot0;
+  unsigned long rdone;
+
+  // sonar reflex stops seen and whether base is currently stuck
+  int bump0, stuck;
+
+  // words sent early from partial hypothesis not yet confirmed
+  char spec[500];
+  const char *sp;
+
+  // mouth shape timeline of current utterance (nvis < 0 if not known yet)
+  int vt[500], vis[500], nvis, vlen;
+  unsigned long vt0;
+  int shape;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // partial hypothesis stability for early dispatch (0 = never)
+  double early;
+
+  // end of speech silence after a yes/no question (ms)
+  int yn_end;
+
+  // whether user can interrupt robot (else mic muted while talking)
+  int barge;
+
+  // whether full recognition needs robot name first (unless attending)
+  int wake;
+
 
 // PUBLIC MEMBER FUNCTIONS
 public:
   // creation and initialization
   int Setup ();
 
+  // transient base status
+  int Stuck () const {return stuck;}
+
 
 // PROTECTED MEMBER FUNCTIONS
 protected:
@@ -50,17 +84,22 @@ protected:
   int Launch ();
   int Respond ();
   void Cleanup ();
+  virtual void get_sensors ();
 
 
 // PRIVATE MEMBER FUNCTIONS
 private:
   // primary loop 
-  void get_sensors ();
   void set_commands ();
 
   // speech
   void reco_update ();
+  const char *spec_rest (const char *msg);
+  int sentence (const char *txt) const;
+  const char *next_word (char *word, int wsz, const char *src) const;
   void tts_issue ();
+  int yes_no (const char *msg) const;
+  int mouth_shape ();
 
   // body
   void body_update ();
@@ -75,6 +114,7 @@ private:
 
   // base
   void base_update ();
+  void base_stuck ();
   void base_issue ();
 
 };
@@ -1,4 +1,4 @@
-// jhcQtCamCal.cpp : interactive extrinsic camera calibration for Qtruck robot
+// jhcQtCamCal.cpp : automatic camera calibration for Qtruck robot
 //
 // Written by Jonathan H. Connell, jconnell@alum.mit.edu
 //
@@ -47,10 +47,25 @@ jhcQtCamCal::~jhcQtCamCal ()
 jhcQtCamCal::jhcQtCamCal ()
 {
   img = new unsigned char [3 * 640 * 480];
+  nobs = 0;
   step = 0;
-  np = 0;
+  pose = 0;
   trial = 0;
   wait = 0;
+  vx0 = -1000.0;
+  vy0 = -1000.0;
+
+  // red mark location
+  mx = 0.0;                  // centered (in)
+  my = 9.0;                  // in front of body center (in)
+
+  // gaze sweep (15 poses)
+  p0 = -30.0;                // leftmost pan (deg)
+  p1 =  30.0;                // rightmost pan (deg)
+  np = 5;                    // pan steps
+  t0 = -45.0;                // lowest tilt (deg)
+  t1 = -25.0;                // highest tilt (deg)
+  nt = 3;                    // tilt steps
 }
 
 
@@ -65,10 +80,9 @@ int jhcQtCamCal::Setup ()
     printf("  No video stream -- is wifi set to HW_ESP32Cam?\n");
     return 0;
   }
-  ocv_warp(0.7, -11.0);
 
   // make a window to display video
-  ocv_win(0, "Marked Points", 20, 50);
+  ocv_win(0, "Calibration Mark", 20, 50);
   return 1;
 }
 
@@ -82,7 +96,18 @@ int jhcQtCamCal::Setup ()
 
 int jhcQtCamCal::Launch ()
 {
-  printf("\nCamera extrinsic calibration (click R to abort)\n");
+  printf("\nCamera calibration (click R to abort)\n");
+  printf("  Show red dot grid at several angles and places (any key when done or to skip) ...\n");
+
+  // start from any existing lens values but look at raw images
+  lens.r2f = lr2f;
+  lens.r4f = lr4f;
+  lens.mag = lmag;
+  lens.asp = lasp;
+  lens.dx  = ldx;
+  lens.dy  = ldy;
+  lens.Clear();
+  ocv_warp(0.0);
   return 1;
 }
 
@@ -93,23 +118,23 @@ int jhcQtCamCal::Launch ()
 
 int jhcQtCamCal::Respond ()
 {
-  // run loop at about 30 Hz and keep refreshing image
-  if (step >= 2)
+  // run at camera frame rate during data collection, else about 30 Hz
+  if ((step != 0) && (step != 2))
     Pace();
   else if (ocv_get(img, 1) <= 0)
     return -1;
   ocv_queue(0, img);
   ocv_show(); 
 
-  // progress through point designation and analysis
+  // progress through data collection and analysis
   switch (step)
   {
     case 0:
-      return lower_hand();
+      return lens_views();
     case 1:
-      return close_hand();
+      return lens_fit();
     case 2:
-      return mark_points();
+      return sweep_gaze();
     case 3:
       return compute_calib();
     case 4:
@@ -120,93 +145,214 @@ int jhcQtCamCal::Respond ()
 }     
 
 
-//= Move hand near floor so camera gazing downward.
-// reads robot sensors and generates commands
+//= Collect dot grid views from raw images until key hit or enough gathered.
+// only takes views at least half a second apart with grid moved somewhat
+// skipping keeps previous lens correction
 
-int jhcQtCamCal::lower_hand ()
+int jhcQtCamCal::lens_views ()
 {
-  double p, t, t0 = -45.0;   
-
-  // get presumed tilt and tell hand to move down
-  Update();
-  CamDir(&p, &t);
-  Gaze(0.0, t0);
-  Issue();
+  double cx = 0.0, cy = 0.0;
+  int i, n, nl;
 
-  // see if good enough or stuck 
-  if ((fabs(p) < 1.0) && (fabs(t - t0) < 1.0))
+  // see if user is done (or wants to skip)
+  if (_kbhit())
   {
+    _getch();
     step++;
-    trial = 0;
+    if (lens.Views() <= 0)
+    {
+      printf("  Keeping previous lens correction\n");
+      ocv_warp(lr2f, lr4f, lmag, lasp, ldx, ldy);
+      printf("\nRed mark should be on floor %3.1f\" forward, %3.1f\" right of body center\n", my, mx);
+      step++;
+    }
     return 1;
   }
-  if (++trial >= 50)
-  {                          
-    printf("Cannot lower hand!\n");
+
+  // find dots and mark them
+  n = red.Find(img);
+  for (i = 0; i < n; i++)
+  {
+    draw_cross((int)(red.cx[i] + 0.5), 479 - (int)(red.cy[i] + 0.5));
+    cx += red.cx[i];
+    cy += red.cy[i];
+  }
+  ocv_queue(0, img);
+  ocv_show();
+  if ((++wait < 15) || (n < 12))
+    return 1;
+
+  // require grid to be in a new place
+  cx /= n;
+  cy /= n;
+  if ((fabs(cx - vx0) < 40.0) && (fabs(cy - vy0) < 40.0))
+    return 1;
+  if ((nl = lens.AddView(red.cx, red.cy, n)) <= 0)
+    return 1;
+  printf("  View %d: %d dots, %d lines\n", lens.Views(), n, nl);
+  vx0 = cx;
+  vy0 = cy;
+  wait = 0;
+  if (lens.Views() >= 8)
+    step++;
+  return 1;
+}
+
+
+//= Find distortion that makes all grid lines straight and apply it.
+// zooms corrected image to remove black border (changes focal length)
+
+int jhcQtCamCal::lens_fit ()
+{
+  if (lens.Fit() <= 0)
+  {
+    printf("\nNot enough grid lines (%d) -- need more views!\n", lens.Lines());
     return -1;
   }
+  lens.Zoom();
+  printf("\nLens: r2f %4.2f, r4f %4.2f, mag %4.2f, center %3.1f %3.1f\n", 
+         lens.r2f, lens.r4f, lens.mag, lens.dx, lens.dy);
+  printf("  Residual bend %4.2f pixels per 100 over %d lines\n", lens.err, lens.Lines());
+
+  // new focal length estimate scales with magnification
+  flen *= lens.mag / lmag;
+  lr2f = lens.r2f;
+  lr4f = lens.r4f;
+  lmag = lens.mag;
+  lasp = lens.asp;
+  ldx  = lens.dx;
+  ldy  = lens.dy;
+  ocv_warp(lr2f, lr4f, lmag, lasp, ldx, ldy);
+  if (save_lens() <= 0)
+    return -1;
+
+  // get ready for extrinsic sweep
+  printf("\nRed mark should be on floor %3.1f\" forward, %3.1f\" right of body center\n", my, mx);
+  wait = 0;
+  step++;
+  return 1;
+}
+
+
+//= Write lens correction to its own file for this robot.
+// returns 1 if okay, 0 or negative for problem
+
+int jhcQtCamCal::save_lens ()
+{
+  char fname[80];
+  FILE *out;
+
+  sprintf_s(fname, "config/%s_lens.cfg", mb);
+  if (fopen_s(&out, fname, "w") != 0)
+  {
+    printf("  Could not write to file: %s !\n", fname);
+    return 0;
+  }
+  fprintf(out, "%5.3f %5.3f %5.3f %5.3f %3.1f %3.1f %3.1f\n", lr2f, lr4f, lmag, lasp, ldx, ldy, flen);
+  fclose(out);
+  printf("  Wrote lens values to: %s\n", fname);
   return 1;
 }
 
 
-//= Make fingers touch each other for single grasp point.
+//= Aim camera in each sweep direction then look for mark once settled.
 // reads robot sensors and generates commands
 
-int jhcQtCamCal::close_hand ()
+int jhcQtCamCal::sweep_gaze ()
 {
-  double w;
+  double p, t, gp, gt;
+  int i = pose % np, j = pose / np;
+
+  // see if all directions tried
+  if (pose >= np * nt)
+  {
+    printf("  Collected %d sightings\n", nobs);
+    step++;
+    return 1;
+  }
+
+  // pick gaze direction (alternate pan sweep to save travel)
+  if ((j & 1) != 0)
+    i = np - 1 - i;
+  gp = p0 + i * (p1 - p0) / __max(1, np - 1);
+  gt = t0 + j * (t1 - t0) / __max(1, nt - 1);
 
-  // get presumed width and tell fingers to close
+  // get presumed direction and tell arm to move
   Update();
-  w = Width();
-  Grip(0.0);
+  CamDir(&p, &t);
+  Gaze(gp, gt);
   Issue();
 
-  // see if good enough or stuck 
-  if (w < 0.1)
-    if (++wait >= 10)        // for image stabilization
+  // wait for arm to arrive (skip pose if stuck)
+  if ((fabs(p - gp) > 1.0) || (fabs(t - gt) > 1.0))
+  {
+    wait = 0;
+    if (++trial >= 50)
     {
-      step++;
-      printf("  Click on fingertip grasp point ...\n");
-      return 1;
+      printf("  Cannot reach gaze %3.1f %3.1f - skipping\n", gp, gt);
+      pose++;
+      trial = 0;
     }
-  if (++trial >= 50)
-  {                          
-    printf("Cannot close hand!\n");
-    return -1;
+    return 1;
   }
+
+  // let image stabilize then record mark
+  if (++wait < 10)
+    return 1;
+  if (find_mark() <= 0)
+    printf("  No mark seen at gaze %3.1f %3.1f\n", gp, gt);
+  pose++;
+  trial = 0;
+  wait = 0;
   return 1;
 }
 
 
-//= Mark fingertips and servo screws.
-// ignores physical robot
+//= Find red blob closest to where mark is expected and save sighting.
+// returns 1 if recorded, 0 if nothing found
 
-int jhcQtCamCal::mark_points ()
+int jhcQtCamCal::find_mark ()
 {
-  int but, mx, my;
+  double x, y, z, p, t, ex, ey, dx, dy, d2, best;
+  int i, n, win = -1;
+
+  // get all red things in image
+  if (nobs >= omax)
+    return 0;
+  if ((n = red.Find(img)) <= 0)
+    return 0;
+
+  // pick the one nearest to prediction from current parameters
+  CamPix(ex, ey, mx, my, 0.0);
+  for (i = 0; i < n; i++)
+  {
+    dx = red.cx[i] - ex;
+    dy = red.cy[i] - ey;
+    d2 = dx * dx + dy * dy;
+    if ((win < 0) || (d2 < best))
+    {
+      win = i;
+      best = d2;
+    }
+  }
 
-  // regularly poll for new mouse click in window
+  // save camera pose without current offsets along with mark pixel
+  CamLoc(x, y, z);
+  CamDir(&p, &t);
+  ox[nobs] = x;
+  oy[nobs] = y;
+  oz[nobs] = z;
+  op[nobs] = p - cp0;
+  ot[nobs] = t - ct0;
+  ou[nobs] = red.cx[win];
+  ov[nobs] = red.cy[win];
+  use[nobs] = 1;
+  nobs++;
+
+  // show on image (buffer is bottom-up)
+  draw_cross((int)(red.cx[win] + 0.5), 479 - (int)(red.cy[win] + 0.5));
   ocv_queue(0, img);
   ocv_show(); 
-  if ((but = ocv_click(0, mx, my)) <= 0)
-    return 1;
-  if (but == 3)
-    return 0;                // user abort
-
-  // save point and show on image 
-  ptx[np] = mx;
-  pty[np] = my;
-  draw_cross(mx, my);
-  np++;
-
-  // prompt for next point
-  if (np == 1)
-    printf("  Click on left rear servo screw ...\n");
-  else if (np == 2)
-    printf("  Click on right rear servo screw ...\n");
-  else
-    step++;
   return 1;
 }
 
@@ -249,32 +395,35 @@ void jhcQtCamCal::draw_cross (int x, int y)
 }
 
 
-//= Use marked points and known robot geometry to solve for offsets.
+//= Use all sightings and known robot geometry to solve for camera parameters.
 
 int jhcQtCamCal::compute_calib ()
 {
-  double R2D = 180.0 / M_PI, xmid = 319.5, ymid = 239.5, flen = 204.4;
-  double hx, hy, hz, cx, cy, cz, th, tc, ti;
-
-double p = cp0, t = ct0, r = cr0;
+  double q[4] = {cp0, ct0, cr0, flen};
+  int i, n = 0;
 
-  // find expected tilt of finger midpoint based on geometry
-  HandLoc(hx, hy, hz);
-  CamLoc(cx, cy, cz);
-  th = R2D * atan2(hz - cz, hy - cy);
+  // need enough sightings to constrain 4 values
+  if (nobs < 6)
+  {
+    printf("\nOnly %d sightings -- is red mark in place?\n", nobs);
+    return -1;
+  }
 
-  // compare to image tilt of finger midpoint (should be same)
-  ti = R2D * atan2(ymid - pty[0], flen);
-  CamDir(NULL, &tc);                   // includes original ct0
-  ct0 += th - (tc + ti);               
+  // fit everything, discard bad sightings, then refit
+  fit_params(q, 50);
+  if (drop_outliers(q) > 0)
+    fit_params(q, 50);
+  for (i = 0; i < nobs; i++)
+    n += use[i];
+  cp0  = q[0];
+  ct0  = q[1];
+  cr0  = q[2];
+  flen = q[3];
 
-  // find pan of fingertips and roll of screws (both should be zero)
-  cp0 = R2D * atan2(xmid - ptx[0], flen);
-  cr0 = R2D * atan2(pty[1] - pty[2], ptx[2] - ptx[1]);
-  
   // announce estimates and assess magnitudes
-  printf("\nEstimated offsets: pan %3.1f, tilt %3.1f, roll %3.1f\n", cp0, ct0, cr0);
-  if ((fabs(cp0) > 5.0) || (fabs(ct0) > 10.0) || (fabs(cr0) > 5.0))
+  printf("\nEstimated offsets: pan %3.1f, tilt %3.1f, roll %3.1f, focal %3.1f\n", cp0, ct0, cr0, flen);
+  printf("  RMS error %3.1f pixels over %d sightings\n", sqrt(sq_err(q) / n), n);
+  if ((fabs(cp0) > 5.0) || (fabs(ct0) > 10.0) || (fabs(cr0) > 5.0) || (fabs(flen - 204.4) > 30.0))
     printf("  >>> Corrections seem too large!\n");
   printf("\nHit any key to save values (ESC to abort) ...\n");
   step++;
@@ -313,7 +462,7 @@ int jhcQtCamCal::save_values ()
   // write previous name and servo offsets plus new camera values 
   fprintf(out, "%s\n", name);
   fprintf(out, "%1.0f %1.0f %1.0f\n", boff, soff, goff);
-  fprintf(out, "%3.1f %3.1f %3.1f\n", cp0, ct0, cr0);
+  fprintf(out, "%3.1f %3.1f %3.1f %3.1f\n", cp0, ct0, cr0, flen);
   fclose(out);
   printf("  SUCCESS - wrote values to: %s\n", fname);
   return 0;
@@ -325,4 +474,196 @@ int jhcQtCamCal::save_values ()
 void jhcQtCamCal::Cleanup ()
 {
   printf("\n");
-}
\ No newline at end of file
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                        Least Squares Fitting                          //
+///////////////////////////////////////////////////////////////////////////
+
+//= Adjust parameters (pan, tilt, roll, focal) to minimize pixel errors.
+// damped Gauss-Newton steps using numerically estimated Jacobian
+// returns number of iterations used
+
+int jhcQtCamCal::fit_params (double *q, int iter)
+{
+  double r[2 * omax], r2[2 * omax], jac[2 * omax][4], m[4][5], dq[4], q2[4];
+  double dv[4] = {0.01, 0.01, 0.01, 0.1}, lam = 0.001, e0, e = 0.0;
+  int i, j, k, n, it, ok;
+
+  e0 = sq_err(q);
+  for (it = 0; it < iter; it++)
+  {
+    // sensitivity of each residual to each parameter
+    n = residuals(r, q);
+    for (j = 0; j < 4; j++)
+    {
+      for (k = 0; k < 4; k++)
+        q2[k] = q[k];
+      q2[j] += dv[j];
+      residuals(r2, q2);
+      for (i = 0; i < n; i++)
+        jac[i][j] = (r2[i] - r[i]) / dv[j];
+    }
+
+    // increase damping until some step reduces error
+    ok = 0;
+    while (lam < 1e6)
+    {
+      for (j = 0; j < 4; j++)
+      {
+        for (k = 0; k < 4; k++)
+        {
+          m[j][k] = 0.0;
+          for (i = 0; i < n; i++)
+            m[j][k] += jac[i][j] * jac[i][k];
+        }
+        m[j][j] *= 1.0 + lam;
+        m[j][4] = 0.0;
+        for (i = 0; i < n; i++)
+          m[j][4] -= jac[i][j] * r[i];
+      }
+      if (solve4(dq, m) > 0)
+      {
+        for (k = 0; k < 4; k++)
+          q2[k] = q[k] + dq[k];
+        if ((e = sq_err(q2)) < e0)
+        {
+          ok = 1;
+          break;
+        }
+      }
+      lam *= 10.0;
+    }
+    if (ok <= 0)
+      break;
+
+    // accept step and relax damping
+    for (k = 0; k < 4; k++)
+      q[k] = q2[k];
+    lam = __max(1e-6, 0.1 * lam);
+    if ((e0 - e) < 1e-8 * e0)
+      break;
+    e0 = e;
+  }
+  return it;
+}
+
+
+//= Sum of squared pixel errors for some set of parameters.
+
+double jhcQtCamCal::sq_err (const double *q)
+{
+  double r[2 * omax], sum = 0.0;
+  int i, n;
+
+  n = residuals(r, q);
+  for (i = 0; i < n; i++)
+    sum += r[i] * r[i];
+  return sum;
+}
+
+
+//= Get pixel errors (x then y) for all valid sightings given parameters.
+// parameters are pan, tilt, and roll offsets (deg) and focal length (pixels)
+// returns number of residuals
+
+int jhcQtCamCal::residuals (double *r, const double *q)
+{
+  double px, py;
+  int i, n = 0;
+
+  prj.flen = q[3];
+  for (i = 0; i < nobs; i++)
+    if (use[i] > 0)
+    {
+      if (prj.Project(px, py, mx, my, 0.0, ox[i], oy[i], oz[i], op[i] + q[0], ot[i] + q[1], q[2]) > 0)
+      {
+        r[n++] = px - ou[i];
+        r[n++] = py - ov[i];
+      }
+      else
+      {
+        r[n++] = 1000.0;               // behind camera
+        r[n++] = 1000.0;
+      }
+    }
+  return n;
+}
+
+
+//= Discard sightings that fit much worse than typical.
+// returns number of sightings removed
+
+int jhcQtCamCal::drop_outliers (const double *q)
+{
+  double r[2 * omax], e2[omax], sum = 0.0, lim;
+  int i, k = 0, n = 0, cnt = 0;
+
+  // get squared error for each valid sighting
+  residuals(r, q);
+  for (i = 0; i < nobs; i++)
+    if (use[i] > 0)
+    {
+      e2[i] = r[k] * r[k] + r[k + 1] * r[k + 1];
+      sum += e2[i];
+      k += 2;
+      n++;
+    }
+  if (n <= 6)
+    return 0;
+
+  // remove those beyond 3 sigma (or 3 pixels)
+  lim = __max(9.0 * sum / n, 9.0);
+  for (i = 0; i < nobs; i++)
+    if ((use[i] > 0) && (e2[i] > lim) && ((n - cnt) > 6))
+    {
+      use[i] = 0;
+      cnt++;
+    }
+  return cnt;
+}
+
+
+//= Solve 4x4 linear system given as augmented matrix (destroyed).
+// returns 1 if okay, 0 if singular
+
+int jhcQtCamCal::solve4 (double *x, double m[4][5]) const
+{
+  double f, t;
+  int i, j, k, piv;
+
+  // forward elimination with partial pivoting
+  for (k = 0; k < 4; k++)
+  {
+    piv = k;
+    for (i = k + 1; i < 4; i++)
+      if (fabs(m[i][k]) > fabs(m[piv][k]))
+        piv = i;
+    if (fabs(m[piv][k]) < 1e-12)
+      return 0;
+    if (piv != k)
+      for (j = k; j < 5; j++)
+      {
+        t = m[k][j];
+        m[k][j] = m[piv][j];
+        m[piv][j] = t;
+      }
+    for (i = k + 1; i < 4; i++)
+    {
+      f = m[i][k] / m[k][k];
+      for (j = k; j < 5; j++)
+        m[i][j] -= f * m[k][j];
+    }
+  }
+
+  // back substitution
+  for (k = 3; k >= 0; k--)
+  {
+    x[k] = m[k][4];
+    for (j = k + 1; j < 4; j++)
+      x[k] -= m[k][j] * x[j];
+    x[k] /= m[k][k];
+  }
+  return 1;
+}
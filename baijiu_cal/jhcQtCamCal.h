@@ -1,4 +1,4 @@
-// jhcQtCamCal.h : interactive extrinsic camera calibration for Qtruck robot
+// jhcQtCamCal.h : automatic camera calibration for Qtruck robot
 //
 // Written by Jonathan H. Connell, jconnell@alum.mit.edu
 //
@@ -22,21 +22,53 @@
 
 #pragma once
 
+#include "jhcQtBlob.h"
+#include "jhcQtFloor.h"
+#include "jhcQtLens.h"
+
 #include "jhcQtruck.h"
 
 
-//= Interactive extrinsic camera calibration for Qtruck robot.
+//= Automatic camera calibration for Qtruck robot.
+// first fits lens distortion from views of a red dot grid (optional)
+// then sweeps camera through a grid of gaze directions while watching a red
+// mark at a known spot on the floor, then adjusts pan, tilt, and roll 
+// offsets plus focal length to best explain all the sightings at once
+// (Levenberg-Marquardt with numerical derivatives)
 
 class jhcQtCamCal : public jhcQtruck
 {
 // PRIVATE MEMBER VARIABLES
 private:
-  // static camera image
+  static const int omax = 40;          // max sightings
+
+  // static camera image and mark finder
   unsigned char *img;
+  jhcQtBlob red;
+
+  // lens fitting and grid view spacing
+  jhcQtLens lens;
+  double vx0, vy0;
+
+  // projection with trial parameters
+  jhcQtFloor prj;
+
+  // camera position, nominal pan and tilt, and mark pixel for each sighting
+  double ox[omax], oy[omax], oz[omax], op[omax], ot[omax], ou[omax], ov[omax];
+  int use[omax], nobs;
 
-  // marked image points 
-  int ptx[3], pty[3];
-  int step, np, trial, wait;
+  // sequencing
+  int step, pose, trial, wait;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // floor position of red mark (in)
+  double mx, my;
+
+  // gaze directions to sweep (deg)
+  double p0, p1, t0, t1;
+  int np, nt;
 
 
 // PUBLIC MEMBER FUNCTIONS
@@ -57,14 +89,24 @@ protected:
 
 // PRIVATE MEMBER FUNCTIONS
 private:
+  // lens distortion
+  int lens_views ();
+  int lens_fit ();
+  int save_lens ();
+
   // primary loop
-  int lower_hand ();
-  int close_hand ();
-  int mark_points ();
+  int sweep_gaze ();
+  int find_mark ();
   void draw_cross (int x, int y);
   int compute_calib ();
   int await_key ();
   int save_values ();
 
+  // least squares fitting
+  int fit_params (double *q, int iter);
+  double sq_err (const double *q);
+  int residuals (double *r, const double *q);
+  int drop_outliers (const double *q);
+  int solve4 (double *x, double m[4][5]) const;
 
 };
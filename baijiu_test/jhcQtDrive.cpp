@@ -58,7 +58,6 @@ int jhcQtDrive::Setup ()
     printf("  No video stream -- is wifi set to HW_ESP32Cam?\n");
     return 0;
   }
-  ocv_warp(0.7, -11.0);
 
   // make a window to display video
   ocv_win(0, "Esp32 camera", 20, 50);
@@ -75,6 +74,7 @@ int jhcQtDrive::Setup ()
 
 int jhcQtDrive::Launch ()
 {
+  ocv_warp(lr2f, lr4f, lmag, lasp, ldx, ldy);          // robot specific lens
   R2D2();
   printf("\n--> Arm = arrows PgUp PgDn <ALT>, Color = 0-9, Mouth = <SPACE> <BACK>\n");
   printf("--> Drive using NumPad/NumLock = 789 46 123 (<ESC> to quit) ...\n\n");
@@ -88,9 +88,10 @@ int jhcQtDrive::Launch ()
 
 int jhcQtDrive::Respond ()
 {
-  // wait for next video frame then display it
+  // wait for next video frame then mark red objects and display it
   if (ocv_get(buf, 1) <= 0)
     return -1;
+  find_red();
   ocv_queue(0, buf);
   ocv_show(); 
 
@@ -116,6 +117,46 @@ int jhcQtDrive::Respond ()
 }
 
 
+///////////////////////////////////////////////////////////////////////////
+//                                Vision                                 //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find red blobs in current frame, get their floor positions, and outline them.
+// flipped camera frame is bottom-up so buffer rows work for floor projection
+
+void jhcQtDrive::find_red ()
+{
+  int i, n;
+
+  n = red.Find(buf);
+  for (i = 0; i < n; i++)
+    draw_box(red.bx0[i], red.by0[i], red.bx1[i], red.by1[i]);
+  FloorPts(red.fx, red.fy, red.cx, red.cy, n, red.fok);
+}
+
+
+//= Draw a green rectangle on bottom-up image buffer.
+
+void jhcQtDrive::draw_box (int x0, int y0, int x1, int y1)
+{
+  unsigned char *d;
+  int x, y;
+
+  for (x = x0; x <= x1; x++)
+  {
+    d = buf + 3 * x;
+    d[y0 * 1920 + 1] = 255;
+    d[y1 * 1920 + 1] = 255;
+  }
+  for (y = y0; y <= y1; y++)
+  {
+    d = buf + y * 1920;
+    d[3 * x0 + 1] = 255;
+    d[3 * x1 + 1] = 255;
+  }
+}
+
+
 ///////////////////////////////////////////////////////////////////////////
 //                       Keyboard Interpretation                         //
 ///////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "jhcQtBlob.h"
 #include "jhcQtruck.h"
 
 
@@ -33,6 +34,9 @@ class jhcQtDrive : public jhcQtruck
 private:
   unsigned char *buf;
 
+  // red object finder
+  jhcQtBlob red;
+
 
 // PUBLIC MEMBER FUNCTIONS
 public:
@@ -51,6 +55,10 @@ protected:
 
 // PRIVATE MEMBER FUNCTIONS
 private:
+  // vision
+  void find_red ();
+  void draw_box (int x0, int y0, int x1, int y1);
+
   // keyboard interpretation 
   void get_track ();
   void get_arm ();
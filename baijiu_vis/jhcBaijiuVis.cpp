@@ -0,0 +1,736 @@
+// jhcBaijiuVis.cpp : coordinate Qtruck with ALIA variables and add vision
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// 
+///////////////////////////////////////////////////////////////////////////
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+
+#include "vid_ocv.h"
+#include "alia_act.h"
+
+#include "jhcBaijiuVis.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+// never joins threads since this may run at DLL unload under loader lock
+// NOTE: pipeline threads are stopped by Cleanup() (run by ext_done)
+
+jhcBaijiuVis::~jhcBaijiuVis ()
+{
+  vrun = 0;
+  pthread_mutex_destroy(&vlock);
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcBaijiuVis::jhcBaijiuVis ()
+{
+  LARGE_INTEGER f;
+
+  // no threads yet
+  vrun = 0;
+  vlock = INVALID_HANDLE_VALUE;
+  vdisp = 1;
+  vgate = 1;
+  vfull = 1000;
+  vtip = 500;
+  vgrip = 1;
+  gspan = 0.4;
+  gtall = 0.4;
+  vstill = 0;
+  full = 0;
+
+  // no results yet
+  mnum = 0;
+  mseq = 0;
+  seq0 = 0;
+  mms = 0;
+  mnp = 0;
+  mms0 = 0;
+  treq = 0;
+  tok = 0;
+  tms = 0;
+  pn = 0;
+  gvis = 0;
+  glearn = 0;
+  mgrip = -1;
+  gheld = -1;
+  gj0 = -1;
+  gj1 = -1;
+  ghx = 0.0;
+  ghy = 0.0;
+  ghz = 0.0;
+  gnear = 0;
+  glatch = 0;
+  kz0 = -1.0;
+  mfrac = 0.0;
+  mmx = 0.0;
+  mmy = 0.0;
+  mhot = 0;
+  nobj = 0;
+  oms = 0;
+  chg = 0.0;
+  chx = 0.0;
+  chy = 0.0;
+  motion = 0;
+
+  // high resolution timer for profiling
+  QueryPerformanceFrequency(&f);
+  freq = 1000.0 / (double) f.QuadPart;
+}
+
+
+//= Initializes system before attempting Bluetooth robot connection.
+// returns positive if successful, 0 or negative for failure
+
+int jhcBaijiuVis::Setup ()
+{
+  // connect to ESP32Cam 
+  if (ocv_open("http://192.168.5.1:81/stream") <= 0)
+  {
+    printf("  No video stream -- is wifi set to HW_ESP32Cam?\n");
+    return 0;
+  }
+
+  // frames waiting between stages (one writing, one reading, one spare)
+  raw.Init(3, 3 * 640 * 480);
+  if (vdisp > 0)
+    ocv_win(0, "Esp32 camera", 20, 50);
+  return jhcBaijiuAct::Setup();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Primary Loop                              //
+///////////////////////////////////////////////////////////////////////////
+
+//= Override to initialize external system before loop.
+// returns positive if okay, 0 or negative for problem
+
+int jhcBaijiuVis::Launch ()
+{
+  // start reasoner and speech 
+  if (jhcBaijiuAct::Launch() <= 0)
+    return 0;
+
+  // clear statistics
+  gms = 0.0;
+  dms = 0.0;
+  lat = 0.0;
+  ngrab = 0;
+  ndet = 0;
+  nlat = 0;
+  nskip = 0;
+
+  // start vision pipeline threads (lens correction and mount angles known now)
+  ocv_warp(lr2f, lr4f, lmag, lasp, ldx, ldy);
+  ctrk.Reset(cp0, ct0, cr0, flen);
+  vrun = 1;
+  pthread_create(&grab, NULL, grab_loop, this);
+  pthread_create(&detect, NULL, detect_loop, this);
+  return 1;
+}
+
+
+//= Override to perform shutdown operations on external system.
+
+void jhcBaijiuVis::Cleanup ()
+{
+  stop_vision();
+  vis_stats();
+  jhcBaijiuAct::Cleanup();
+}
+
+
+//= Analyze data from sensors and reconfigure for ALIA reasoner.
+
+void jhcBaijiuVis::get_sensors ()
+{
+  vis_update();
+  jhcBaijiuAct::get_sensors();
+  grip_force();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Pipeline Stages                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for frame capture stage.
+
+pthread_ret jhcBaijiuVis::grab_loop (void *vis)
+{
+  ((jhcBaijiuVis *) vis)->run_grab();
+  return 0;
+}
+
+
+//= Thread function for detection stage.
+
+pthread_ret jhcBaijiuVis::detect_loop (void *vis)
+{
+  ((jhcBaijiuVis *) vis)->run_detect();
+  return 0;
+}
+
+
+//= Keep getting undistorted frames from camera and queueing them.
+// never waits for downstream stages (oldest unread frame gets dropped)
+
+void jhcBaijiuVis::run_grab ()
+{
+  unsigned char *buf;
+  double t0;
+
+  while (vrun > 0)
+  {
+    if ((buf = raw.Fill()) == NULL)
+    {
+      Sleep(1);
+      continue;
+    }
+    t0 = now_ms();
+    if (ocv_get(buf, 1) <= 0)            // blocks for next frame
+    {
+      raw.Release(buf);
+      Sleep(10);
+      continue;
+    }
+    raw.Post(buf, timeGetTime());
+    gms += now_ms() - t0;
+    ngrab++;
+  }
+}
+
+
+//= Process queued frames as they arrive and publish results.
+// cheap change detector decides whether heavier stages are needed
+// object results are held over when detectors are skipped
+
+void jhcBaijiuVis::run_detect ()
+{
+  unsigned char *buf;
+  unsigned long ms, ms0 = 0;
+  double u[2], v[2], mu[2], mv[2];
+  double t0;
+  int i, n, np, hot, still, req, got, x0, y0, x1, y1, j0, j1, gv, learn, held, found = 0;
+
+  while (vrun > 0)
+  {
+    // wait for next frame
+    if ((buf = raw.Next(&ms)) == NULL)
+    {
+      Sleep(1);
+      continue;
+    }
+
+    // look for changes (only meaningful if camera still)
+    t0 = now_ms();
+    if ((still = vstill) <= 0)
+      mot.Reset();
+    hot = mot.Update(buf);
+
+    // see if fingertips should be checked in this frame (must be newer than request)
+    pthread_mutex_lock(vlock)
+    req = (((treq == 1) && (ms >= tms)) ? 1 : 0);
+    for (i = 0; i < 2; i++)
+    {
+      u[i] = tu[i];
+      v[i] = tv[i];
+    }
+    x0 = gx0;
+    y0 = gy0;
+    x1 = gx1;
+    y1 = gy1;
+    j0 = gj0;
+    j1 = gj1;
+    gv = gvis;
+    learn = glearn;
+    pthread_mutex_unlock(vlock)
+
+    // find objects and track floor features unless nothing happening
+    n = -1;
+    np = 0;
+    got = 0;
+    if ((vgate <= 0) || (still <= 0) || (hot > 0) || (req > 0) || ((ms - full) >= (unsigned long) vfull))
+    {
+      n = red.Find(buf);
+      np = vo.Track(buf);
+      found = 1;
+      if (req > 0)
+        for (i = 0; i < 2; i++)
+          if (ctrk.Spot(mu[i], mv[i], red.Mask(), u[i], v[i]) > 0)
+            got++;
+      full = ms;
+      dms += now_ms() - t0;
+      ndet++;
+    }
+    else
+    {
+      vo.Reset();
+      nskip++;
+    }
+
+    // see if anything between jaws (red mask still valid if detectors skipped)
+    held = -1;
+    if (learn < 0)
+      grip.Reset();
+    else if ((vgrip > 0) && (gv > 0))
+      held = grip.Update(buf, ((found > 0) ? red.Mask() : NULL), x0, y0, x1, y1, learn, j0, j1);
+
+    // copy to mailbox for control loop
+    pthread_mutex_lock(vlock)
+    for (i = 0; i < n; i++)
+    {
+      mcx[i] = red.cx[i];
+      mcy[i] = red.cy[i];
+      marea[i] = red.area[i];
+    }
+    if (n >= 0)
+      mnum = n;
+    for (i = 0; i < np; i++)
+    {
+      mx0[i] = vo.x0[i];
+      my0[i] = vo.y0[i];
+      mx1[i] = vo.x1[i];
+      my1[i] = vo.y1[i];
+    }
+    mnp = np;
+    mms0 = ms0;
+    mgrip = held;
+    mhot = ((still > 0) ? hot : 0);
+    mfrac = mot.frac;
+    mmx = mot.mx;
+    mmy = mot.my;
+    if (req > 0)
+    {
+      for (i = 0; i < 2; i++)
+      {
+        tmu[i] = mu[i];
+        tmv[i] = mv[i];
+      }
+      tok = ((got >= 2) ? 1 : 0);
+      treq = 2;
+    }
+    mms = ms;
+    mseq++;
+    pthread_mutex_unlock(vlock)
+    ms0 = ms;
+
+    // possibly show image then recycle buffer
+    if (vdisp > 0)
+    {
+      ocv_queue(0, buf);
+      ocv_show();
+    }
+    raw.Release(buf);
+  }
+}
+
+
+//= Stop all pipeline threads and wait for them to finish.
+
+void jhcBaijiuVis::stop_vision ()
+{
+  if (vrun <= 0)
+    return;
+  vrun = 0;
+  pthread_join(grab, NULL);
+  pthread_join(detect, NULL);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                                Results                                //
+///////////////////////////////////////////////////////////////////////////
+
+//= Pick up any new detections and find their floor positions.
+// only holds lock long enough to copy a few numbers 
+// also tells detect thread whether robot is holding still
+// NOTE: uses current camera pose which may be a frame or two newer
+
+void jhcBaijiuVis::vis_update ()
+{
+  float px[jhcQtBlob::bmax], py[jhcQtBlob::bmax], fx[jhcQtBlob::bmax], fy[jhcQtBlob::bmax];
+  float ax[jhcQtVisOdom::fmax], ay[jhcQtVisOdom::fmax], bx[jhcQtVisOdom::fmax], by[jhcQtVisOdom::fmax];
+  unsigned char ok[jhcQtBlob::bmax];
+  unsigned long ms0 = 0;
+  int i, n, mv, np = 0;
+
+  // change detection only works if camera is stationary
+  // (base motion from average effort since dithering zeroes some pulses)
+  mv = cam_moved();
+  vstill = (((mv <= 0) && (Moving() <= 0)) ? 1 : 0);
+
+  // see if anything new (flipped frame is bottom-up like floor projector)
+  pthread_mutex_lock(vlock)
+  n = -1;
+  if (mseq != seq0)
+  {
+    n = mnum;
+    for (i = 0; i < n; i++)
+    {
+      px[i] = mcx[i];
+      py[i] = mcy[i];
+      oarea[i] = marea[i];
+    }
+    np = mnp;
+    for (i = 0; i < np; i++)
+    {
+      ax[i] = mx0[i];
+      ay[i] = my0[i];
+      bx[i] = mx1[i];
+      by[i] = my1[i];
+    }
+    ms0 = mms0;
+    motion = mhot;
+    gheld = mgrip;
+    chg = mfrac;
+    chx = mmx;
+    chy = mmy;
+    oms = mms;
+    seq0 = mseq;
+  }
+  pthread_mutex_unlock(vlock)
+
+  // check for mount drift occasionally and say where jaws are
+  vis_tips(mv);
+  grip_roi(px, py, n, mv);
+  if (n < 0)
+    return;
+
+  // project onto floor (fingertip marks are not objects)
+  FloorPts(fx, fy, px, py, n, ok);
+  nobj = 0;
+  for (i = 0; i < n; i++)
+    if (near_tip(px[i], py[i], oarea[i]) <= 0)
+    {
+      ox[nobj] = fx[i];
+      oy[nobj] = fy[i];
+      oarea[nobj] = oarea[i];
+      oflr[nobj] = ok[i];
+      nobj++;
+    }
+
+  // estimate body motion from tracked features
+  vis_odom(ax, ay, bx, by, np, ms0, oms, mv);
+
+  // track age of results
+  lat += (double)(timeGetTime() - oms);
+  nlat++;
+}
+
+
+//= Convert feature motion on floor to body motion for odometry.
+// ignores frames where arm moved camera relative to body
+// NOTE: features on walls or objects project badly but get rejected as outliers
+
+void jhcBaijiuVis::vis_odom (const float *ax, const float *ay, const float *bx, const float *by, 
+                             int n, unsigned long ms0, unsigned long ms1, int mv)
+{
+  float fx0[jhcQtVisOdom::fmax], fy0[jhcQtVisOdom::fmax], fx1[jhcQtVisOdom::fmax], fy1[jhcQtVisOdom::fmax];
+  unsigned char ok0[jhcQtVisOdom::fmax], ok1[jhcQtVisOdom::fmax];
+  double dx, dy, dth;
+  int i;
+
+  // need a stable camera and a sensible frame interval
+  if ((mv > 0) || (n <= 0) || (ms0 == 0) || (ms1 <= ms0))
+    return;
+
+  // project both sets of points then find rigid motion
+  FloorPts(fx0, fy0, ax, ay, n, ok0);
+  FloorPts(fx1, fy1, bx, by, n, ok1);
+  for (i = 0; i < n; i++)
+    ok0[i] &= ok1[i];
+  if (vo.Rigid(dx, dy, dth, fx0, fy0, fx1, fy1, ok0, n) >= 5)
+    VisMotion(dy, dth, 0.001 * (ms1 - ms0));
+}
+
+
+//= Tell if camera has shifted relative to body since last check.
+
+int jhcBaijiuVis::cam_moved ()
+{
+  double x, y, z, p, t, x0 = kx0, y0 = ky0, z0 = kz0, p0 = kp0, t0 = kt0;
+
+  CamLoc(x, y, z);
+  CamDir(&p, &t);
+  kx0 = x;
+  ky0 = y;
+  kz0 = z;
+  kp0 = p;
+  kt0 = t;
+  if ((z0 < 0.0) || (fabs(x - x0) > 0.1) || (fabs(y - y0) > 0.1) || (fabs(z - z0) > 0.1) ||
+      (fabs(p - p0) > 0.5) || (fabs(t - t0) > 0.5))
+    return 1;
+  return 0;
+}
+
+
+//= Refine camera mount angles by comparing predicted and seen fingertips.
+// picks up any answer to the last request then possibly asks again
+// fingertips are fixed wrt camera so pose only has to hold while jaws still
+// NOTE: needs small red marks on fingertips (otherwise never updates)
+
+void jhcBaijiuVis::vis_tips (int mv)
+{
+  double x[2], y[2], z[2], u[2], v[2], cx, cy, cz, p, t;
+  unsigned long now = timeGetTime();
+  int i, req, ok;
+
+  // figure out where fingertips should be seen right now
+  tip_pts(x, y, z, Width());
+  CamLoc(cx, cy, cz);
+  CamDir(&p, &t);
+  p -= cp0;
+  t -= ct0;
+  pn = ctrk.Predict(pu, pv, x, y, z, 2, cx, cy, cz, p, t);
+  if (vtip <= 0)
+    return;
+
+  // see if last request has been answered
+  pthread_mutex_lock(vlock)
+  req = treq;
+  ok = tok;
+  for (i = 0; i < 2; i++)
+  {
+    u[i] = tmu[i];
+    v[i] = tmv[i];
+  }
+  if (req == 2)
+    treq = 0;
+  pthread_mutex_unlock(vlock)
+
+  // use answer if jaws did not move, then adopt new mount offsets
+  if ((req == 2) && (ok > 0) && (fabs(Width() - tw) < 0.05))
+    if (ctrk.Update(u, v, tx, ty, tz, 2, tcx, tcy, tcz, tpan, ttilt) > 0)
+    {
+      cp0 = ctrk.ep;
+      ct0 = ctrk.et;
+      cr0 = ctrk.er;
+    }
+
+  // ask again after a while if both fingertips are well inside image
+  if ((req == 1) || ((now - tms) < (unsigned long) vtip) || (mv > 0) || (pn < 2))
+    return;
+  for (i = 0; i < 2; i++)
+  {
+    tx[i] = x[i];
+    ty[i] = y[i];
+    tz[i] = z[i];
+  }
+  tcx = cx;
+  tcy = cy;
+  tcz = cz;
+  tpan = p;
+  ttilt = t;
+  tw = Width();
+  pthread_mutex_lock(vlock)
+  for (i = 0; i < 2; i++)
+  {
+    tu[i] = pu[i];
+    tv[i] = pv[i];
+  }
+  tms = now;
+  treq = 1;
+  pthread_mutex_unlock(vlock)
+}
+
+
+//= Get locations of both fingertips wrt center of robot body for jaw width w.
+// jaws open sideways so tips are spread perpendicular to arm direction
+
+void jhcBaijiuVis::tip_pts (double *x, double *y, double *z, double w) const
+{
+  double hx, hy, hz, p, rads, w2 = 0.5 * w;
+
+  HandLoc(hx, hy, hz);
+  HandDir(&p);
+  rads = p * M_PI / 180.0;
+  x[0] = hx - w2 * cos(rads);
+  y[0] = hy - w2 * sin(rads);
+  x[1] = hx + w2 * cos(rads);
+  y[1] = hy + w2 * sin(rads);
+  z[0] = hz;
+  z[1] = hz;
+}
+
+
+//= Tell if a small red blob is really just a fingertip mark.
+
+int jhcBaijiuVis::near_tip (double px, double py, int area) const
+{
+  double dx, dy, r2 = ctrk.rad * ctrk.rad;
+  int i;
+
+  if ((vtip <= 0) || (pn < 2) || (area > ctrk.amax))
+    return 0;
+  for (i = 0; i < 2; i++)
+  {
+    dx = px - pu[i];
+    dy = py - pv[i];
+    if ((dx * dx + dy * dy) <= r2)
+      return 1;
+  }
+  return 0;
+}
+
+
+//= Tell detect thread which part of image is between the jaws.
+// window has fixed size in inches centered on hand no matter how far jaws
+// are open, so closed jaws can be checked too (only columns between tips)
+// empty model is learned with jaws open and no object near the window, e.g.
+// before approach, and kept while base drives since jaws are fixed wrt camera
+// anything that changes arm pose or camera view invalidates the model
+
+void jhcBaijiuVis::grip_roi (const float *px, const float *py, int n, int mv)
+{
+  double x[2], y[2], z[2], u[2], v[2], cx, cy, cz, p, t, hx, hy, hz;
+  double du, dv, ppi, mu, mid, lo, hi, m, w = Width(), clear = 2.0 * gspan + 0.2;
+  int i, x0 = 0, y0 = 0, x1 = 0, y1 = 0, j0 = -1, j1 = -1, vis = 0, learn = 0, moved;
+
+  // arm motion shifts view behind jaws (body motion mostly slides floor)
+  HandLoc(hx, hy, hz);
+  moved = (((mv > 0) || (fabs(hx - ghx) > 0.1) || (fabs(hy - ghy) > 0.1) ||
+            (fabs(hz - ghz) > 0.1)) ? 1 : 0);
+  ghx = hx;
+  ghy = hy;
+  ghz = hz;
+
+  // project window edges at hand (independent of jaw opening)
+  tip_pts(x, y, z, 2.0 * gspan);
+  CamLoc(cx, cy, cz);
+  CamDir(&p, &t);
+  if (ctrk.Predict(u, v, x, y, z, 2, cx, cy, cz, p - cp0, t - ct0) >= 2)
+  {
+    du = u[1] - u[0];
+    dv = v[1] - v[0];
+    ppi = sqrt(du * du + dv * dv) / (2.0 * gspan);
+    mu = 0.5 * (u[0] + u[1]);
+    mid = 0.5 * (v[0] + v[1]);
+    x0 = (int)(mu - gspan * ppi);
+    x1 = (int)(mu + gspan * ppi);
+    y0 = (int)(mid - gtall * ppi);
+    y1 = (int)(mid + gtall * ppi);
+    vis = 1;
+
+    // only look between fingertips (and their marks) if inside window
+    if ((w < clear) && (pn >= 2))
+    {
+      m = 0.1 * ppi;
+      lo = __min(pu[0], pu[1]) + m;
+      hi = __max(pu[0], pu[1]) - m;
+      j0 = __max(0, (int) lo);
+      j1 = __max(0, (int) hi);
+    }
+
+    // see if any fresh object detection (not a fingertip mark) is nearby
+    if (n >= 0)
+    {
+      m = gspan * ppi;
+      gnear = 0;
+      for (i = 0; i < n; i++)
+        if ((px[i] >= (x0 - m)) && (px[i] <= (x1 + m)) &&
+            (py[i] >= (y0 - m)) && (py[i] <= (y1 + m)) &&
+            (near_tip(px[i], py[i], oarea[i]) <= 0))
+          gnear = 1;
+    }
+  }
+
+  // decide whether to learn empty appearance or forget it
+  if (moved > 0)
+    learn = -1;
+  else if ((vis > 0) && (j0 < 0) && (gnear <= 0) && (alia_af <= 0.0) && (alia_awt >= 0.0))
+    learn = 1;
+
+  // post for next frame
+  pthread_mutex_lock(vlock)
+  gx0 = x0;
+  gy0 = y0;
+  gx1 = x1;
+  gy1 = y1;
+  gj0 = j0;
+  gj1 = j1;
+  gvis = vis;
+  glearn = learn;
+  pthread_mutex_unlock(vlock)
+}
+
+
+//= Use vision to say whether a squeezing gripper actually has an object.
+// adds force to width-only guess from jhcBaijiuAct::arm_update when something
+// is seen between the jaws (an empty verdict never overrides the width guess)
+// verdict is latched while squeezing so later lifts and drives do not flip it
+
+void jhcBaijiuVis::grip_force ()
+{
+  double hold = 5.0;                   // half max force (oz)
+
+  // forget verdict once gripper is no longer squeezing
+  if ((vgrip <= 0) || (alia_awt >= 0.0))
+  {
+    glatch = 0;
+    return;
+  }
+
+  // remember if anything was ever seen between jaws
+  if (gheld > 0)
+    glatch = 1;
+  if (glatch > 0)
+    alia_af = (float) hold;
+}
+
+
+//= Report timing of each pipeline stage.
+
+void jhcBaijiuVis::vis_stats () const
+{
+  if (ngrab <= 0)
+    return;
+  printf("\nVision: %d frames (%d dropped), grab %3.1f ms", ngrab, raw.Dropped(), gms / ngrab);
+  if (ndet > 0)
+    printf(", detect %4.2f ms", dms / ndet);
+  if (nskip > 0)
+    printf(" (%d skipped)", nskip);
+  if (nlat > 0)
+    printf(", result age %3.1f ms", lat / nlat);
+  printf("\n");
+  if ((ctrk.nup + ctrk.nrej) > 0)
+    printf("Mount: pan %4.1f, tilt %4.1f, roll %4.1f (%d updates, %d rejected)\n", 
+           ctrk.ep, ctrk.et, ctrk.er, ctrk.nup, ctrk.nrej);
+}
+
+
+//= Current time in milliseconds with sub-millisecond resolution.
+
+double jhcBaijiuVis::now_ms () const
+{
+  LARGE_INTEGER t;
+
+  QueryPerformanceCounter(&t);
+  return(freq * (double) t.QuadPart);
+}
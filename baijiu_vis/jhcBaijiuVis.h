@@ -0,0 +1,181 @@
+// jhcBaijiuVis.h : coordinate Qtruck with ALIA variables and add vision
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// 
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "jhc_pthread.h"
+
+#include "jhcQtBlob.h"
+#include "jhcQtCamTrack.h"
+#include "jhcQtFrameQ.h"
+#include "jhcQtGrasp.h"
+#include "jhcQtMotion.h"
+#include "jhcQtVisOdom.h"
+
+#include "jhcBaijiuAct.h"
+
+
+//= Coordinate Qtruck with ALIA variables and add vision.
+// camera pipeline runs as separate stages on worker threads:
+//   grab   = frame capture and lens undistortion (in vid_ocv)
+//   detect = change check, red object finding, feature tracking, and display
+// stages are linked by a bounded queue which drops stale frames
+// when robot is still, heavier detectors only run if something changes
+// marked fingertips are occasionally checked to refine camera mount angles
+// region between jaws is checked every frame to see if anything is held
+// control loop only picks up latest results (never waits for vision)
+
+class jhcBaijiuVis : public jhcBaijiuAct
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // pipeline threads and frames between stages
+  pthread_t grab, detect;
+  jhcQtFrameQ raw;
+  int vrun;
+
+  // detectors and tracker (only used by detect thread)
+  jhcQtMotion mot;
+  jhcQtBlob red;
+  jhcQtVisOdom vo;
+  jhcQtGrasp grip;
+  unsigned long full;
+
+  // whether body and camera are stationary (written by control loop)
+  int vstill;
+
+  // latest detection results (written by detect thread)
+  pthread_mutex_t vlock;
+  float mcx[jhcQtBlob::bmax], mcy[jhcQtBlob::bmax];
+  int marea[jhcQtBlob::bmax];
+  int mnum, mseq, seq0;
+  unsigned long mms;
+
+  // latest feature matches between frames (written by detect thread)
+  float mx0[jhcQtVisOdom::fmax], my0[jhcQtVisOdom::fmax];
+  float mx1[jhcQtVisOdom::fmax], my1[jhcQtVisOdom::fmax];
+  int mnp;
+  unsigned long mms0;
+
+  // latest change summary (written by detect thread)
+  double mfrac, mmx, mmy;
+  int mhot;
+
+  // fingertip request from control loop and measurement by detect thread
+  jhcQtCamTrack ctrk;
+  double tx[2], ty[2], tz[2], tcx, tcy, tcz, tpan, ttilt, tw;
+  double tu[2], tv[2], tmu[2], tmv[2];
+  int treq, tok;
+  unsigned long tms;
+
+  // predicted fingertip pixels for current pose
+  double pu[2], pv[2];
+  int pn;
+
+  // region between jaws (from control loop), inner jaw columns if inside
+  // region, and whether anything held there
+  int gx0, gy0, gx1, gy1, gj0, gj1, gvis, glearn, mgrip, gheld;
+
+  // hand location for empty model, whether an object is near the window,
+  // and whether anything was seen during current squeeze
+  double ghx, ghy, ghz;
+  int gnear, glatch;
+
+  // camera pose when last frame was processed
+  double kx0, ky0, kz0, kp0, kt0;
+
+  // stage timing statistics
+  double freq, gms, dms, lat;
+  int ngrab, ndet, nlat, nskip;
+
+
+// PROTECTED MEMBER PARAMETERS
+protected:
+  // whether to show camera images
+  int vdisp;
+
+  // whether to skip detectors if nothing changes and max time between runs (ms)
+  int vgate, vfull;
+
+  // whether to check for held object
+  int vgrip;
+
+  // half width and half height of region between jaws (inches)
+  double gspan, gtall;
+
+  // time between fingertip checks for mount drift (ms, 0 = never)
+  int vtip;
+
+
+// PROTECTED MEMBER VARIABLES
+protected:
+
+  // red objects on floor (biggest first) and frame capture time
+  double ox[jhcQtBlob::bmax], oy[jhcQtBlob::bmax];
+  int oarea[jhcQtBlob::bmax], oflr[jhcQtBlob::bmax];
+  int nobj;
+  unsigned long oms;
+
+  // active change cells (0 if none or camera moving), fraction, and center pixel
+  double chg, chx, chy;
+  int motion;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcBaijiuVis ();
+  jhcBaijiuVis ();
+  int Setup ();
+
+
+// PROTECTED MEMBER FUNCTIONS
+protected:
+  // primary loop
+  int Launch ();
+  void Cleanup ();
+  void get_sensors ();
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // pipeline stages
+  static pthread_ret grab_loop (void *vis);
+  static pthread_ret detect_loop (void *vis);
+  void run_grab ();
+  void run_detect ();
+  void stop_vision ();
+
+  // results
+  void vis_update ();
+  void vis_odom (const float *ax, const float *ay, const float *bx, const float *by, 
+                 int n, unsigned long ms0, unsigned long ms1, int mv);
+  int cam_moved ();
+  void vis_tips (int mv);
+  void tip_pts (double *x, double *y, double *z, double w) const;
+  int near_tip (double px, double py, int area) const;
+  void grip_roi (const float *px, const float *py, int n, int mv);
+  void grip_force ();
+  void vis_stats () const;
+  double now_ms () const;
+
+};
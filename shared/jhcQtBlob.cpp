@@ -0,0 +1,370 @@
+// jhcQtBlob.cpp : fast red object finder for Qtruck camera
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <intrin.h>                    // for __cpuid and SSSE3
+
+#include "jhcQtBlob.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcQtBlob::~jhcQtBlob ()
+{
+  dealloc();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcQtBlob::jhcQtBlob ()
+{
+  int info[4];
+
+  // check processor for SSSE3 (byte shuffle)
+  __cpuid(info, 1);
+  simd = (((info[2] >> 9) & 1) != 0) ? 1 : 0;
+
+  // no buffers yet
+  mask = NULL;
+  rs = NULL;
+  re = NULL;
+  ry = NULL;
+  rp = NULL;
+  ca = NULL;
+  cx0 = NULL;
+  cy0 = NULL;
+  cx1 = NULL;
+  cy1 = NULL;
+  csx = NULL;
+  csy = NULL;
+  nb = 0;
+
+  // color and size limits
+  dr   = 40;                 // redness over other channels
+  rmin = 80;                 // ignore dark pixels
+  amin = 20;                 // ignore speckles
+
+  // typical Esp32 camera
+  SetSize(640, 480);
+}
+
+
+//= Get rid of all buffers.
+
+void jhcQtBlob::dealloc ()
+{
+  delete [] csy;
+  delete [] csx;
+  delete [] cy1;
+  delete [] cx1;
+  delete [] cy0;
+  delete [] cx0;
+  delete [] ca;
+  delete [] rp;
+  delete [] ry;
+  delete [] re;
+  delete [] rs;
+  delete [] mask;
+  mask = NULL;
+  rs = NULL;
+  re = NULL;
+  ry = NULL;
+  rp = NULL;
+  ca = NULL;
+  cx0 = NULL;
+  cy0 = NULL;
+  cx1 = NULL;
+  cy1 = NULL;
+  csx = NULL;
+  csy = NULL;
+}
+
+
+//= Set image dimensions (3 bytes per pixel, no line padding).
+
+void jhcQtBlob::SetSize (int w, int h)
+{
+  dealloc();
+  iw = w;
+  ih = h;
+  mask = new unsigned char [iw * ih];
+  rmax = iw * ih / 4;
+  rs = new int [rmax];
+  re = new int [rmax];
+  ry = new int [rmax];
+  rp = new int [rmax];
+  ca = new int [rmax];
+  cx0 = new int [rmax];
+  cy0 = new int [rmax];
+  cx1 = new int [rmax];
+  cy1 = new int [rmax];
+  csx = new double [rmax];
+  csy = new double [rmax];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find red blobs in a BGR image of the configured size.
+// returns number of blobs found (at most bmax)
+
+int jhcQtBlob::Find (const unsigned char *img)
+{
+  if (simd > 0)
+    thresh_sse(img);
+  else
+    thresh(img);
+  get_runs();
+  blob_stats();
+  return nb;
+}
+
+
+//= Mark red pixels in mask (255) one pixel at a time.
+
+void jhcQtBlob::thresh (const unsigned char *img)
+{
+  const unsigned char *s = img;
+  unsigned char *m = mask;
+  int i, mx, n = iw * ih;
+
+  for (i = 0; i < n; i++, s += 3, m++)
+  {
+    mx = __max(s[0], s[1]);
+    *m = (((s[2] - mx) > dr) && (s[2] > rmin)) ? 255 : 0;
+  }
+}
+
+
+//= Mark red pixels in mask (255) sixteen pixels at a time.
+// byte shuffles split 48 bytes of BGR into separate channel vectors
+
+void jhcQtBlob::thresh_sse (const unsigned char *img)
+{
+  char sh[9][16];
+  __m128i pick[9], a, b, c, bl, gr, rd, mx, zero = _mm_setzero_si128();
+  __m128i vdr = _mm_set1_epi8((char) __max(0, __min(dr, 255)));
+  __m128i vrm = _mm_set1_epi8((char) __max(0, __min(rmin, 255)));
+  const unsigned char *s = img;
+  unsigned char *m = mask;
+  int i, j, q, src, n = iw * ih, n16 = n & ~15;
+
+  // build shuffle masks for each channel from each of 3 input vectors
+  for (i = 0; i < 3; i++)
+    for (q = 0; q < 3; q++)
+    {
+      for (j = 0; j < 16; j++)
+      {
+        src = 3 * j + i - 16 * q;
+        sh[3 * i + q][j] = (char)(((src >= 0) && (src < 16)) ? src : 0x80);
+      }
+      pick[3 * i + q] = _mm_loadu_si128((const __m128i *) sh[3 * i + q]);
+    }
+
+  // process bulk of image
+  for (i = 0; i < n16; i += 16, s += 48, m += 16)
+  {
+    // split into channels
+    a = _mm_loadu_si128((const __m128i *) s);
+    b = _mm_loadu_si128((const __m128i *)(s + 16));
+    c = _mm_loadu_si128((const __m128i *)(s + 32));
+    bl = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, pick[0]), _mm_shuffle_epi8(b, pick[1])), 
+                      _mm_shuffle_epi8(c, pick[2]));
+    gr = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, pick[3]), _mm_shuffle_epi8(b, pick[4])), 
+                      _mm_shuffle_epi8(c, pick[5]));
+    rd = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, pick[6]), _mm_shuffle_epi8(b, pick[7])), 
+                      _mm_shuffle_epi8(c, pick[8]));
+
+    // red excess over other channels and red brightness must both exceed limits
+    mx = _mm_subs_epu8(rd, _mm_max_epu8(bl, gr));
+    mx = _mm_or_si128(_mm_cmpeq_epi8(_mm_subs_epu8(mx, vdr), zero), 
+                      _mm_cmpeq_epi8(_mm_subs_epu8(rd, vrm), zero));
+    _mm_storeu_si128((__m128i *) m, _mm_andnot_si128(mx, _mm_cmpeq_epi8(zero, zero)));
+  }
+
+  // finish any leftover pixels
+  for (; i < n; i++, s += 3, m++)
+  {
+    j = __max(s[0], s[1]);
+    *m = (((s[2] - j) > dr) && (s[2] > rmin)) ? 255 : 0;
+  }
+}
+
+
+//= Extract horizontal runs from mask and link to overlapping runs in previous line.
+// skips blank sections of mask 16 pixels at a time
+// returns number of runs found (stops if table full)
+
+int jhcQtBlob::get_runs ()
+{
+  const unsigned char *m = mask;
+  int x, y, i, p, r, ra, rb, p0 = 0, p1 = 0;
+
+  nr = 0;
+  for (y = 0; y < ih; y++, m += iw)
+  {
+    // find runs in this line
+    x = 0;
+    while (x < iw)
+    {
+      // jump over empty blocks
+      if ((x + 16 <= iw) && (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(m + x))) == 0))
+      {
+        x += 16;
+        continue;
+      }
+      if (m[x] == 0)
+      {
+        x++;
+        continue;
+      }
+
+      // record new run
+      if (nr >= rmax)
+        return nr;
+      rs[nr] = x;
+      while ((x < iw) && (m[x] != 0))
+        x++;
+      re[nr] = x - 1;
+      ry[nr] = y;
+      rp[nr] = nr;
+      nr++;
+    }
+
+    // merge with previous line runs that touch (incl. diagonally)
+    r = p0;
+    for (i = p1; i < nr; i++)
+    {
+      while ((r < p1) && (re[r] < rs[i] - 1))
+        r++;
+      for (p = r; (p < p1) && (rs[p] <= re[i] + 1); p++)
+      {
+        ra = root(i);
+        rb = root(p);
+        if (ra < rb)
+          rp[rb] = ra;
+        else if (rb < ra)
+          rp[ra] = rb;
+      }
+    }
+
+    // this line becomes previous line
+    p0 = p1;
+    p1 = nr;
+  }
+  return nr;
+}
+
+
+//= Find representative run for a component (with path halving).
+
+int jhcQtBlob::root (int i)
+{
+  while (rp[i] != i)
+  {
+    rp[i] = rp[rp[i]];
+    i = rp[i];
+  }
+  return i;
+}
+
+
+//= Accumulate area, centroid, and bounding box for each component.
+// roots always have the lowest run index of their component
+
+void jhcQtBlob::blob_stats ()
+{
+  int i, r, n;
+
+  // sum up runs into their root entry
+  for (i = 0; i < nr; i++)
+  {
+    r = root(i);
+    n = re[i] - rs[i] + 1;
+    if (r == i)
+    {
+      ca[r] = 0;
+      csx[r] = 0.0;
+      csy[r] = 0.0;
+      cx0[r] = rs[i];
+      cx1[r] = re[i];
+      cy0[r] = ry[i];
+    }
+    ca[r] += n;
+    csx[r] += 0.5 * n * (rs[i] + re[i]);
+    csy[r] += (double) n * ry[i];
+    cx0[r] = __min(cx0[r], rs[i]);
+    cx1[r] = __max(cx1[r], re[i]);
+    cy1[r] = ry[i];
+  }
+
+  // save biggest components
+  nb = 0;
+  for (i = 0; i < nr; i++)
+    if ((rp[i] == i) && (ca[i] >= amin))
+      keep_blob(ca[i], csx[i], csy[i], cx0[i], cy0[i], cx1[i], cy1[i]);
+}
+
+
+//= Insert blob into list sorted by decreasing area (drops smallest if full).
+
+void jhcQtBlob::keep_blob (int a, double sx, double sy, int x0, int y0, int x1, int y1)
+{
+  int i, j;
+
+  // find position in list
+  for (i = 0; i < nb; i++)
+    if (a > area[i])
+      break;
+  if (i >= bmax)
+    return;
+
+  // shift smaller entries down
+  for (j = __min(nb, bmax - 1); j > i; j--)
+  {
+    area[j] = area[j - 1];
+    cx[j]  = cx[j - 1];
+    cy[j]  = cy[j - 1];
+    bx0[j] = bx0[j - 1];
+    by0[j] = by0[j - 1];
+    bx1[j] = bx1[j - 1];
+    by1[j] = by1[j - 1];
+  }
+  nb = __min(nb + 1, bmax);
+
+  // fill in new entry
+  area[i] = a;
+  cx[i]  = (float)(sx / a);
+  cy[i]  = (float)(sy / a);
+  bx0[i] = x0;
+  by0[i] = y0;
+  bx1[i] = x1;
+  by1[i] = y1;
+  fok[i] = 0;
+}
@@ -0,0 +1,280 @@
+// jhcQtCamTrack.cpp : online refinement of Qtruck camera mount angles
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtCamTrack.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcQtCamTrack::jhcQtCamTrack ()
+{
+  // fingertip marks
+  rad  = 24;                 // search window radius
+  amin = 8;                  // smallest visible mark
+  amax = 600;                // bigger means red object nearby
+
+  // measurement model
+  psd  = 2.0;                // centroid noise (pixels)
+  gate = 4.0;                // outlier threshold (sigmas)
+  bump = 5;                  // consecutive rejects before reopening
+
+  // estimate dynamics
+  asd  = 3.0;                // initial uncertainty (degs)
+  lam  = 0.98;               // forgetting per measurement
+  dmax = 10.0;               // max drift from calibration (degs)
+
+  // no estimate yet
+  Reset(0.0, 0.0, 0.0, 204.4);
+}
+
+
+//= Start estimate at calibrated mount offsets with given optics.
+
+void jhcQtCamTrack::Reset (double cp0, double ct0, double cr0, double flen, int w, int h)
+{
+  iw = w;
+  ih = h;
+  prj.SetSize(w, h, flen);
+  a0[0] = cp0;
+  a0[1] = ct0;
+  a0[2] = cr0;
+  ep = cp0;
+  et = ct0;
+  er = cr0;
+  reopen();
+  nup = 0;
+  nrej = 0;
+}
+
+
+//= Set covariance back to initial uncertainty.
+
+void jhcQtCamTrack::reopen ()
+{
+  int i, j;
+
+  for (j = 0; j < 3; j++)
+    for (i = 0; i < 3; i++)
+      P[j][i] = ((i == j) ? asd * asd : 0.0);
+  nbad = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Main Functions                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find pixels (y bottom-up) where points should appear given current offsets.
+// camera pan and tilt are raw arm values (without mount offsets)
+// returns number of points whose search window is entirely inside image
+
+int jhcQtCamTrack::Predict (double *u, double *v, const double *x, const double *y, const double *z, int n,
+                            double cx, double cy, double cz, double pan, double tilt) const
+{
+  int i, cnt = 0;
+
+  for (i = 0; i < n; i++)
+    if (prj.Project(u[i], v[i], x[i], y[i], z[i], cx, cy, cz, pan + ep, tilt + et, er) > 0)
+      if ((u[i] >= rad) && (u[i] < (iw - 1 - rad)) && (v[i] >= rad) && (v[i] < (ih - 1 - rad)))
+        cnt++;
+  return cnt;
+}
+
+
+//= Find centroid of marked pixels in window around predicted position.
+// mask is same size as image with non-zero for marked pixels
+// returns number of marked pixels, 0 if too few or too many
+
+int jhcQtCamTrack::Spot (double& mu, double& mv, const unsigned char *mask, double u, double v) const
+{
+  const unsigned char *m;
+  int x, y, x0, x1, y0, y1, sx = 0, sy = 0, cnt = 0;
+
+  // clip window to image
+  mu = u;
+  mv = v;
+  if (mask == NULL)
+    return 0;
+  x0 = __max(0, (int)(u - rad));
+  x1 = __min((int)(u + rad), iw - 1);
+  y0 = __max(0, (int)(v - rad));
+  y1 = __min((int)(v + rad), ih - 1);
+
+  // accumulate marked pixels
+  for (y = y0; y <= y1; y++)
+  {
+    m = mask + y * iw;
+    for (x = x0; x <= x1; x++)
+      if (m[x] != 0)
+      {
+        sx += x;
+        sy += y;
+        cnt++;
+      }
+  }
+  if ((cnt < amin) || (cnt > amax))
+    return 0;
+  mu = sx / (double) cnt;
+  mv = sy / (double) cnt;
+  return cnt;
+}
+
+
+//= Refine mount offsets given measured pixels (y bottom-up) of known points.
+// camera pan and tilt are raw arm values when image was taken
+// whole measurement is rejected if any coordinate fails innovation gate
+// returns 1 if estimate changed, 0 if rejected
+
+int jhcQtCamTrack::Update (const double *mu, const double *mv, const double *x, const double *y, const double *z, int n,
+                           double cx, double cy, double cz, double pan, double tilt)
+{
+  double h[pmax][6], eu[pmax], ev[pmax], a[3], lin[3] = {ep, et, er}, r = psd * psd;
+  double u0, v0, s, cap = asd * asd;
+  int i, j, k, np = __min(n, pmax);
+
+  if (np <= 0)
+    return 0;
+
+  // linearize around current estimate and check for outliers
+  for (i = 0; i < np; i++)
+  {
+    jacobian(h[i], u0, v0, x[i], y[i], z[i], cx, cy, cz, pan, tilt, lin);
+    eu[i] = mu[i] - u0;
+    ev[i] = mv[i] - v0;
+    if ((innovation(h[i], eu[i]) > gate) || (innovation(h[i] + 3, ev[i]) > gate))
+    {
+      // persistent disagreement probably means mount moved
+      nrej++;
+      if (++nbad >= bump)
+        reopen();
+      return 0;
+    }
+  }
+
+  // fold in each coordinate as a separate scalar measurement
+  for (k = 0; k < 3; k++)
+    a[k] = lin[k];
+  for (i = 0; i < np; i++)
+  {
+    correct(a, h[i], eu[i], r);
+    correct(a, h[i] + 3, ev[i], r);
+  }
+
+  // forget old data slowly but never exceed initial uncertainty
+  for (j = 0; j < 3; j++)
+    for (i = 0; i < 3; i++)
+      P[j][i] /= lam;
+  for (k = 0; k < 3; k++)
+    if (P[k][k] > cap)
+    {
+      s = sqrt(cap / P[k][k]);
+      for (i = 0; i < 3; i++)
+      {
+        P[k][i] *= s;
+        P[i][k] *= s;
+      }
+    }
+
+  // keep near original calibration
+  for (k = 0; k < 3; k++)
+    a[k] = __max(a0[k] - dmax, __min(a[k], a0[k] + dmax));
+  ep = a[0];
+  et = a[1];
+  er = a[2];
+  nbad = 0;
+  nup++;
+  return 1;
+}
+
+
+//= Numerically find pixel derivatives wrt pan, tilt, and roll offsets.
+// h gets du/da in first 3 entries and dv/da in last 3 entries
+// also gives projection at nominal offsets
+
+void jhcQtCamTrack::jacobian (double *h, double& u0, double& v0, double x, double y, double z,
+                              double cx, double cy, double cz, double pan, double tilt, const double *a) const
+{
+  double b[3], u1, v1, u2, v2, d = 0.05;
+  int k;
+
+  prj.Project(u0, v0, x, y, z, cx, cy, cz, pan + a[0], tilt + a[1], a[2]);
+  for (k = 0; k < 3; k++)
+  {
+    b[0] = a[0];
+    b[1] = a[1];
+    b[2] = a[2];
+    b[k] = a[k] + d;
+    prj.Project(u1, v1, x, y, z, cx, cy, cz, pan + b[0], tilt + b[1], b[2]);
+    b[k] = a[k] - d;
+    prj.Project(u2, v2, x, y, z, cx, cy, cz, pan + b[0], tilt + b[1], b[2]);
+    h[k]     = (u1 - u2) / (2.0 * d);
+    h[k + 3] = (v1 - v2) / (2.0 * d);
+  }
+}
+
+
+//= Size of residual relative to its predicted standard deviation.
+
+double jhcQtCamTrack::innovation (const double *h, double e) const
+{
+  double s = psd * psd;
+  int i, j;
+
+  for (j = 0; j < 3; j++)
+    for (i = 0; i < 3; i++)
+      s += h[j] * P[j][i] * h[i];
+  return(fabs(e) / sqrt(s));
+}
+
+
+//= Standard recursive least squares step for one scalar measurement.
+// residual e is wrt linearization point so subtract change so far
+
+void jhcQtCamTrack::correct (double *a, const double *h, double e, double r)
+{
+  double ph[3], k[3], s = r, d = e;
+  int i, j;
+
+  // gain from covariance
+  for (j = 0; j < 3; j++)
+  {
+    ph[j] = P[j][0] * h[0] + P[j][1] * h[1] + P[j][2] * h[2];
+    s += h[j] * ph[j];
+  }
+  for (j = 0; j < 3; j++)
+    k[j] = ph[j] / s;
+
+  // update estimate then shrink covariance
+  d -= h[0] * (a[0] - ep) + h[1] * (a[1] - et) + h[2] * (a[2] - er);
+  for (j = 0; j < 3; j++)
+    a[j] += k[j] * d;
+  for (j = 0; j < 3; j++)
+    for (i = 0; i < 3; i++)
+      P[j][i] -= k[j] * ph[i];
+}
@@ -0,0 +1,93 @@
+// jhcQtCamTrack.h : online refinement of Qtruck camera mount angles
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "jhcQtFloor.h"
+
+
+//= Online refinement of Qtruck camera mount angles.
+// fingertips are rigid wrt camera (given jaw width) so their predicted
+// pixels only depend on pan, tilt, and roll offsets of the mount
+// compares predictions with marked fingertips found in small windows
+// and runs recursive least squares (with forgetting) on the 3 offsets
+// innovation gate rejects occlusions but a persistent shift (mount
+// got bumped) reopens the covariance so estimate can follow it
+
+class jhcQtCamTrack
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int pmax = 4;           // max points per update
+
+  // projection with arbitrary pose
+  jhcQtFloor prj;
+  int iw, ih;
+
+  // estimate covariance and starting values
+  double P[3][3], a0[3];
+  int nbad;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // search window radius (pixels) and min/max marked pixels in window
+  int rad, amin, amax;
+
+  // pixel noise (sd), innovation gate (sigmas), and rejects before reopening
+  double psd, gate;
+  int bump;
+
+  // initial sd (degs), forgetting factor, and max change from start (degs)
+  double asd, lam, dmax;
+
+  // current pan, tilt, and roll offsets (degs)
+  double ep, et, er;
+
+  // number of accepted and rejected measurements
+  int nup, nrej;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  jhcQtCamTrack ();
+  void Reset (double cp0, double ct0, double cr0, double flen, int w =640, int h =480);
+
+  // main functions
+  int Predict (double *u, double *v, const double *x, const double *y, const double *z, int n,
+               double cx, double cy, double cz, double pan, double tilt) const;
+  int Spot (double& mu, double& mv, const unsigned char *mask, double u, double v) const;
+  int Update (const double *mu, const double *mv, const double *x, const double *y, const double *z, int n,
+              double cx, double cy, double cz, double pan, double tilt);
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // main functions
+  void jacobian (double *h, double& u0, double& v0, double x, double y, double z,
+                 double cx, double cy, double cz, double pan, double tilt, const double *a) const;
+  double innovation (const double *h, double e) const;
+  void correct (double *a, const double *h, double e, double r);
+  void reopen ();
+
+};
@@ -0,0 +1,307 @@
+// jhcQtFloor.cpp : image pixel to floor coordinate projection for Qtruck
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtFloor.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcQtFloor::~jhcQtFloor ()
+{
+  dealloc();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcQtFloor::jhcQtFloor ()
+{
+  // no table yet
+  gx = NULL;
+  gy = NULL;
+  gok = NULL;
+  built = 0;
+
+  // rebuild thresholds and range limit
+  ptol = 0.1;                // camera shift (in)
+  atol = 0.5;                // camera rotation (deg)
+  rmax = 120.0;              // beyond this is nearly horizon
+
+  // typical Esp32 camera after undistortion
+  SetSize(640, 480, 204.4);
+}
+
+
+//= Get rid of table.
+
+void jhcQtFloor::dealloc ()
+{
+  delete [] gok;
+  delete [] gy;
+  delete [] gx;
+  gx = NULL;
+  gy = NULL;
+  gok = NULL;
+}
+
+
+//= Set image dimensions, focal length, and grid spacing (invalidates table).
+
+void jhcQtFloor::SetSize (int w, int h, double f, int b)
+{
+  // save optics
+  iw = w;
+  ih = h;
+  flen = f;
+  xmid = 0.5 * (w - 1);
+  ymid = 0.5 * (h - 1);
+  blk = __max(1, b);
+
+  // allocate nodes including far image edges
+  dealloc();
+  gw = (iw + blk - 2) / blk + 1;
+  gh = (ih + blk - 2) / blk + 1;
+  gx = new float [gw * gh];
+  gy = new float [gw * gh];
+  gok = new unsigned char [gw * gh];
+  built = 0;
+}
+
+
+//= Give current camera position and viewing direction.
+// pan is CCW from forward, tilt is up from horizontal, roll is image rotation
+// rebuilds table only if pose is significantly different from last build
+// returns 1 if table rebuilt, 0 if still valid
+
+int jhcQtFloor::Pose (double x, double y, double z, double pan, double tilt, double roll)
+{
+  // see if same as before
+  if ((built > 0) && 
+      (fabs(x - cx0) <= ptol) && (fabs(y - cy0) <= ptol) && (fabs(z - cz0) <= ptol) &&
+      (fabs(pan - p0) <= atol) && (fabs(tilt - t0) <= atol) && (fabs(roll - r0) <= atol))
+    return 0;
+
+  // save new pose and project all grid nodes
+  cx0 = x;
+  cy0 = y;
+  cz0 = z;
+  p0 = pan;
+  t0 = tilt;
+  r0 = roll;
+  fill_grid();
+  built = 1;
+  return 1;
+}
+
+
+//= Find floor intersection for every grid node.
+
+void jhcQtFloor::fill_grid ()
+{
+  double fx, fy;
+  int i, j, k = 0;
+
+  for (j = 0; j < gh; j++)
+    for (i = 0; i < gw; i++, k++)
+    {
+      gok[k] = (unsigned char) ray_hit(fx, fy, __min(i * blk, iw - 1), __min(j * blk, ih - 1));
+      gx[k] = (float) fx;
+      gy[k] = (float) fy;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                              Projection                               //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get floor position seen at some image pixel (y bottom-up).
+// returns 1 if valid, 0 if above horizon, too far, or no pose yet
+
+int jhcQtFloor::Floor (double& fx, double& fy, double px, double py) const
+{
+  if (built <= 0)
+    return 0;
+  return lookup(fx, fy, px, py);
+}
+
+
+//= Get floor positions for a whole list of pixels (y bottom-up).
+// optional "ok" array gets 1 for each valid point, 0 otherwise
+// returns number of valid points found
+
+int jhcQtFloor::Batch (float *fx, float *fy, const float *px, const float *py, int n, unsigned char *ok) const
+{
+  double x, y;
+  int i, v, cnt = 0;
+
+  for (i = 0; i < n; i++)
+  {
+    x = 0.0;
+    y = 0.0;
+    v = 0;
+    if (built > 0)
+      v = lookup(x, y, px[i], py[i]);
+    fx[i] = (float) x;
+    fy[i] = (float) y;
+    if (ok != NULL)
+      ok[i] = (unsigned char) v;
+    cnt += v;
+  }
+  return cnt;
+}
+
+
+//= Interpolate floor position from nearby grid nodes.
+// all four surrounding nodes must be valid
+
+int jhcQtFloor::lookup (double& fx, double& fy, double px, double py) const
+{
+  double wx, wy, w00, w01, w10, w11;
+  int i, j, k;
+
+  // find cell and fractional position within it
+  if ((px < 0.0) || (px > iw - 1) || (py < 0.0) || (py > ih - 1))
+    return 0;
+  wx = px / blk;
+  wy = py / blk;
+  i = __min((int) wx, gw - 2);
+  j = __min((int) wy, gh - 2);
+  wx = (px - i * blk) / (__min((i + 1) * blk, iw - 1) - i * blk);
+  wy = (py - j * blk) / (__min((j + 1) * blk, ih - 1) - j * blk);
+  k = j * gw + i;
+  if ((gok[k] & gok[k + 1] & gok[k + gw] & gok[k + gw + 1]) == 0)
+    return 0;
+
+  // bilinear combination
+  w00 = (1.0 - wx) * (1.0 - wy);
+  w01 = wx * (1.0 - wy);
+  w10 = (1.0 - wx) * wy;
+  w11 = wx * wy;
+  fx = w00 * gx[k] + w01 * gx[k + 1] + w10 * gx[k + gw] + w11 * gx[k + gw + 1];
+  fy = w00 * gy[k] + w01 * gy[k + 1] + w10 * gy[k + gw] + w11 * gy[k + gw + 1];
+  return 1;
+}
+
+
+//= Project single pixel directly without using table (slower).
+// returns 1 if valid, 0 if above horizon, too far, or no pose yet
+
+int jhcQtFloor::Exact (double& fx, double& fy, double px, double py) const
+{
+  if (built <= 0)
+    return 0;
+  return ray_hit(fx, fy, px, py);
+}
+
+
+//= Intersect ray through some pixel with floor using saved camera pose.
+// returns 1 if valid, 0 if above horizon or too far
+
+int jhcQtFloor::ray_hit (double& fx, double& fy, double px, double py) const
+{
+  double D2R = M_PI / 180.0, cp = cos(p0 * D2R), sp = sin(p0 * D2R);
+  double ct = cos(t0 * D2R), st = sin(t0 * D2R), cr = cos(r0 * D2R), sr = sin(r0 * D2R);
+  double u, v, rx, ry, rz, hx, s;
+
+  // undo image roll
+  u = px - xmid;
+  v = py - ymid;
+  hx = u * cr + v * sr;
+  v = v * cr - u * sr;
+  u = hx;
+
+  // apply tilt then pan (CCW) to get ray in robot coordinates
+  ry = flen * ct - v * st;
+  rz = flen * st + v * ct;
+  rx = u * cp - ry * sp;
+  ry = u * sp + ry * cp;
+
+  // intersect with floor
+  fx = 0.0;
+  fy = 0.0;
+  if (rz >= -1e-6)
+    return 0;
+  s = -cz0 / rz;
+  fx = cx0 + s * rx;
+  fy = cy0 + s * ry;
+  if (s * sqrt(rx * rx + ry * ry) > rmax)
+    return 0;
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Reverse Mapping                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find image pixel (y bottom-up) where some 3D point appears for saved pose.
+// point need not be on floor, result may be outside image bounds
+// returns 1 if in front of camera, 0 if behind or no pose yet
+
+int jhcQtFloor::Pixel (double& px, double& py, double x, double y, double z) const
+{
+  px = xmid;
+  py = ymid;
+  if (built <= 0)
+    return 0;
+  return Project(px, py, x, y, z, cx0, cy0, cz0, p0, t0, r0);
+}
+
+
+//= Find image pixel (y bottom-up) where 3D point appears for arbitrary pose.
+// exact inverse of ray_hit using current optics (table unaffected)
+// returns 1 if in front of camera, 0 if behind
+
+int jhcQtFloor::Project (double& px, double& py, double x, double y, double z, 
+                         double cx, double cy, double cz, double pan, double tilt, double roll) const
+{
+  double D2R = M_PI / 180.0, cp = cos(pan * D2R), sp = sin(pan * D2R);
+  double ct = cos(tilt * D2R), st = sin(tilt * D2R), cr = cos(roll * D2R), sr = sin(roll * D2R);
+  double dx = x - cx, dy = y - cy, dz = z - cz, u, v, f, rf, sc;
+
+  // undo pan then tilt to get direction in camera frame
+  u  = dx * cp + dy * sp;
+  rf = dy * cp - dx * sp;
+  f  = rf * ct + dz * st;
+  v  = dz * ct - rf * st;
+  px = xmid;
+  py = ymid;
+  if (f <= 1e-6)
+    return 0;
+
+  // perspective scaling then reapply image roll
+  sc = flen / f;
+  u *= sc;
+  v *= sc;
+  px = xmid + u * cr - v * sr;
+  py = ymid + u * sr + v * cr;
+  return 1;
+}
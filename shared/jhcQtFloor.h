@@ -0,0 +1,90 @@
+// jhcQtFloor.h : image pixel to floor coordinate projection for Qtruck
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Image pixel to floor coordinate projection for Qtruck.
+// keeps floor XY for a grid of pixels (block corners) and interpolates
+// table is only rebuilt when the camera pose changes noticeably
+// pixels are for corrected images from ocv_get (already undistorted)
+// pixel y is bottom-up (same as image buffers), floor is z = 0
+// all coordinates wrt center of robot body in inches (y forward, x right)
+
+class jhcQtFloor
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // floor position for each grid node (NULL if none yet)
+  float *gx, *gy;
+  unsigned char *gok;
+  int iw, ih, gw, gh;
+
+  // camera pose used to build table
+  double cx0, cy0, cz0, p0, t0, r0;
+  int built;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // optics (pixels)
+  double flen, xmid, ymid;
+
+  // pixels between grid nodes
+  int blk;
+
+  // pose change which forces rebuild (in and deg)
+  double ptol, atol;
+
+  // farthest valid floor point (in)
+  double rmax;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcQtFloor ();
+  jhcQtFloor ();
+  void SetSize (int w, int h, double f, int b =8);
+  int Pose (double x, double y, double z, double pan, double tilt, double roll);
+  void Reset () {built = 0;}
+
+  // projection
+  int Floor (double& fx, double& fy, double px, double py) const;
+  int Batch (float *fx, float *fy, const float *px, const float *py, int n, unsigned char *ok =NULL) const;
+  int Exact (double& fx, double& fy, double px, double py) const;
+  int Pixel (double& px, double& py, double x, double y, double z) const;
+  int Project (double& px, double& py, double x, double y, double z, 
+               double cx, double cy, double cz, double pan, double tilt, double roll) const;
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // creation and initialization
+  void dealloc ();
+  void fill_grid ();
+
+  // projection
+  int ray_hit (double& fx, double& fy, double px, double py) const;
+  int lookup (double& fx, double& fy, double px, double py) const;
+
+};
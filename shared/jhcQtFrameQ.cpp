@@ -0,0 +1,231 @@
+// jhcQtFrameQ.cpp : bounded image queue between pipeline threads
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include "jhcQtFrameQ.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcQtFrameQ::~jhcQtFrameQ ()
+{
+  dealloc();
+  pthread_mutex_destroy(&lock);
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcQtFrameQ::jhcQtFrameQ ()
+{
+  int i;
+
+  for (i = 0; i < qmax; i++)
+    pool[i] = NULL;
+  lock = INVALID_HANDLE_VALUE;
+  nb = 0;
+  sz = 0;
+  nq = 0;
+  posts = 0;
+  drops = 0;
+}
+
+
+//= Get rid of all buffers.
+
+void jhcQtFrameQ::dealloc ()
+{
+  int i;
+
+  for (i = 0; i < qmax; i++)
+  {
+    delete [] pool[i];
+    pool[i] = NULL;
+  }
+  nb = 0;
+}
+
+
+//= Make a pool of some number of buffers each of a certain size.
+// needs at least 3 (one being written, one being read, one waiting)
+// call before starting any threads that use queue
+// returns number of buffers made
+
+int jhcQtFrameQ::Init (int n, int bytes)
+{
+  int i;
+
+  pthread_mutex_lock(lock)
+  dealloc();
+  nb = __max(3, __min(n, qmax));
+  sz = bytes;
+  for (i = 0; i < nb; i++)
+  {
+    pool[i] = new unsigned char [sz];
+    state[i] = 0;
+    stamp[i] = 0;
+  }
+  nq = 0;
+  posts = 0;
+  drops = 0;
+  pthread_mutex_unlock(lock)
+  return nb;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Producer Side                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get an empty buffer to write into (never blocks).
+// takes back oldest waiting image if all others are in use
+// deliberately drops rather than stalling producer (see header)
+// returns NULL if nothing available (should not happen)
+
+unsigned char *jhcQtFrameQ::Fill ()
+{
+  unsigned char *buf = NULL;
+  int i;
+
+  pthread_mutex_lock(lock)
+  for (i = 0; i < nb; i++)
+    if (state[i] == 0)
+      break;
+  if ((i >= nb) && ((i = pop_oldest()) >= 0))
+    drops++;
+  if ((i >= 0) && (i < nb))
+  {
+    state[i] = 1;
+    buf = pool[i];
+  }
+  pthread_mutex_unlock(lock)
+  return buf;
+}
+
+
+//= Hand a filled buffer to consumer along with its capture time.
+
+void jhcQtFrameQ::Post (unsigned char *buf, unsigned long ms)
+{
+  int i;
+
+  pthread_mutex_lock(lock)
+  if (((i = find_buf(buf)) >= 0) && (state[i] == 1))
+  {
+    state[i] = 2;
+    stamp[i] = ms;
+    fifo[nq++] = i;
+    posts++;
+  }
+  pthread_mutex_unlock(lock)
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Consumer Side                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get oldest waiting image and optionally its capture time (never blocks).
+// buffer must be given back with Release() when done
+// returns NULL if nothing waiting
+
+unsigned char *jhcQtFrameQ::Next (unsigned long *ms)
+{
+  unsigned char *buf = NULL;
+  int i;
+
+  pthread_mutex_lock(lock)
+  if ((i = pop_oldest()) >= 0)
+  {
+    state[i] = 3;
+    buf = pool[i];
+    if (ms != NULL)
+      *ms = stamp[i];
+  }
+  pthread_mutex_unlock(lock)
+  return buf;
+}
+
+
+//= Return a buffer to the free pool.
+
+void jhcQtFrameQ::Release (unsigned char *buf)
+{
+  int i;
+
+  pthread_mutex_lock(lock)
+  if ((i = find_buf(buf)) >= 0)
+    state[i] = 0;
+  pthread_mutex_unlock(lock)
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Helpers                                 //
+///////////////////////////////////////////////////////////////////////////
+
+//= Number of images waiting to be processed.
+
+int jhcQtFrameQ::Waiting ()
+{
+  int n;
+
+  pthread_mutex_lock(lock)
+  n = nq;
+  pthread_mutex_unlock(lock)
+  return n;
+}
+
+
+//= Find pool index for some buffer pointer.
+// returns -1 if not part of pool
+
+int jhcQtFrameQ::find_buf (const unsigned char *buf) const
+{
+  int i;
+
+  for (i = 0; i < nb; i++)
+    if (pool[i] == buf)
+      return i;
+  return -1;
+}
+
+
+//= Remove oldest entry from queue of full buffers.
+// returns pool index, -1 if queue empty
+// NOTE: expects lock to be held by caller
+
+int jhcQtFrameQ::pop_oldest ()
+{
+  int i, k;
+
+  if (nq <= 0)
+    return -1;
+  k = fifo[0];
+  for (i = 1; i < nq; i++)
+    fifo[i - 1] = fifo[i];
+  nq--;
+  return k;
+}
@@ -0,0 +1,90 @@
+// jhcQtFrameQ.h : bounded image queue between pipeline threads
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <windows.h>
+
+#include "jhc_pthread.h"
+
+
+//= Bounded image queue between pipeline threads.
+// fixed pool of image buffers passes from a single producer to a single
+// consumer in order, producer never waits: if no buffer is free it 
+// reclaims the oldest unread image (dropped) so consumer sees fresh data
+// NOTE: pool size bounds memory and latency instead of true back-pressure
+//       since stalling a live camera would only make every frame older
+//       (the stream keeps running), drops are counted for statistics
+
+class jhcQtFrameQ
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int qmax = 8;           // max pool size
+
+  // image buffers, capture times, and status (0 free, 1 write, 2 full, 3 read)
+  unsigned char *pool[qmax];
+  unsigned long stamp[qmax];
+  int state[qmax];
+  int nb, sz;
+
+  // full buffers in arrival order
+  int fifo[qmax];
+  int nq;
+
+  // access control and statistics
+  pthread_mutex_t lock;
+  int posts, drops;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcQtFrameQ ();
+  jhcQtFrameQ ();
+  int Init (int n, int bytes);
+  int Size () const {return nb;}
+
+  // producer side
+  unsigned char *Fill ();
+  void Post (unsigned char *buf, unsigned long ms);
+
+  // consumer side
+  unsigned char *Next (unsigned long *ms =NULL);
+  void Release (unsigned char *buf);
+
+  // statistics
+  int Waiting ();
+  int Posted () const {return posts;}
+  int Dropped () const {return drops;}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // creation and initialization
+  void dealloc ();
+
+  // helpers
+  int find_buf (const unsigned char *buf) const;
+  int pop_oldest ();
+
+};
@@ -0,0 +1,227 @@
+// jhcQtGrasp.cpp : checks whether Qtruck gripper is holding something
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtGrasp.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcQtGrasp::jhcQtGrasp ()
+{
+  // evidence thresholds
+  dth   = 60;                // summed BGR difference
+  dfrac = 0.5;               // half of cells different
+  rfrac = 0.3;               // lots of red
+
+  // temporal behavior
+  mix  = 0.1;                // about 10 frames to learn
+  hits = 3;                  // frames before changing mind
+
+  // typical Esp32 camera
+  SetSize(640, 480);
+  Reset();
+  nuse = 0;
+  dev = 0.0;
+  red = 0.0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Examine region between jaws in BGR image (y bottom-up) to see if anything there.
+// optional mask marks red pixels (same size as image, non-zero = red)
+// if learn is positive then caller is sure gripper is empty (updates model)
+// without a model only red pixels count (independent of background)
+// jx0 and jx1 are inner image columns of jaws if inside region (else negative)
+// returns 1 if holding something, 0 if empty, -1 if just learning
+
+int jhcQtGrasp::Update (const unsigned char *img, const unsigned char *mask,
+                        int x0, int y0, int x1, int y1, int learn, int jx0, int jx1)
+{
+  int ev, lx = __max(0, x0), ly = __max(0, y0), hx = __min(x1, iw - 1), hy = __min(y1, ih - 1);
+
+  // need at least one pixel for each cell
+  dev = 0.0;
+  red = 0.0;
+  if (((hx - lx + 1) < gw) || ((hy - ly + 1) < gh))
+    return held;
+
+  // gather evidence (jaws closed on nothing gives none)
+  clear_cols(lx, hx, jx0, jx1);
+  cell_colors(img, lx, ly, hx, hy);
+  if (jx0 < 0)
+    red = red_frac(mask, lx, ly, hx, hy);
+  else if (jx1 > jx0)
+    red = red_frac(mask, __max(lx, jx0), ly, __min(hx, jx1), hy);
+  if ((mok > 0) && (nuse > 0))
+    dev = changed();
+  ev = (((red >= rfrac) || (dev >= dfrac)) ? 1 : 0);
+
+  // caller knows gripper is empty (do not learn red objects sitting between jaws)
+  if (learn > 0)
+  {
+    if (red < rfrac)
+      blend();
+    flip = 0;
+    held = 0;
+    return -1;
+  }
+
+  // change decision only if evidence persists
+  if (ev == held)
+    flip = 0;
+  else if (++flip >= hits)
+  {
+    held = ev;
+    flip = 0;
+  }
+  return held;
+}
+
+
+//= Mark which grid columns lie entirely between the jaws.
+// all columns are usable if jaws are outside region (jx0 negative)
+
+void jhcQtGrasp::clear_cols (int x0, int x1, int jx0, int jx1)
+{
+  int i, cx0, cx1, w = x1 - x0 + 1;
+
+  nuse = 0;
+  for (i = 0; i < gw; i++)
+  {
+    cx0 = x0 + (i * w) / gw;
+    cx1 = x0 + ((i + 1) * w) / gw;
+    use[i] = (((jx0 < 0) || ((cx0 >= jx0) && (cx1 <= jx1))) ? 1 : 0);
+    nuse += use[i];
+  }
+}
+
+
+//= Find average color in each cell of grid covering the region.
+// only samples every other pixel on every other line
+
+void jhcQtGrasp::cell_colors (const unsigned char *img, int x0, int y0, int x1, int y1)
+{
+  const unsigned char *s;
+  int sum[3], i, j, x, y, cx0, cx1, cy0, cy1, n, ln = 3 * iw;
+  int w = x1 - x0 + 1, h = y1 - y0 + 1;
+
+  for (j = 0; j < gh; j++)
+  {
+    cy0 = y0 + (j * h) / gh;
+    cy1 = y0 + ((j + 1) * h) / gh;
+    for (i = 0; i < gw; i++)
+    {
+      // sum colors over cell
+      cx0 = x0 + (i * w) / gw;
+      cx1 = x0 + ((i + 1) * w) / gw;
+      sum[0] = 0;
+      sum[1] = 0;
+      sum[2] = 0;
+      n = 0;
+      for (y = cy0; y < cy1; y += 2)
+      {
+        s = img + y * ln + 3 * cx0;
+        for (x = cx0; x < cx1; x += 2, s += 6, n++)
+        {
+          sum[0] += s[0];
+          sum[1] += s[1];
+          sum[2] += s[2];
+        }
+      }
+
+      // save averages
+      n = __max(1, n);
+      cur[j][i][0] = sum[0] / (float) n;
+      cur[j][i][1] = sum[1] / (float) n;
+      cur[j][i][2] = sum[2] / (float) n;
+    }
+  }
+}
+
+
+//= Fraction of usable cells significantly different from empty model.
+
+double jhcQtGrasp::changed () const
+{
+  double d;
+  int i, j, cnt = 0;
+
+  for (j = 0; j < gh; j++)
+    for (i = 0; i < gw; i++)
+    {
+      if (use[i] <= 0)
+        continue;
+      d = fabs(cur[j][i][0] - mod[j][i][0]) + fabs(cur[j][i][1] - mod[j][i][1]) +
+          fabs(cur[j][i][2] - mod[j][i][2]);
+      if (d > dth)
+        cnt++;
+    }
+  return(cnt / (double)(nuse * gh));
+}
+
+
+//= Fraction of pixels in region marked as red (every other pixel and line).
+
+double jhcQtGrasp::red_frac (const unsigned char *mask, int x0, int y0, int x1, int y1) const
+{
+  const unsigned char *m;
+  int x, y, n = 0, cnt = 0;
+
+  if (mask == NULL)
+    return 0.0;
+  for (y = y0; y <= y1; y += 2)
+  {
+    m = mask + y * iw;
+    for (x = x0; x <= x1; x += 2, n++)
+      if (m[x] != 0)
+        cnt++;
+  }
+  return(cnt / (double) __max(1, n));
+}
+
+
+//= Mix current cell colors into empty model (first time copies).
+
+void jhcQtGrasp::blend ()
+{
+  float f = (float) mix;
+  int i, j, k;
+
+  for (j = 0; j < gh; j++)
+    for (i = 0; i < gw; i++)
+      for (k = 0; k < 3; k++)
+        if (mok <= 0)
+          mod[j][i][k] = cur[j][i][k];
+        else
+          mod[j][i][k] += f * (cur[j][i][k] - mod[j][i][k]);
+  mok = 1;
+}
@@ -0,0 +1,95 @@
+// jhcQtGrasp.h : checks whether Qtruck gripper is holding something
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Checks whether Qtruck gripper is holding something.
+// only looks at image region between jaws (supplied by caller)
+// region is reduced to a coarse grid of average colors and compared to
+// a learned model of what the region looks like when empty
+// model only valid for the pose and window it was learned at (caller
+// should Reset it whenever the camera, arm, or base moves)
+// red pixels (from object finder mask) also count as strong evidence
+// if jaws are inside region then only columns between them are examined
+// decision has hysteresis so a few bad frames do not flip it
+// typically 10-20 us per frame so can run on every one
+
+class jhcQtGrasp
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int gw = 8;             // grid cells across
+  static const int gh = 4;             // grid cells down
+
+  // current cell colors and empty model (BGR)
+  float cur[gh][gw][3], mod[gh][gw][3];
+  int iw, ih, mok;
+
+  // grid columns clear of jaws
+  int use[gw], nuse;
+
+  // frames in a row disagreeing with decision
+  int flip;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // cell color difference and fraction of cells for evidence
+  int dth;
+  double dfrac;
+
+  // fraction of red pixels that means object present
+  double rfrac;
+
+  // model blending rate and frames needed to change decision
+  double mix;
+  int hits;
+
+  // fraction of changed cells, fraction of red, and decision
+  double dev, red;
+  int held;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  jhcQtGrasp ();
+  void SetSize (int w, int h) {iw = w; ih = h;}
+  void Reset () {mok = 0; flip = 0; held = 0;}
+  int Learned () const {return mok;}
+
+  // main functions
+  int Update (const unsigned char *img, const unsigned char *mask,
+              int x0, int y0, int x1, int y1, int learn =0, int jx0 =-1, int jx1 =-1);
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // main functions
+  void clear_cols (int x0, int x1, int jx0, int jx1);
+  void cell_colors (const unsigned char *img, int x0, int y0, int x1, int y1);
+  double changed () const;
+  double red_frac (const unsigned char *mask, int x0, int y0, int x1, int y1) const;
+  void blend ();
+
+};
@@ -0,0 +1,582 @@
+// jhcQtLens.cpp : lens distortion fitting for Qtruck camera
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtLens.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcQtLens::jhcQtLens ()
+{
+  // nominal values for 160 degree Esp32 lens
+  r2f  =   0.7;
+  r4f  = -11.0;
+  mag  =   1.0;
+  asp  =   1.0;
+  dx   =   0.0;
+  dy   =   0.0;
+  full =   1;
+  err  =   0.0;
+
+  // no data yet
+  SetSize(640, 480);
+  Clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Add dot centers from one raw view of the grid target.
+// dots must be roughly evenly spaced (perspective and distortion okay)
+// returns number of lines added, 0 if grid not found or no room
+
+int jhcQtLens::AddView (const float *x, const float *y, int n)
+{
+  int rows, cols;
+
+  if ((n < 9) || (n > dmax))
+    return 0;
+  if (link_grid(x, y, n) < 9)
+    return 0;
+  rows = save_lines(x, y, n, 1);
+  cols = save_lines(x, y, n, 0);
+  if ((rows + cols) > 0)
+    nv++;
+  return(rows + cols);
+}
+
+
+//= Adjust distortion and lens center to make all lines straight.
+// starts from current values, magnification is not changed
+// returns 1 if successful, 0 if not enough data
+
+int jhcQtLens::Fit ()
+{
+  double m[4][5], dq[4], q2[4], dv[4] = {0.01, 0.1, 0.1, 0.1};
+  double q[4] = {r2f, r4f, dx, dy}, lam = 0.001, e0, e = 0.0;
+  double *r, *jac;
+  int i, j, k, n, it, ok;
+
+  // need several lines in different parts of image
+  if (nl < 6)
+    return 0;
+  r = new double [5 * npt];
+  jac = r + npt;
+
+  // damped Gauss-Newton with numerical derivatives
+  e0 = sq_err(q);
+  for (it = 0; it < 50; it++)
+  {
+    // sensitivity of each residual to each parameter
+    n = residuals(r, q);
+    for (j = 0; j < 4; j++)
+    {
+      for (k = 0; k < 4; k++)
+        q2[k] = q[k];
+      q2[j] += dv[j];
+      residuals(jac + j * npt, q2);
+      for (i = 0; i < n; i++)
+        jac[j * npt + i] = (jac[j * npt + i] - r[i]) / dv[j];
+    }
+
+    // increase damping until some step reduces error
+    ok = 0;
+    while (lam < 1e6)
+    {
+      for (j = 0; j < 4; j++)
+      {
+        for (k = 0; k < 4; k++)
+        {
+          m[j][k] = 0.0;
+          for (i = 0; i < n; i++)
+            m[j][k] += jac[j * npt + i] * jac[k * npt + i];
+        }
+        m[j][j] *= 1.0 + lam;
+        m[j][4] = 0.0;
+        for (i = 0; i < n; i++)
+          m[j][4] -= jac[j * npt + i] * r[i];
+      }
+      if (solve4(dq, m) > 0)
+      {
+        for (k = 0; k < 4; k++)
+          q2[k] = q[k] + dq[k];
+        if ((e = sq_err(q2)) < e0)
+        {
+          ok = 1;
+          break;
+        }
+      }
+      lam *= 10.0;
+    }
+    if (ok <= 0)
+      break;
+
+    // accept step and relax damping
+    for (k = 0; k < 4; k++)
+      q[k] = q2[k];
+    lam = __max(1e-6, 0.1 * lam);
+    if ((e0 - e) < 1e-8 * e0)
+      break;
+    e0 = e;
+  }
+
+  // save results
+  r2f = q[0];
+  r4f = q[1];
+  dx  = q[2];
+  dy  = q[3];
+  n = residuals(r, q);
+  err = sqrt(sq_err(q) / __max(1, n));
+  delete [] r;
+  return 1;
+}
+
+
+//= Pick smallest magnification that leaves no black border in corrected image.
+// if "full" is zero then only middles of image edges need to be covered
+// returns new magnification (also saved)
+
+double jhcQtLens::Zoom ()
+{
+  double lo = 0.25, hi = 4.0, m;
+  int i;
+
+  if (covered(hi) <= 0)
+    return mag;
+  for (i = 0; i < 30; i++)
+  {
+    m = 0.5 * (lo + hi);
+    if (covered(m) > 0)
+      hi = m;
+    else
+      lo = m;
+  }
+  mag = hi;
+  return mag;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Grid Linking                              //
+///////////////////////////////////////////////////////////////////////////
+
+//= Assign integer grid coordinates to dots by growing out from the center.
+// local spacing vectors are updated at each step so distortion is tolerated
+// returns number of dots assigned
+
+int jhcQtLens::link_grid (const float *x, const float *y, int n)
+{
+  double ax[dmax], ay[dmax], bx[dmax], by[dmax];
+  double mx = 0.0, my = 0.0, d2, best, ex, ey, px, py, v1x, v1y, v2x, v2y, len, c;
+  int queue[dmax], di[4] = {1, -1, 0, 0}, dj[4] = {0, 0, 1, -1};
+  int i, j, k, s = 0, nb = -1, head = 0, tail = 0, cnt = 0;
+
+  // seed is dot closest to centroid
+  for (i = 0; i < n; i++)
+  {
+    mx += x[i];
+    my += y[i];
+    gi[i] = -1000;
+  }
+  mx /= n;
+  my /= n;
+  for (i = 0; i < n; i++)
+  {
+    d2 = (x[i] - mx) * (x[i] - mx) + (y[i] - my) * (y[i] - my);
+    if ((i == 0) || (d2 < best))
+    {
+      s = i;
+      best = d2;
+    }
+  }
+
+  // first spacing vector goes to nearest neighbor
+  for (i = 0; i < n; i++)
+    if (i != s)
+    {
+      d2 = (x[i] - x[s]) * (x[i] - x[s]) + (y[i] - y[s]) * (y[i] - y[s]);
+      if ((nb < 0) || (d2 < best))
+      {
+        nb = i;
+        best = d2;
+      }
+    }
+  v1x = x[nb] - x[s];
+  v1y = y[nb] - y[s];
+  len = sqrt(v1x * v1x + v1y * v1y);
+  if (len < 2.0)
+    return 0;
+
+  // second spacing vector goes to nearest roughly perpendicular neighbor
+  nb = -1;
+  for (i = 0; i < n; i++)
+    if (i != s)
+    {
+      ex = x[i] - x[s];
+      ey = y[i] - y[s];
+      d2 = ex * ex + ey * ey;
+      c = fabs(ex * v1x + ey * v1y) / (len * sqrt(d2));
+      if ((c < 0.5) && ((nb < 0) || (d2 < best)))
+      {
+        nb = i;
+        best = d2;
+      }
+    }
+  if (nb < 0)
+    return 0;
+  v2x = x[nb] - x[s];
+  v2y = y[nb] - y[s];
+
+  // make first vector mostly horizontal (rows) and second vertical
+  if (fabs(v1x) < fabs(v2x))
+  {
+    ex = v1x;
+    ey = v1y;
+    v1x = v2x;
+    v1y = v2y;
+    v2x = ex;
+    v2y = ey;
+  }
+
+  // breadth-first growth from seed
+  gi[s] = 0;
+  gj[s] = 0;
+  ax[s] = v1x;
+  ay[s] = v1y;
+  bx[s] = v2x;
+  by[s] = v2y;
+  queue[tail++] = s;
+  cnt = 1;
+  while (head < tail)
+  {
+    s = queue[head++];
+    for (k = 0; k < 4; k++)
+    {
+      // predict position of neighbor using local spacing
+      px = x[s] + di[k] * ax[s] + dj[k] * bx[s];
+      py = y[s] + di[k] * ay[s] + dj[k] * by[s];
+      len = ((di[k] != 0) ? sqrt(ax[s] * ax[s] + ay[s] * ay[s]) : sqrt(bx[s] * bx[s] + by[s] * by[s]));
+      if ((j = nearest(x, y, n, px, py, 0.3 * len)) < 0)
+        continue;
+      if (gi[j] > -1000)
+        continue;
+
+      // assign coordinates and refine spacing in that direction
+      gi[j] = gi[s] + di[k];
+      gj[j] = gj[s] + dj[k];
+      ax[j] = ax[s];
+      ay[j] = ay[s];
+      bx[j] = bx[s];
+      by[j] = by[s];
+      if (di[k] != 0)
+      {
+        ax[j] = di[k] * (x[j] - x[s]);
+        ay[j] = di[k] * (y[j] - y[s]);
+      }
+      else
+      {
+        bx[j] = dj[k] * (x[j] - x[s]);
+        by[j] = dj[k] * (y[j] - y[s]);
+      }
+      queue[tail++] = j;
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+
+//= Find index of dot closest to some position within a given radius.
+// returns -1 if none close enough
+
+int jhcQtLens::nearest (const float *x, const float *y, int n, double px, double py, double rad) const
+{
+  double d2, best = rad * rad;
+  int i, win = -1;
+
+  for (i = 0; i < n; i++)
+  {
+    d2 = (x[i] - px) * (x[i] - px) + (y[i] - py) * (y[i] - py);
+    if (d2 < best)
+    {
+      win = i;
+      best = d2;
+    }
+  }
+  return win;
+}
+
+
+//= Copy all rows (or columns) with at least 4 linked dots into line list.
+// returns number of lines saved
+
+int jhcQtLens::save_lines (const float *x, const float *y, int n, int row)
+{
+  int i, v, lo = 1000, hi = -1000, k, cnt = 0;
+
+  // find range of row (or column) indices
+  for (i = 0; i < n; i++)
+    if (gi[i] > -1000)
+    {
+      v = ((row > 0) ? gj[i] : gi[i]);
+      lo = __min(lo, v);
+      hi = __max(hi, v);
+    }
+
+  // gather each line separately
+  for (v = lo; v <= hi; v++)
+  {
+    if ((nl >= lmax) || ((npt + n) > pmax))
+      break;
+    k = 0;
+    for (i = 0; i < n; i++)
+      if ((gi[i] > -1000) && (((row > 0) ? gj[i] : gi[i]) == v))
+      {
+        lx[npt + k] = x[i];
+        ly[npt + k] = y[i];
+        k++;
+      }
+    if (k < 4)
+      continue;
+    ls[nl] = npt;
+    lc[nl] = k;
+    npt += k;
+    nl++;
+    cnt++;
+  }
+  return cnt;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                          Distortion Fitting                           //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get distance of each corrected point from best line through its group.
+// parameters are r2f, r4f, dx, dy (distances normalized by line length)
+// returns number of residuals (same as number of points)
+
+int jhcQtLens::residuals (double *r, const double *q) const
+{
+  double ux[dmax], uy[dmax], mx, my, sxx, syy, sxy, th, nx, ny, d, sp, sc;
+  int i, j, k, n, bad;
+
+  for (i = 0; i < nl; i++)
+  {
+    // undistort all points
+    n = lc[i];
+    k = ls[i];
+    bad = 0;
+    mx = 0.0;
+    my = 0.0;
+    for (j = 0; j < n; j++)
+    {
+      if (straighten(ux[j], uy[j], lx[k + j], ly[k + j], q) <= 0)
+        bad = 1;
+      mx += ux[j];
+      my += uy[j];
+    }
+    if (bad > 0)
+    {
+      for (j = 0; j < n; j++)
+        r[k + j] = 100.0;              // beyond fold in lens model
+      continue;
+    }
+
+    // find principal axis of points
+    mx /= n;
+    my /= n;
+    sxx = 0.0;
+    syy = 0.0;
+    sxy = 0.0;
+    for (j = 0; j < n; j++)
+    {
+      sxx += (ux[j] - mx) * (ux[j] - mx);
+      syy += (uy[j] - my) * (uy[j] - my);
+      sxy += (ux[j] - mx) * (uy[j] - my);
+    }
+    th = 0.5 * atan2(2.0 * sxy, sxx - syy);
+    nx = -sin(th);
+    ny = cos(th);
+
+    // perpendicular offsets scaled to 100 pixel rms spread along line
+    sp = 0.0;
+    for (j = 0; j < n; j++)
+    {
+      d = (ux[j] - mx) * ny - (uy[j] - my) * nx;
+      sp += d * d;
+    }
+    sc = 100.0 / sqrt(__max(1.0, sp / n));
+    for (j = 0; j < n; j++)
+      r[k + j] = sc * ((ux[j] - mx) * nx + (uy[j] - my) * ny);
+  }
+  return npt;
+}
+
+
+//= Remove lens distortion from a raw pixel position given parameters.
+// inverts radial warp used by ocv_warp (at unit magnification)
+// returns 1 if okay, 0 if beyond fold of lens model
+
+int jhcQtLens::straighten (double& ux, double& uy, double px, double py, const double *q) const
+{
+  double a = q[0] * 1e-6, b = q[1] * 1e-12, ex, ey, re, rd, r2, g, dg;
+  int i;
+
+  // offset from lens center
+  ex = px - (0.5 * (iw - 1) + q[2]);
+  ey = py - (0.5 * (ih - 1) + q[3]);
+  re = sqrt(ex * ex + ey * ey);
+  ux = ex;
+  uy = ey;
+  if (re < 1e-6)
+    return 1;
+
+  // solve rd * (1 + a * rd^2 + b * rd^4) = re with Newton's method
+  rd = re;
+  for (i = 0; i < 10; i++)
+  {
+    r2 = rd * rd;
+    g = rd * (1.0 + a * r2 + b * r2 * r2) - re;
+    dg = 1.0 + 3.0 * a * r2 + 5.0 * b * r2 * r2;
+    if (dg <= 0.05)
+      return 0;
+    rd -= g / dg;
+    if (rd <= 0.0)
+      return 0;
+  }
+  ux = ex * rd / re;
+  uy = ey * rd / re;
+  return 1;
+}
+
+
+//= Sum of squared residuals for some parameters.
+
+double jhcQtLens::sq_err (const double *q) const
+{
+  double *r = new double [__max(1, npt)], sum = 0.0;
+  int i, n;
+
+  n = residuals(r, q);
+  for (i = 0; i < n; i++)
+    sum += r[i] * r[i];
+  delete [] r;
+  return sum;
+}
+
+
+//= Solve 4x4 linear system given as augmented matrix (destroyed).
+// returns 1 if okay, 0 if singular
+
+int jhcQtLens::solve4 (double *x, double m[4][5]) const
+{
+  double f, t;
+  int i, j, k, piv;
+
+  // forward elimination with partial pivoting
+  for (k = 0; k < 4; k++)
+  {
+    piv = k;
+    for (i = k + 1; i < 4; i++)
+      if (fabs(m[i][k]) > fabs(m[piv][k]))
+        piv = i;
+    if (fabs(m[piv][k]) < 1e-12)
+      return 0;
+    if (piv != k)
+      for (j = k; j < 5; j++)
+      {
+        t = m[k][j];
+        m[k][j] = m[piv][j];
+        m[piv][j] = t;
+      }
+    for (i = k + 1; i < 4; i++)
+    {
+      f = m[i][k] / m[k][k];
+      for (j = k; j < 5; j++)
+        m[i][j] -= f * m[k][j];
+    }
+  }
+
+  // back substitution
+  for (k = 3; k >= 0; k--)
+  {
+    x[k] = m[k][4];
+    for (j = k + 1; j < 4; j++)
+      x[k] -= m[k][j] * x[j];
+    x[k] /= m[k][k];
+  }
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Magnification                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Tell if all border pixels of corrected image come from inside raw image.
+
+int jhcQtLens::covered (double m) const
+{
+  int x, y, xlim = iw - 1, ylim = ih - 1;
+
+  // just middles of edges
+  if (full <= 0)
+    return(((inside(0.0, 0.5 * ylim, m) > 0) && (inside(xlim, 0.5 * ylim, m) > 0) &&
+            (inside(0.5 * xlim, 0.0, m) > 0) && (inside(0.5 * xlim, ylim, m) > 0)) ? 1 : 0);
+
+  // whole border including corners
+  for (x = 0; x <= xlim; x += 4)
+    if ((inside(x, 0.0, m) <= 0) || (inside(x, ylim, m) <= 0))
+      return 0;
+  for (y = 0; y <= ylim; y += 4)
+    if ((inside(0.0, y, m) <= 0) || (inside(xlim, y, m) <= 0))
+      return 0;
+  return(((inside(xlim, 0.0, m) > 0) && (inside(xlim, ylim, m) > 0)) ? 1 : 0);
+}
+
+
+//= Tell if corrected pixel samples a valid raw pixel (same math as ocv_warp).
+
+int jhcQtLens::inside (double x, double y, double m) const
+{
+  double x0 = 0.5 * (iw - 1), y0 = 0.5 * (ih - 1), ox, oy, r2, warp, wx, wy;
+
+  ox = asp * (x - x0) / m;
+  oy = (y - y0) / m;
+  r2 = ox * ox + oy * oy;
+  if ((1.0 + 3e-6 * r2f * r2 + 5e-12 * r4f * r2 * r2) <= 0.0)
+    return 0;                          // beyond fold
+  warp = 1.0 + 1e-6 * r2f * r2 + 1e-12 * r4f * r2 * r2;
+  wx = x0 + dx + warp * ox;
+  wy = y0 + dy + warp * oy;
+  return(((wx >= 0.0) && (wx < iw - 1) && (wy >= 0.0) && (wy < ih - 1)) ? 1 : 0);
+}
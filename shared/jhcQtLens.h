@@ -0,0 +1,101 @@
+// jhcQtLens.h : lens distortion fitting for Qtruck camera
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Lens distortion fitting for Qtruck camera.
+// takes centers of dots in a roughly square grid seen in raw (uncorrected)
+// images, links them into rows and columns, then adjusts radial distortion
+// and lens center until all these lines become straight (plumb-line method)
+// also picks magnification so corrected image has no black border
+// results are in the form expected by ocv_warp (pixel aspect is not
+// observable this way so it is just passed through)
+
+class jhcQtLens
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int pmax = 4000;        // max total line points
+  static const int lmax = 400;         // max total lines
+  static const int dmax = 100;         // max dots per view
+
+  // points along all lines (raw pixels)
+  float lx[pmax], ly[pmax];
+  int ls[lmax], lc[lmax];
+  int npt, nl, nv;
+
+  // grid coordinates of dots in current view
+  int gi[dmax], gj[dmax];
+
+  // image size
+  int iw, ih;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // radial distortion (x 10^6 and x 10^12), magnification, and aspect
+  double r2f, r4f, mag, asp;
+
+  // lens center offset from middle of raw image (pixels)
+  double dx, dy;
+
+  // whether corrected image must be filled right into corners
+  int full;
+
+  // remaining crookedness (pixels per 100 pixels of line)
+  double err;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  jhcQtLens ();
+  void SetSize (int w, int h) {iw = w; ih = h;}
+  void Clear () {npt = 0; nl = 0; nv = 0;}
+  int Views () const {return nv;}
+  int Lines () const {return nl;}
+
+  // main functions
+  int AddView (const float *x, const float *y, int n);
+  int Fit ();
+  double Zoom ();
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // grid linking
+  int link_grid (const float *x, const float *y, int n);
+  int nearest (const float *x, const float *y, int n, double px, double py, double rad) const;
+  int save_lines (const float *x, const float *y, int n, int row);
+
+  // distortion fitting
+  int residuals (double *r, const double *q) const;
+  int straighten (double& ux, double& uy, double px, double py, const double *q) const;
+  double sq_err (const double *q) const;
+  int solve4 (double *x, double m[4][5]) const;
+
+  // magnification
+  int covered (double m) const;
+  int inside (double x, double y, double m) const;
+
+};
@@ -0,0 +1,221 @@
+// jhcQtMotion.cpp : cheap change detector for Qtruck camera
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>                 // SSE2 (always on x64)
+
+#include "jhcQtMotion.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcQtMotion::~jhcQtMotion ()
+{
+  dealloc();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcQtMotion::jhcQtMotion ()
+{
+  // no buffers yet
+  cur = NULL;
+  bg = NULL;
+
+  // sensitivity
+  th = 20;                   // gray level difference
+  cfrac = 0.05;              // fraction of cell pixels changed
+
+  // typical Esp32 camera
+  SetSize(640, 480);
+}
+
+
+//= Get rid of all buffers.
+
+void jhcQtMotion::dealloc ()
+{
+  delete [] bg;
+  delete [] cur;
+  cur = NULL;
+  bg = NULL;
+}
+
+
+//= Set image dimensions (3 bytes per pixel, no line padding).
+// decimated width is padded to a multiple of 16 for SIMD
+
+void jhcQtMotion::SetSize (int wid, int ht)
+{
+  dealloc();
+  iw = wid;
+  ih = ht;
+  w = ((iw / 4 + 15) / 16) * 16;
+  h = ih / 4;
+  cur = new unsigned char [w * h];
+  bg = new unsigned char [w * h];
+  memset(cur, 0, w * h);
+  Reset();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Compare new BGR frame to background then blend it in.
+// returns number of active grid cells (0 if nothing changed)
+
+int jhcQtMotion::Update (const unsigned char *img)
+{
+  decimate(img);
+  if (fill <= 0)
+  {
+    // first frame just becomes background
+    memcpy(bg, cur, w * h);
+    memset(cnt, 0, sizeof(cnt));
+    memset(sad, 0, sizeof(sad));
+    fill = 1;
+    hot = 0;
+    frac = 0.0;
+    return 0;
+  }
+  compare();
+  summarize();
+  return hot;
+}
+
+
+//= Tell whether a particular grid cell has significant change.
+
+int jhcQtMotion::Active (int i, int j) const
+{
+  int cw = (iw / 4) / gx, ch = h / gy;
+
+  if ((i < 0) || (i >= gx) || (j < 0) || (j >= gy))
+    return 0;
+  return((cnt[j][i] > cfrac * cw * ch) ? 1 : 0);
+}
+
+
+//= Make 4x smaller grayscale image by averaging center of each 4x4 block.
+// uses (B + 2G + R) / 4 at 4 pixels per block
+
+void jhcQtMotion::decimate (const unsigned char *img)
+{
+  const unsigned char *s, *s2;
+  unsigned char *d = cur;
+  int x, y, v, dw = iw / 4, ln = 3 * iw, pad = w - dw;
+
+  for (y = 0; y < h; y++, d += pad)
+  {
+    s = img + (4 * y + 1) * ln + 3;
+    s2 = s + ln;
+    for (x = 0; x < dw; x++, d++, s += 12, s2 += 12)
+    {
+      v = (s[0] + (s[1] << 1) + s[2] + s[3] + (s[4] << 1) + s[5]) +
+          (s2[0] + (s2[1] << 1) + s2[2] + s2[3] + (s2[4] << 1) + s2[5]);
+      *d = (unsigned char)(v >> 4);
+    }
+  }
+}
+
+
+//= Count changed pixels and total absolute difference in each grid cell.
+// also blends current image into background at 1/4 rate
+
+void jhcQtMotion::compare ()
+{
+  __m128i a, b, ad, chg, vth = _mm_set1_epi8((char) __max(0, __min(th, 255)));
+  __m128i zero = _mm_setzero_si128();
+  unsigned char *c = cur, *g = bg;
+  int x, y, i, j, bits, n, cw = (iw / 4) / gx, ch = h / gy, dw = iw / 4;
+
+  memset(cnt, 0, sizeof(cnt));
+  memset(sad, 0, sizeof(sad));
+  for (y = 0; y < h; y++)
+  {
+    j = __min(y / ch, gy - 1);
+    for (x = 0; x < w; x += 16, c += 16, g += 16)
+    {
+      // absolute difference and mask of pixels beyond threshold
+      a = _mm_loadu_si128((const __m128i *) c);
+      b = _mm_loadu_si128((const __m128i *) g);
+      ad = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+      chg = _mm_cmpeq_epi8(_mm_subs_epu8(ad, vth), zero);
+      bits = ~_mm_movemask_epi8(chg) & 0xFFFF;
+
+      // ignore padding at end of line
+      if (x + 16 > dw)
+        bits &= (1 << __max(0, dw - x)) - 1;
+
+      // add to cell totals (16 pixels may straddle two cells)
+      if (bits != 0)
+        for (n = 0; n < 16; n++)
+          if ((bits & (1 << n)) != 0)
+          {
+            i = __min((x + n) / cw, gx - 1);
+            cnt[j][i] += 1;
+          }
+      ad = _mm_sad_epu8(ad, zero);
+      i = __min(x / cw, gx - 1);
+      sad[j][i] += _mm_cvtsi128_si32(ad) + _mm_cvtsi128_si32(_mm_srli_si128(ad, 8));
+
+      // background moves 1/4 of way toward current image
+      _mm_storeu_si128((__m128i *) g, _mm_avg_epu8(b, _mm_avg_epu8(b, a)));
+    }
+  }
+}
+
+
+//= Find active cells, overall fraction changed, and center of change.
+// center is in full size image coordinates (buffer row order)
+
+void jhcQtMotion::summarize ()
+{
+  double sx = 0.0, sy = 0.0;
+  int i, j, tot = 0, cw = (iw / 4) / gx, ch = h / gy;
+
+  hot = 0;
+  for (j = 0; j < gy; j++)
+    for (i = 0; i < gx; i++)
+    {
+      tot += cnt[j][i];
+      sx += cnt[j][i] * (i + 0.5) * cw;
+      sy += cnt[j][i] * (j + 0.5) * ch;
+      hot += Active(i, j);
+    }
+  frac = tot / (double)((iw / 4) * h);
+  mx = 0.5 * iw;
+  my = 0.5 * ih;
+  if (tot > 0)
+  {
+    mx = 4.0 * sx / tot;
+    my = 4.0 * sy / tot;
+  }
+}
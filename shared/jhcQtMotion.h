@@ -0,0 +1,82 @@
+// jhcQtMotion.h : cheap change detector for Qtruck camera
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Cheap change detector for Qtruck camera.
+// keeps a running background of a 4x decimated grayscale image and marks
+// pixels that differ from it by more than a threshold (SSE2, 16 at a time)
+// summarizes changes over a coarse grid so callers can tell roughly where
+// only meaningful when camera is still (call Reset() after it moves)
+// well under 0.1 ms for a 640x480 BGR frame
+
+class jhcQtMotion
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // decimated current image and running background
+  unsigned char *cur, *bg;
+  int iw, ih, w, h, fill;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  static const int gx = 5;             // grid cells across
+  static const int gy = 4;             // grid cells down
+
+  // gray level change to count and fraction of cell that is active
+  int th;
+  double cfrac;
+
+  // changed pixels and summed difference in each cell (buffer row order)
+  int cnt[gy][gx], sad[gy][gx];
+
+  // active cells, overall fraction changed, and center of change (full size)
+  int hot;
+  double frac, mx, my;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcQtMotion ();
+  jhcQtMotion ();
+  void SetSize (int wid, int ht);
+  void Reset () {fill = 0; hot = 0; frac = 0.0;}
+
+  // main functions
+  int Update (const unsigned char *img);
+  int Active (int i, int j) const;
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // creation and initialization
+  void dealloc ();
+
+  // main functions
+  void decimate (const unsigned char *img);
+  void compare ();
+  void summarize ();
+
+};
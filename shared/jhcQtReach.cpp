@@ -0,0 +1,354 @@
+// jhcQtReach.cpp : precomputed kinematics and reachability for Qtruck arm
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtReach.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcQtReach::~jhcQtReach ()
+{
+  dealloc();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcQtReach::jhcQtReach ()
+{
+  // no tables yet
+  hx = NULL;
+  hy = NULL;
+  hz = NULL;
+  cx = NULL;
+  cy = NULL;
+  cz = NULL;
+  vpose = NULL;
+  vdist = NULL;
+  nb = 0;
+  ns = 0;
+  vx = 0;
+  vy = 0;
+  vz = 0;
+
+  // servo ranges and workspace resolution
+  bmin = -90.0;
+  bmax =  90.0;
+  smin = -30.0;
+  smax =  40.0;
+  vsz  =  0.25;
+}
+
+
+//= Get rid of all tables.
+
+void jhcQtReach::dealloc ()
+{
+  delete [] vdist;
+  delete [] vpose;
+  delete [] cz;
+  delete [] cy;
+  delete [] cx;
+  delete [] hz;
+  delete [] hy;
+  delete [] hx;
+  hx = NULL;
+  hy = NULL;
+  hz = NULL;
+  cx = NULL;
+  cy = NULL;
+  cz = NULL;
+  vpose = NULL;
+  vdist = NULL;
+}
+
+
+//= Generate all tables based on arm geometry (see jhcQtruck::cfg_params).
+// takes a few milliseconds so call once at start
+
+void jhcQtReach::Build (double base_y, double base_sh, double sh_z, double sw_len,
+                        double f_out, double f_dn, double f_ext, double c_dot, double c_rt)
+{
+  double rmax, m = 1.0;
+  int nv;
+
+  // save geometry
+  by   = base_y;
+  bs   = base_sh;
+  sz   = sh_z;
+  sw   = sw_len;
+  fout = f_out;
+  fdn  = f_dn;
+  fext = f_ext;
+  cdot = c_dot;
+  crt  = c_rt;
+
+  // size forward tables (1 degree steps)
+  dealloc();
+  nb = (int)(bmax - bmin) + 1;
+  ns = (int)(smax - smin) + 1;
+  hx = new float [nb * ns];
+  hy = new float [nb * ns];
+  hz = new float [nb * ns];
+  cx = new float [nb * ns];
+  cy = new float [nb * ns];
+  cz = new float [nb * ns];
+  fill_fk();
+
+  // size voxel grid to enclose whole hand shell plus margin
+  rmax = bs + fout + fext + sw;
+  x0 = -rmax - m;
+  y0 = by - rmax - m;
+  z0 = (sz - fdn) - sw - m;
+  vx = (int) ceil(2.0 * (rmax + m) / vsz) + 1;
+  vy = vx;
+  vz = (int) ceil(2.0 * (sw + m) / vsz) + 1;
+  nv = vx * vy * vz;
+  vpose = new int [nv];
+  vdist = new float [nv];
+  fill_vox();
+}
+
+
+//= Evaluate hand and camera positions at every grid point.
+// same formulas as jhcQtruck::HandLoc and jhcQtruck::CamLoc
+
+void jhcQtReach::fill_fk ()
+{
+  double b, s, sb, cb, ss, cs, r;
+  int i, j, k = 0;
+
+  for (i = 0; i < nb; i++)
+  {
+    b = (bmin + i) * M_PI / 180.0;
+    sb = sin(b);
+    cb = cos(b);
+    for (j = 0; j < ns; j++, k++)
+    {
+      s = (smin + j) * M_PI / 180.0;
+      ss = sin(s);
+      cs = cos(s);
+
+      // fingertips
+      r = bs + sw * cs + fout + fext;
+      hx[k] = (float)(-r * sb);
+      hy[k] = (float)( r * cb + by);
+      hz[k] = (float)(sz + sw * ss - fdn);
+
+      // camera
+      r = bs + cdot * cs - crt * ss;
+      cx[k] = (float)(-r * sb);
+      cy[k] = (float)(r * cb + by);
+      cz[k] = (float)(sz + cdot * ss + crt * cs);
+    }
+  }
+}
+
+
+//= Find nearest grid pose and its hand distance for center of every voxel.
+
+void jhcQtReach::fill_vox ()
+{
+  double x, y, z, b, s, dx, dy, dz;
+  int i, j, k, bi, si, p, v = 0;
+
+  for (k = 0; k < vz; k++)
+  {
+    z = z0 + k * vsz;
+    for (j = 0; j < vy; j++)
+    {
+      y = y0 + j * vsz;
+      for (i = 0; i < vx; i++, v++)
+      {
+        // round continuous solution to grid
+        x = x0 + i * vsz;
+        closest(b, s, x, y, z);
+        bi = (int)(b - bmin + 0.5);
+        si = (int)(s - smin + 0.5);
+        p = bi * ns + si;
+
+        // save pose and residual error
+        dx = hx[p] - x;
+        dy = hy[p] - y;
+        dz = hz[p] - z;
+        vpose[v] = p;
+        vdist[v] = (float) sqrt(dx * dx + dy * dy + dz * dz);
+      }
+    }
+  }
+}
+
+
+//= Analytic nearest reachable pose for hand (slow, used to build table).
+// base aims at target, then lift finds closest point on circular arc
+
+void jhcQtReach::closest (double& b, double& s, double x, double y, double z) const
+{
+  double rads, rho, rc = bs + fout + fext, zc = sz - fdn;
+
+  // pan toward target (within limits)
+  b = atan2(x, y - by) * -180.0 / M_PI;
+  b = __max(bmin, __min(b, bmax));
+
+  // radial distance along arm direction
+  rads = b * M_PI / 180.0;
+  rho = (y - by) * cos(rads) - x * sin(rads);
+
+  // closest angle on circle swept by shoulder link
+  s = atan2(z - zc, rho - rc) * 180.0 / M_PI;
+  s = __max(smin, __min(s, smax));
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                          Forward Kinematics                           //
+///////////////////////////////////////////////////////////////////////////
+
+//= Interpolated fingertip position for given physical servo angles.
+
+void jhcQtReach::HandFK (double& x, double& y, double& z, double b, double s) const
+{
+  double fb, fs;
+  int i, j;
+
+  grid_pos(i, fb, j, fs, b, s);
+  interp(x, y, z, hx, hy, hz, i, fb, j, fs);
+}
+
+
+//= Interpolated camera position for given physical servo angles.
+
+void jhcQtReach::CamFK (double& x, double& y, double& z, double b, double s) const
+{
+  double fb, fs;
+  int i, j;
+
+  grid_pos(i, fb, j, fs, b, s);
+  interp(x, y, z, cx, cy, cz, i, fb, j, fs);
+}
+
+
+//= Find hand (or camera) positions for a whole list of candidate poses.
+// returns number of poses processed
+
+int jhcQtReach::BatchFK (float *x, float *y, float *z, const float *b, const float *s, int n, int cam) const
+{
+  const float *tx = ((cam > 0) ? cx : hx), *ty = ((cam > 0) ? cy : hy), *tz = ((cam > 0) ? cz : hz);
+  double fb, fs, px, py, pz;
+  int k, i, j;
+
+  if (hx == NULL)
+    return 0;
+  for (k = 0; k < n; k++)
+  {
+    grid_pos(i, fb, j, fs, b[k], s[k]);
+    interp(px, py, pz, tx, ty, tz, i, fb, j, fs);
+    x[k] = (float) px;
+    y[k] = (float) py;
+    z[k] = (float) pz;
+  }
+  return n;
+}
+
+
+//= Get base cell and fractional offsets for some servo angle pair.
+
+void jhcQtReach::grid_pos (int& i, double& fb, int& j, double& fs, double b, double s) const
+{
+  fb = __max(bmin, __min(b, bmax)) - bmin;
+  i = __min((int) fb, nb - 2);
+  fb -= i;
+  fs = __max(smin, __min(s, smax)) - smin;
+  j = __min((int) fs, ns - 2);
+  fs -= j;
+}
+
+
+//= Bilinear interpolation of some set of coordinate tables.
+
+void jhcQtReach::interp (double& x, double& y, double& z, const float *tx, const float *ty, const float *tz,
+                         int i, double fb, int j, double fs) const
+{
+  double w00 = (1.0 - fb) * (1.0 - fs), w01 = (1.0 - fb) * fs, w10 = fb * (1.0 - fs), w11 = fb * fs;
+  int k = i * ns + j;
+
+  x = w00 * tx[k] + w01 * tx[k + 1] + w10 * tx[k + ns] + w11 * tx[k + ns + 1];
+  y = w00 * ty[k] + w01 * ty[k + 1] + w10 * ty[k + ns] + w11 * ty[k + ns + 1];
+  z = w00 * tz[k] + w01 * tz[k + 1] + w10 * tz[k + ns] + w11 * tz[k + ns + 1];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                          Inverse Kinematics                           //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get servo angles (to nearest degree) that put fingertips closest to target.
+// returns distance from target to achieved hand position (inches)
+// NOTE: targets outside of table volume use closest boundary voxel
+
+double jhcQtReach::Nearest (double& b, double& s, double x, double y, double z) const
+{
+  double dx, dy, dz;
+  int i, j, k, p;
+
+  // fall back to slow method if no tables
+  if (vpose == NULL)
+  {
+    closest(b, s, x, y, z);
+    return 0.0;
+  }
+
+  // find voxel containing target
+  i = (int)((x - x0) / vsz + 0.5);
+  j = (int)((y - y0) / vsz + 0.5);
+  k = (int)((z - z0) / vsz + 0.5);
+  i = __max(0, __min(i, vx - 1));
+  j = __max(0, __min(j, vy - 1));
+  k = __max(0, __min(k, vz - 1));
+  p = vpose[(k * vy + j) * vx + i];
+
+  // convert index to angles and measure actual error
+  b = bmin + (p / ns);
+  s = smin + (p % ns);
+  dx = hx[p] - x;
+  dy = hy[p] - y;
+  dz = hz[p] - z;
+  return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+
+//= Tell whether fingertips can get within some distance of target.
+
+int jhcQtReach::Reachable (double x, double y, double z, double tol) const
+{
+  double b, s;
+
+  return((Nearest(b, s, x, y, z) <= tol) ? 1 : 0);
+}
@@ -0,0 +1,90 @@
+// jhcQtReach.h : precomputed kinematics and reachability for Qtruck arm
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Precomputed kinematics and reachability for Qtruck arm.
+// forward tables cover full servo grid at 1 degree spacing (interpolated)
+// reachability index holds nearest achievable pose for each workspace voxel
+// all coordinates wrt center of robot body in inches (y forward, x right)
+
+class jhcQtReach
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // forward kinematics of hand and camera over servo grid
+  float *hx, *hy, *hz, *cx, *cy, *cz;
+  int nb, ns;
+
+  // nearest pose index and distance for each voxel
+  int *vpose;
+  float *vdist;
+  int vx, vy, vz;
+  double x0, y0, z0;
+
+  // arm geometry (copied)
+  double by, bs, sz, sw, fout, fdn, fext, cdot, crt;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // servo grid limits (degs)
+  double bmin, bmax, smin, smax;
+
+  // voxel size (in)
+  double vsz;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcQtReach ();
+  jhcQtReach ();
+  void Build (double base_y, double base_sh, double sh_z, double sw_len,
+              double f_out, double f_dn, double f_ext, double c_dot, double c_rt);
+  int Ready () const {return((hx != NULL) ? 1 : 0);}
+
+  // forward kinematics
+  void HandFK (double& x, double& y, double& z, double b, double s) const;
+  void CamFK (double& x, double& y, double& z, double b, double s) const;
+  int BatchFK (float *x, float *y, float *z, const float *b, const float *s, int n, int cam =0) const;
+
+  // inverse kinematics
+  double Nearest (double& b, double& s, double x, double y, double z) const;
+  int Reachable (double x, double y, double z, double tol =0.25) const;
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // creation and initialization
+  void dealloc ();
+  void fill_fk ();
+  void fill_vox ();
+  void closest (double& b, double& s, double x, double y, double z) const;
+
+  // table lookup
+  void grid_pos (int& i, double& fb, int& j, double& fs, double b, double s) const;
+  void interp (double& x, double& y, double& z, const float *tx, const float *ty, const float *tz,
+               int i, double fb, int j, double fs) const;
+
+};
@@ -0,0 +1,362 @@
+// jhcQtTraj.cpp : smooth joint trajectories for Qtruck arm
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtTraj.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcQtTraj::jhcQtTraj ()
+{
+  // no path or limits
+  nk = 0;
+  seg = 0;
+  now = 0.0;
+  nc = 0;
+
+  // servo speeds and communication
+  vmin  = 90.0;              // prevents gear binding
+  vmax  = 300.0;             // hardware slew limit
+  tstop = 0.2;               // ramp down at very end
+  pkt   = 0.045;             // typical Bluetooth exchange
+  share = 1.0;               // both arm servos every packet
+}
+
+
+//= Add a region where lift must be high enough to clear the body.
+// applies whenever absolute base angle is at least babs
+// returns number of regions, 0 if no space left
+
+int jhcQtTraj::AddLimit (double babs, double smin)
+{
+  if (nc >= lmax)
+    return 0;
+  cb[nc] = babs;
+  cs[nc] = smin;
+  return ++nc;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Planning                                //
+///////////////////////////////////////////////////////////////////////////
+
+//= Plan a path from current pose and velocity through a series of joint targets.
+// dps is the desired average speed of the worst joint on each segment
+// inserts extra knots so path never enters a keep-out region
+// sharing slows nominal speed but never below vmin (only vmax is hard)
+// returns number of knots (including start), 0 if nothing to do
+
+int jhcQtTraj::Plan (double b0, double s0, double db0, double ds0,
+                     const double *b, const double *s, int n, double dps)
+{
+  double pb, ps, bt, st, sm, d, dur, v = __max(vmin, dps * share);
+  int i, k;
+
+  // starting state
+  nk = 0;
+  seg = 0;
+  now = 0.0;
+  kt[0] = 0.0;
+  add_knot(b0, s0);
+  vb[0] = db0;
+  vs[0] = ds0;
+
+  // add targets (and possibly detours around keep-out regions)
+  for (i = 0; i < n; i++)
+  {
+    pb = kb[nk - 1];
+    ps = ks[nk - 1];
+    bt = b[i];
+    st = __max(s[i], lift_min(bt));
+    if (safe_path(pb, ps, bt, st) <= 0)
+    {
+      // raise, swing, then lower (worst case is at an end of base sweep)
+      sm = __max(lift_min(pb), lift_min(bt));
+      add_knot(pb, __max(ps, sm));
+      add_knot(bt, __max(st, sm));
+    }
+    add_knot(bt, st);
+  }
+  if (nk <= 1)
+  {
+    nk = 0;
+    return 0;
+  }
+
+  // assign segment durations (whole packets, slowed if sharing but not below vmin)
+  for (k = 1; k < nk; k++)
+  {
+    d = __max(fabs(kb[k] - kb[k - 1]), fabs(ks[k] - ks[k - 1]));
+    dur = __max(d / v, 1.875 * d / (vmax * share));
+    dur = pkt * ceil(dur / pkt);
+    if ((d < vmin * dur) && (1.875 * d <= vmax * share * (dur - pkt)))
+      dur -= pkt;
+    kt[k] = kt[k - 1] + __max(pkt, dur);
+  }
+  knot_vels();
+  final_stop();
+  return nk;
+}
+
+
+//= Append a knot unless it is the same as the previous one.
+// returns number of knots, 0 if no space left
+
+int jhcQtTraj::add_knot (double b, double s)
+{
+  if (nk >= kmax)
+    return 0;
+  if ((nk > 0) && (fabs(b - kb[nk - 1]) < 0.01) && (fabs(s - ks[nk - 1]) < 0.01))
+    return nk;
+  kb[nk] = b;
+  ks[nk] = s;
+  vb[nk] = 0.0;
+  vs[nk] = 0.0;
+  return ++nk;
+}
+
+
+//= Check whether straight joint-space motion avoids all keep-out regions.
+// returns 1 if okay, 0 if some intermediate pose is blocked
+
+int jhcQtTraj::safe_path (double b0, double s0, double b1, double s1) const
+{
+  double f;
+  int i, n = 10;
+
+  for (i = 0; i <= n; i++)
+  {
+    f = i / (double) n;
+    if (blocked(b0 + f * (b1 - b0), s0 + f * (s1 - s0)) > 0)
+      return 0;
+  }
+  return 1;
+}
+
+
+//= Tell if some pose is inside a keep-out region.
+
+int jhcQtTraj::blocked (double b, double s) const
+{
+  return((s < lift_min(b)) ? 1 : 0);
+}
+
+
+//= Lowest allowed lift angle at some base angle.
+
+double jhcQtTraj::lift_min (double b) const
+{
+  double lo = -1000.0;
+  int i;
+
+  for (i = 0; i < nc; i++)
+    if (fabs(b) >= cb[i])
+      lo = __max(lo, cs[i]);
+  return lo;
+}
+
+
+//= Pick velocities at interior knots to keep motion smooth but monotonic.
+// start velocity is given (jumps to cruise if at rest), final velocity is zero
+// segments whose ends match their average speed are constant velocity
+
+void jhcQtTraj::knot_vels ()
+{
+  double t0, t1, m0, m1;
+  int k;
+
+  // avoid slow creep at start (servos bind)
+  t1 = kt[1] - kt[0];
+  if (vb[0] == 0.0)
+    vb[0] = (kb[1] - kb[0]) / t1;
+  if (vs[0] == 0.0)
+    vs[0] = (ks[1] - ks[0]) / t1;
+
+  for (k = 1; k < nk - 1; k++)
+  {
+    t0 = kt[k] - kt[k - 1];
+    t1 = kt[k + 1] - kt[k];
+
+    // base keeps moving only if continuing in same direction
+    m0 = (kb[k] - kb[k - 1]) / t0;
+    m1 = (kb[k + 1] - kb[k]) / t1;
+    vb[k] = 0.0;
+    if (m0 * m1 > 0.0)
+      vb[k] = ((m0 > 0.0) ? __min(m0, m1) : __max(m0, m1));
+
+    // same for lift
+    m0 = (ks[k] - ks[k - 1]) / t0;
+    m1 = (ks[k + 1] - ks[k]) / t1;
+    vs[k] = 0.0;
+    if (m0 * m1 > 0.0)
+      vs[k] = ((m0 > 0.0) ? __min(m0, m1) : __max(m0, m1));
+  }
+  vb[nk - 1] = 0.0;
+  vs[nk - 1] = 0.0;
+}
+
+
+//= Split last segment into cruise at average speed then a short stop.
+// stop covers half the distance cruise would in that time (smoothstep speed)
+// overall path takes half of stopping time longer than before
+
+void jhcQtTraj::final_stop ()
+{
+  double T, tc, tf, f, mb, ms;
+  int k = nk - 1;
+
+  // needs room for one more knot and enough time to cruise
+  tf = 2.0 * pkt * ceil(0.5 * tstop / pkt);
+  T = kt[k] - kt[k - 1];
+  tc = T - 0.5 * tf;
+  if ((nk >= kmax) || (tc < pkt))
+    return;
+
+  // move goal to end then add split point along the way
+  mb = (kb[k] - kb[k - 1]) / T;
+  ms = (ks[k] - ks[k - 1]) / T;
+  f = tc / T;
+  kb[k + 1] = kb[k];
+  ks[k + 1] = ks[k];
+  vb[k + 1] = 0.0;
+  vs[k + 1] = 0.0;
+  kt[k + 1] = kt[k - 1] + tc + tf;
+  kb[k] = kb[k - 1] + f * (kb[k + 1] - kb[k - 1]);
+  ks[k] = ks[k - 1] + f * (ks[k + 1] - ks[k - 1]);
+  vb[k] = mb;
+  vs[k] = ms;
+  kt[k] = kt[k - 1] + tc;
+  nk++;
+}
+
+
+//= Time remaining until trajectory finishes (secs).
+
+double jhcQtTraj::Left () const
+{
+  if (nk <= 1)
+    return 0.0;
+  return __max(0.0, kt[nk - 1] - now);
+}
+
+
+//= Final pose of trajectory (unchanged if none).
+
+void jhcQtTraj::Goal (double& b, double& s) const
+{
+  if (nk <= 0)
+    return;
+  b = kb[nk - 1];
+  s = ks[nk - 1];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Execution                               //
+///////////////////////////////////////////////////////////////////////////
+
+//= Advance along trajectory by some time and get new joint angles.
+// returns 1 if still moving, 0 if at end (or no trajectory)
+
+int jhcQtTraj::Step (double& b, double& s, double dt)
+{
+  double db, ds;
+
+  if (nk <= 1)
+    return 0;
+  now += dt;
+  eval(b, s, db, ds, now);
+  return Active();
+}
+
+
+//= Current joint velocities (dps) along trajectory.
+
+void jhcQtTraj::Vel (double& db, double& ds)
+{
+  double b, s;
+
+  db = 0.0;
+  ds = 0.0;
+  if (Active() > 0)
+    eval(b, s, db, ds, now);
+}
+
+
+//= Evaluate quintic Hermite segment (zero knot accelerations) at some time.
+
+void jhcQtTraj::eval (double& b, double& s, double& db, double& ds, double t)
+{
+  double T, u, u2, u3, u4, u5, h0, h1, h4, h5, d0, d1, d4, d5;
+  int k = seg;
+
+  // past end of path
+  if (t >= kt[nk - 1])
+  {
+    b = kb[nk - 1];
+    s = ks[nk - 1];
+    db = 0.0;
+    ds = 0.0;
+    return;
+  }
+
+  // find active segment (usually same as last time)
+  if (t < kt[k])
+    k = 0;
+  while ((k < nk - 2) && (t >= kt[k + 1]))
+    k++;
+  seg = k;
+
+  // normalized time and powers
+  T = kt[k + 1] - kt[k];
+  u = (t - kt[k]) / T;
+  u2 = u * u;
+  u3 = u2 * u;
+  u4 = u3 * u;
+  u5 = u4 * u;
+
+  // position basis functions
+  h0 = 1.0 - 10.0 * u3 + 15.0 * u4 - 6.0 * u5;
+  h1 = u - 6.0 * u3 + 8.0 * u4 - 3.0 * u5;
+  h4 = -4.0 * u3 + 7.0 * u4 - 3.0 * u5;
+  h5 = 10.0 * u3 - 15.0 * u4 + 6.0 * u5;
+
+  // velocity basis functions (wrt normalized time)
+  d0 = -30.0 * u2 + 60.0 * u3 - 30.0 * u4;
+  d1 = 1.0 - 18.0 * u2 + 32.0 * u3 - 15.0 * u4;
+  d4 = -12.0 * u2 + 28.0 * u3 - 15.0 * u4;
+  d5 = 30.0 * u2 - 60.0 * u3 + 30.0 * u4;
+
+  // combine knot values
+  b  = h0 * kb[k] + h1 * T * vb[k] + h4 * T * vb[k + 1] + h5 * kb[k + 1];
+  s  = h0 * ks[k] + h1 * T * vs[k] + h4 * T * vs[k + 1] + h5 * ks[k + 1];
+  db = (d0 * kb[k] + d5 * kb[k + 1]) / T + d1 * vb[k] + d4 * vb[k + 1];
+  ds = (d0 * ks[k] + d5 * ks[k + 1]) / T + d1 * vs[k] + d4 * vs[k + 1];
+}
@@ -0,0 +1,94 @@
+// jhcQtTraj.h : smooth joint trajectories for Qtruck arm
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Smooth joint trajectories for Qtruck arm.
+// plans base and lift motion through several joint-space knots using
+// quintic segments with continuous velocity at each knot
+// joints cruise near average segment speed (never below vmin for worst
+// joint) and only slow down for reversals and a short final stop
+// segment durations are rounded to whole packets and stretched when
+// servo updates must be shared with the gripper (2 servos per packet)
+
+class jhcQtTraj
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int kmax = 12;          // max knots (incl. start)
+  static const int lmax = 4;           // max keep-out regions
+
+  // knot positions, velocities, and times
+  double kb[kmax], ks[kmax], vb[kmax], vs[kmax], kt[kmax];
+  int nk, seg;
+
+  // time along trajectory
+  double now;
+
+  // keep-out regions: |base| >= cb requires lift >= cs
+  double cb[lmax], cs[lmax];
+  int nc;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // servo speed limits (dps) and final stopping time (sec)
+  double vmin, vmax, tstop;
+
+  // packet period (sec) and fraction of packets each servo gets
+  double pkt, share;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  jhcQtTraj ();
+  void Clear () {nk = 0;}
+  int AddLimit (double babs, double smin);
+
+  // planning
+  int Plan (double b0, double s0, double db0, double ds0,
+            const double *b, const double *s, int n, double dps);
+  int Active () const {return((nk > 1) && (now < kt[nk - 1]) ? 1 : 0);}
+  double Left () const;
+  void Goal (double& b, double& s) const;
+
+  // execution
+  int Step (double& b, double& s, double dt);
+  void Vel (double& db, double& ds);
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // planning
+  int add_knot (double b, double s);
+  int safe_path (double b0, double s0, double b1, double s1) const;
+  int blocked (double b, double s) const;
+  double lift_min (double b) const;
+  void knot_vels ();
+  void final_stop ();
+
+  // execution
+  void eval (double& b, double& s, double& db, double& ds, double t);
+
+};
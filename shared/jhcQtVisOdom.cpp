@@ -0,0 +1,518 @@
+// jhcQtVisOdom.cpp : sparse visual odometry from Qtruck camera
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdlib.h>
+
+#include "jhcQtVisOdom.h"
+
+
+//= Circle of 16 pixels at radius 3 used for corner test (dx, dy).
+
+static const int ring[16][2] = {{ 0, -3}, { 1, -3}, { 2, -2}, { 3, -1}, 
+                                { 3,  0}, { 3,  1}, { 2,  2}, { 1,  3}, 
+                                { 0,  3}, {-1,  3}, {-2,  2}, {-3,  1}, 
+                                {-3,  0}, {-3, -1}, {-2, -2}, {-1, -3}};
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcQtVisOdom::~jhcQtVisOdom ()
+{
+  dealloc();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcQtVisOdom::jhcQtVisOdom ()
+{
+  // no images yet
+  g0[0] = NULL;
+  g0[1] = NULL;
+  g1[0] = NULL;
+  g1[1] = NULL;
+
+  // detection and matching parameters
+  fth  = 20;                 // corner contrast
+  gx   = 12;                 // horizontal cells
+  gy   = 8;                  // vertical cells
+  srch = 6;                  // coarse search radius (= 24 full pixels)
+  sad  = 16;                 // avg gray difference per pixel
+
+  // typical Esp32 camera
+  SetSize(640, 480);
+}
+
+
+//= Get rid of all images.
+
+void jhcQtVisOdom::dealloc ()
+{
+  delete [] g1[1];
+  delete [] g1[0];
+  delete [] g0[1];
+  delete [] g0[0];
+  g0[0] = NULL;
+  g0[1] = NULL;
+  g1[0] = NULL;
+  g1[1] = NULL;
+}
+
+
+//= Set full image size (3 bytes per pixel, no line padding).
+
+void jhcQtVisOdom::SetSize (int wid, int ht)
+{
+  dealloc();
+  iw = wid;
+  ih = ht;
+  w = iw / 2;
+  h = ih / 2;
+  g0[0] = new unsigned char [w * h];
+  g1[0] = new unsigned char [w * h];
+  g0[1] = new unsigned char [(w / 2) * (h / 2)];
+  g1[1] = new unsigned char [(w / 2) * (h / 2)];
+  Reset();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Match features from last frame into this BGR frame then find new features.
+// matched pairs left in arrays x0, y0 (previous) and x1, y1 (current)
+// returns number of matched pairs
+
+int jhcQtVisOdom::Track (const unsigned char *img)
+{
+  unsigned char *tmp;
+
+  // build pyramid for new frame
+  shrink_color(g1[0], img);
+  shrink_gray(g1[1], g1[0], w, h);
+
+  // match old features then find new ones
+  np = 0;
+  if (nf > 0)
+    match_all();
+  find_corners();
+
+  // current frame becomes previous frame
+  tmp = g0[0];
+  g0[0] = g1[0];
+  g1[0] = tmp;
+  tmp = g0[1];
+  g0[1] = g1[1];
+  g1[1] = tmp;
+  return np;
+}
+
+
+//= Find incremental body motion from floor positions of matched points.
+// "a" arrays are floor points from previous frame, "b" from current frame 
+// optional "ok" array says which pairs have valid floor positions
+// gives robot translation (right, forward in inches) and CCW rotation (degs)
+// returns number of consistent points used, 0 if not enough
+
+int jhcQtVisOdom::Rigid (double& dx, double& dy, double& dth, const float *ax, const float *ay, 
+                         const float *bx, const float *by, const unsigned char *ok, int n) const
+{
+  unsigned char use[fmax];
+  double res[fmax], srt[fmax], c, s, tx, ty, ex, ey, d, lim;
+  int i, j, cnt = 0, nr = __min(n, fmax);
+
+  // initial estimate from all valid points
+  dx = 0.0;
+  dy = 0.0;
+  dth = 0.0;
+  for (i = 0; i < nr; i++)
+    use[i] = (unsigned char)(((ok == NULL) || (ok[i] > 0)) ? 1 : 0);
+  if (solve_rigid(c, s, tx, ty, ax, ay, bx, by, use, nr) < 5)
+    return 0;
+
+  // measure residuals and find median with insertion sort
+  for (i = 0; i < nr; i++)
+  {
+    res[i] = -1.0;
+    if (use[i] <= 0)
+      continue;
+    ex = c * ax[i] - s * ay[i] + tx - bx[i];
+    ey = s * ax[i] + c * ay[i] + ty - by[i];
+    d = sqrt(ex * ex + ey * ey);
+    res[i] = d;
+    for (j = cnt; (j > 0) && (srt[j - 1] > d); j--)
+      srt[j] = srt[j - 1];
+    srt[j] = d;
+    cnt++;
+  }
+
+  // drop outliers and solve again
+  lim = __max(0.3, 2.5 * srt[cnt / 2]);
+  for (i = 0; i < nr; i++)
+    if (res[i] > lim)
+      use[i] = 0;
+  if ((cnt = solve_rigid(c, s, tx, ty, ax, ay, bx, by, use, nr)) < 5)
+    return 0;
+
+  // points moved by inverse of robot motion
+  dth = -atan2(s, c) * 180.0 / M_PI;
+  dx = -(c * tx + s * ty);
+  dy = -(c * ty - s * tx);
+  return cnt;
+}
+
+
+//= Least squares rotation and translation taking "a" points to "b" points.
+// gives b = R * a + t where R = [c -s ; s c]
+// returns number of points used
+
+int jhcQtVisOdom::solve_rigid (double& c, double& s, double& tx, double& ty, const float *ax, const float *ay, 
+                               const float *bx, const float *by, const unsigned char *use, int n) const
+{
+  double max = 0.0, may = 0.0, mbx = 0.0, mby = 0.0, sc = 0.0, ss = 0.0, ux, uy, vx, vy, len;
+  int i, cnt = 0;
+
+  // find centroids
+  c = 1.0;
+  s = 0.0;
+  tx = 0.0;
+  ty = 0.0;
+  for (i = 0; i < n; i++)
+    if (use[i] > 0)
+    {
+      max += ax[i];
+      may += ay[i];
+      mbx += bx[i];
+      mby += by[i];
+      cnt++;
+    }
+  if (cnt <= 0)
+    return 0;
+  max /= cnt;
+  may /= cnt;
+  mbx /= cnt;
+  mby /= cnt;
+
+  // best rotation angle (Procrustes)
+  for (i = 0; i < n; i++)
+    if (use[i] > 0)
+    {
+      ux = ax[i] - max;
+      uy = ay[i] - may;
+      vx = bx[i] - mbx;
+      vy = by[i] - mby;
+      sc += ux * vx + uy * vy;
+      ss += ux * vy - uy * vx;
+    }
+  if ((len = sqrt(sc * sc + ss * ss)) > 0.0)
+  {
+    c = sc / len;
+    s = ss / len;
+  }
+
+  // translation maps rotated centroid onto new centroid
+  tx = mbx - (c * max - s * may);
+  ty = mby - (s * max + c * may);
+  return cnt;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Image Pyramid                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Make half-size grayscale image from full-size BGR image.
+// averages 2x2 blocks with weights 1:2:1 for blue, green, red
+
+void jhcQtVisOdom::shrink_color (unsigned char *dest, const unsigned char *src) const
+{
+  const unsigned char *a, *b;
+  unsigned char *d = dest;
+  int x, y, ln = 3 * iw;
+
+  for (y = 0; y < h; y++)
+  {
+    a = src + 2 * y * ln;
+    b = a + ln;
+    for (x = 0; x < w; x++, a += 6, b += 6, d++)
+      *d = (unsigned char)((a[0] + 2 * a[1] + a[2] + a[3] + 2 * a[4] + a[5] + 
+                            b[0] + 2 * b[1] + b[2] + b[3] + 2 * b[4] + b[5] + 8) >> 4);
+  }
+}
+
+
+//= Make half-size version of a grayscale image.
+
+void jhcQtVisOdom::shrink_gray (unsigned char *dest, const unsigned char *src, int sw, int sh) const
+{
+  const unsigned char *a, *b;
+  unsigned char *d = dest;
+  int x, y, hw = sw / 2, hh = sh / 2;
+
+  for (y = 0; y < hh; y++)
+  {
+    a = src + 2 * y * sw;
+    b = a + sw;
+    for (x = 0; x < hw; x++, a += 2, b += 2, d++)
+      *d = (unsigned char)((a[0] + a[1] + b[0] + b[1] + 2) >> 2);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Corner Detection                           //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find strongest corner in each grid cell of current half-size image.
+// only tests every other pixel (plenty for picking one feature per cell)
+// returns number of features found
+
+int jhcQtVisOdom::find_corners ()
+{
+  const unsigned char *g = g1[0];
+  int cx, cy, x, y, xlo, xhi, ylo, yhi, sc, best, bx, by, bd = 8;
+
+  nf = 0;
+  for (cy = 0; cy < gy; cy++)
+  {
+    ylo = __max(bd, (cy * h) / gy);
+    yhi = __min(((cy + 1) * h) / gy, h - bd);
+    for (cx = 0; cx < gx; cx++)
+    {
+      // scan cell for best score
+      xlo = __max(bd, (cx * w) / gx);
+      xhi = __min(((cx + 1) * w) / gx, w - bd);
+      best = 0;
+      for (y = ylo; y < yhi; y += 2)
+        for (x = xlo; x < xhi; x += 2)
+          if ((sc = corner_score(g + y * w + x, w)) > best)
+          {
+            best = sc;
+            bx = x;
+            by = y;
+          }
+
+      // save if any corner found
+      if ((best > 0) && (nf < fmax))
+      {
+        fx[nf] = bx;
+        fy[nf] = by;
+        nf++;
+      }
+    }
+  }
+  return nf;
+}
+
+
+//= FAST-9 corner test: 9 contiguous ring pixels all brighter or all darker.
+// returns strength (sum of excess contrast) or 0 if not a corner
+
+int jhcQtVisOdom::corner_score (const unsigned char *p, int ln) const
+{
+  int v[16], i, run, sc, c = *p, hi = c + fth, lo = c - fth, nb = 0, nd = 0;
+
+  // quick rejection using 4 compass points (at least 2 must agree)
+  v[0]  = p[-3 * ln];
+  v[4]  = p[3];
+  v[8]  = p[3 * ln];
+  v[12] = p[-3];
+  for (i = 0; i < 16; i += 4)
+  {
+    nb += ((v[i] > hi) ? 1 : 0);
+    nd += ((v[i] < lo) ? 1 : 0);
+  }
+  if ((nb < 2) && (nd < 2))
+    return 0;
+
+  // get rest of ring
+  for (i = 0; i < 16; i++)
+    if ((i & 3) != 0)
+      v[i] = p[ring[i][1] * ln + ring[i][0]];
+
+  // look for long enough run of brighter pixels (wrap around)
+  if (nb >= 2)
+  {
+    run = 0;
+    for (i = 0; i < 25; i++)
+      if (v[i & 15] > hi)
+      {
+        if (++run >= 9)
+          break;
+      }
+      else
+        run = 0;
+    if (run >= 9)
+    {
+      sc = 0;
+      for (i = 0; i < 16; i++)
+        sc += __max(0, v[i] - hi);
+      return __max(1, sc);
+    }
+  }
+
+  // look for long enough run of darker pixels (wrap around)
+  if (nd >= 2)
+  {
+    run = 0;
+    for (i = 0; i < 25; i++)
+      if (v[i & 15] < lo)
+      {
+        if (++run >= 9)
+          break;
+      }
+      else
+        run = 0;
+    if (run >= 9)
+    {
+      sc = 0;
+      for (i = 0; i < 16; i++)
+        sc += __max(0, lo - v[i]);
+      return __max(1, sc);
+    }
+  }
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                           Feature Tracking                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find each old feature in new frame, coarse then fine.
+// also updates prediction using median flow of good matches
+// returns number of matched pairs
+
+int jhcQtVisOdom::match_all ()
+{
+  int mdx[fmax], mdy[fmax];
+  int i, j, k, t, d, cx, cy, mx, my, e0, em, ep, w2 = w / 2, h2 = h / 2;
+  double sx, sy;
+
+  np = 0;
+  for (i = 0; i < nf; i++)
+  {
+    // coarse search around predicted position (5x5 patches)
+    cx = fx[i] / 2;
+    cy = fy[i] / 2;
+    if (best_offset(mx, my, g0[1], g1[1], w2, h2, cx, cy, cx + pdx / 2, cy + pdy / 2, srch, 2) <= 0)
+      continue;
+
+    // refine at finer level (7x7 patches)
+    if (best_offset(mx, my, g0[0], g1[0], w, h, fx[i], fy[i], 2 * mx, 2 * my, 2, 3) <= 0)
+      continue;
+
+    // subpixel adjustment with V-shaped fit to neighboring errors (suits SAD)
+    k = fy[i] * w + fx[i];
+    t = my * w + mx;
+    e0 = patch_sad(g0[0] + k, g1[0] + t, w, 3, 1 << 30);
+    em = patch_sad(g0[0] + k, g1[0] + t - 1, w, 3, 1 << 30);
+    ep = patch_sad(g0[0] + k, g1[0] + t + 1, w, 3, 1 << 30);
+    sx = (((d = __max(em, ep) - e0) > 0) ? 0.5 * (em - ep) / (double) d : 0.0);
+    em = patch_sad(g0[0] + k, g1[0] + t - w, w, 3, 1 << 30);
+    ep = patch_sad(g0[0] + k, g1[0] + t + w, w, 3, 1 << 30);
+    sy = (((d = __max(em, ep) - e0) > 0) ? 0.5 * (em - ep) / (double) d : 0.0);
+
+    // save as full-size pixel centers
+    x0[np] = (float)(2 * fx[i] + 0.5);
+    y0[np] = (float)(2 * fy[i] + 0.5);
+    x1[np] = (float)(2.0 * (mx + sx) + 0.5);
+    y1[np] = (float)(2.0 * (my + sy) + 0.5);
+
+    // keep sorted list of offsets for median
+    for (j = np; (j > 0) && (mdx[j - 1] > mx - fx[i]); j--)
+      mdx[j] = mdx[j - 1];
+    mdx[j] = mx - fx[i];
+    for (j = np; (j > 0) && (mdy[j - 1] > my - fy[i]); j--)
+      mdy[j] = mdy[j - 1];
+    mdy[j] = my - fy[i];
+    np++;
+  }
+
+  // predict similar motion next time
+  pdx = 0;
+  pdy = 0;
+  if (np >= 3)
+  {
+    pdx = mdx[np / 2];
+    pdy = mdy[np / 2];
+  }
+  return np;
+}
+
+
+//= Search around a spot in image "b" for best match to a patch in image "a".
+// patches are (2 * hw + 1) square, "mx" and "my" get best location in "b"
+// returns 1 if acceptable match found, 0 if none
+
+int jhcQtVisOdom::best_offset (int& mx, int& my, const unsigned char *a, const unsigned char *b, int ln, int ht,
+                               int ax, int ay, int bx, int by, int rad, int hw) const
+{
+  const unsigned char *pa = a + ay * ln + ax;
+  int x, y, e, sz = 2 * hw + 1, best = sad * sz * sz + 1;
+  int xlo = __max(hw + 1, bx - rad), xhi = __min(bx + rad, ln - hw - 2);
+  int ylo = __max(hw + 1, by - rad), yhi = __min(by + rad, ht - hw - 2);
+
+  // source patch must be fully inside image
+  if ((ax < hw) || (ax >= ln - hw) || (ay < hw) || (ay >= ht - hw))
+    return 0;
+
+  // exhaustive search with early termination of patch sums
+  mx = -1;
+  for (y = ylo; y <= yhi; y++)
+    for (x = xlo; x <= xhi; x++)
+      if ((e = patch_sad(pa, b + y * ln + x, ln, hw, best)) < best)
+      {
+        best = e;
+        mx = x;
+        my = y;
+      }
+  return((mx >= 0) ? 1 : 0);
+}
+
+
+//= Sum of absolute differences between two square patches (centers given).
+// stops early if running sum exceeds limit
+
+int jhcQtVisOdom::patch_sad (const unsigned char *a, const unsigned char *b, int ln, int hw, int lim) const
+{
+  const unsigned char *ra, *rb;
+  int x, y, sum = 0;
+
+  for (y = -hw; y <= hw; y++)
+  {
+    ra = a + y * ln;
+    rb = b + y * ln;
+    for (x = -hw; x <= hw; x++)
+      sum += abs(ra[x] - rb[x]);
+    if (sum >= lim)
+      return sum;
+  }
+  return sum;
+}
@@ -25,6 +25,7 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <conio.h>
 
 #include "jhcQtruck.h"
@@ -45,6 +46,7 @@ jhcQtruck::jhcQtruck ()
   // initialize exchange
   *data = '\0';
   fresh = 0;
+  xchg = INVALID_HANDLE_VALUE;
 
   // clear background thread
   run = 0;
@@ -52,6 +54,8 @@ jhcQtruck::jhcQtruck ()
 
   // set control variables
   cfg_params();
+  kin.Build(by, bs, sz, sw, fout, fdn, fext, cdot, crt);
+  gnd.SetSize(640, 480, flen);
   def_vals();
   init_state();
   Issue();     
@@ -79,18 +83,47 @@ void jhcQtruck::cfg_params ()
   fext = 1.88;               // extension = sqrt(jaw^2 - (fsep/2)^2)
   g0   = 13.0;               // fully closed = asin((sep/2) / jaw)
 
+  // arm must lift up near corners of base
+  traj.AddLimit(36.0, 0.0);
+
   // camera geometry
   cdot = 2.36;               // offset along sw link (60mm)
   crt  = 1.69;               // offset ortho to sw link (43mm)
   cp0  = 0.0;                // true pan wrt calculated (deg)
   ct0  = 0.0;                // true tilt wrt calculated (deg)
   cr0  = 0.0;                // image constant roll (deg)
+  flen = 204.4;              // focal length after undistortion (pixels)
+
+  // lens correction for 160 degree fisheye
+  lr2f =   0.7;              // r^2 distortion x 10^6
+  lr4f = -11.0;              // r^4 distortion x 10^12
+  lmag =   1.0;              // magnification after correction
+  lasp =   1.0;              // pixel aspect ratio
+  ldx  =   0.0;              // lens center right of middle (pixels)
+  ldy  =   0.0;              // lens center above middle (pixels)
 
   // tank tracks
   kips  = 12.0;              // convert from ips to motor cmd
   moff  = 35.0;              // min motor cmd value (linear fit)
+  pmin  = 55.0;              // min reliable straight cmd (dithering)
   tsep  = 4.80;              // track center separation (122mm)
   scrub = 0.80;              // turn inefficiency (voltage dependent)
+
+  // sonar reflex
+  sstop = 3.0;               // closest allowed approach (in)
+  slook = 0.15;              // contact prediction horizon (3 exchanges)
+  sclr  = 3.0;               // extra range before path counts as open (in)
+  sgap  = 0.5;               // time free before next stop is new bump (sec)
+
+  // heading servo
+  htol = 3.0;                // acceptable final heading error (deg)
+  hacc = 180.0;              // braking deceleration (deg/sec^2)
+  hlag = 0.1;                // command to motion latency (sec)
+
+  // visual odometry fusion
+  vfresh = 0.25;             // max age of camera motion (sec)
+  vnf    = 9.0;              // compass variance boost when camera okay
+  cgate  = 3.0;              // reject compass beyond this many sigmas
 }
 
 
@@ -131,10 +164,15 @@ void jhcQtruck::init_state ()
   gnow = grip;
   asp  = 0.0;
   gsp  = 0.0;
+  pbt  = bt;
+  pst  = st;
+  traj.Clear();
 
   // timing and servo state
   tick = 0;                  // time of last Pace() call
   todo = 0;                  // time of last odometry update
+  xlast = 0;                 // time of last fresh packet
+  xper = 0.045;              // typical exchange period (sec)
   head = -1.0;               // compass filter not initialized
   ips0 = 0.0;                // expected translation speed
   dps0 = 0.0;                // expected rotation speed
@@ -142,6 +180,43 @@ void jhcQtruck::init_state ()
   rdir = 0;                  // previous rotation direction
   msum = 0.0;                // sum of translation speed errors
   rsum = 0.0;                // sum of rotation speed errors
+
+  // sonar filter and reflex state
+  sfill = 0;                 // number of valid sonar samples
+  snext = 0;                 // next sample slot to overwrite
+  sdt   = 0.0;               // time since last sonar sample
+  r0    = -1.0;              // previous filtered range (invalid)
+  range = 200.0;             // median filtered sonar range
+  close = 0.0;               // smoothed closing speed (ips)
+  halt  = 0;                 // whether reflex is blocking forward motion
+  bump  = 0;                 // count of reflex stop events
+  hclr  = 1000.0;            // time since reflex last blocked (sec)
+
+  // track dithering state
+  duty = 0.0;                // fraction of exchanges with motors on
+  dsum = 0.0;                // sigma-delta accumulator
+  lpul = 0.0;                // left motor command when pulsed on
+  rpul = 0.0;                // right motor command when pulsed on
+  pkt  = 0;                  // exchanges since last Drive() call
+  pon  = 0;                  // whether motors pulsed on this exchange
+
+  // visual odometry state
+  vips  = 0.0;               // forward speed from camera (ips)
+  vdps  = 0.0;               // rotation speed from camera (dps)
+  vtime = 0;                 // no camera motion yet
+
+  // heading servo state
+  htgt  = 0.0;               // desired heading (deg CCW)
+  hsp   = 0.0;               // max rotation speed (dps)
+  hsum  = 0.0;               // cumulative odometric rotation (deg CCW)
+  hmode = 0;                 // not servoing heading
+  hdir  = 0;                 // initial direction of turn
+  hrel  = 0;                 // target is absolute compass heading
+
+  // firmware servo values at power up
+  sapp[0] = 90;              // base
+  sapp[1] = 100;             // lift
+  sapp[2] = 120;             // grip
 }
 
 
@@ -185,7 +260,10 @@ const char *jhcQtruck::BluSwap (const char *sensors)
   pthread_mutex_lock(xchg)
   *actuators = '\0';
   if (run > 0)
+  {
     strcpy_s(actuators, cmd);
+    firm_servos(actuators);
+  }
   strcpy_s(data, sensors);
   fresh = 1;
   pthread_mutex_unlock(xchg)
@@ -208,15 +286,26 @@ void jhcQtruck::BluDone ()
 // simple file format:
 //   line 1 = name                name of robot (e.g. Waldo)
 //   line 2 = boff soff goff      arm servo offsets for zero angle
-//   line 3 = cp0 ct0 cr0         camera angle adjustments wrt nominal
+//   line 3 = cp0 ct0 cr0 flen    camera angle adjustments and focal length
+// focal length is optional (keeps default if missing)
+// optional lens file has single line: r2f r4f mag asp dx dy flen
 
 void jhcQtruck::calib_vals (const char *id)
 {
   char fname[80], line[80];
   FILE *in;
 
-  // look for calibration file associated with this robot
+  // get lens correction for this robot's camera (if any)
   strcpy_s(mb, id);
+  sprintf_s(fname, "config/%s_lens.cfg", id);
+  if (fopen_s(&in, fname, "r") == 0)
+  {
+    if (fgets(line, 80, in) != NULL)
+      sscanf_s(line, "%lf %lf %lf %lf %lf %lf %lf", &lr2f, &lr4f, &lmag, &lasp, &ldx, &ldy, &flen);
+    fclose(in);
+  }
+
+  // look for calibration file associated with this robot
   sprintf_s(fname, "config/%s_calib.cfg", id);
   if (fopen_s(&in, fname, "r") != 0)
   {
@@ -232,7 +321,7 @@ void jhcQtruck::calib_vals (const char *id)
     {
       sscanf_s(line, "%lf %lf %lf", &boff, &soff, &goff); 
       if (fgets(line, 90, in) != NULL)
-        sscanf_s(line, "%lf %lf %lf", &cp0, &ct0, &cr0);
+        sscanf_s(line, "%lf %lf %lf %lf", &cp0, &ct0, &cr0, &flen);
     }
   }
   fclose(in);
@@ -315,11 +404,21 @@ int jhcQtruck::Update()
   fr = fresh;
   fresh = 0;
   pthread_mutex_unlock(xchg)
+  pkt += fr;
 
   // extract raw and derived sensor values
   if (fr > 0)
     decode_info(msg);
   compute_odom();
+  filter_sonar(fr);
+
+  // track average packet exchange period (for arm trajectories)
+  if (fr > 0)
+  {
+    if (xlast != 0)
+      xper += 0.1 * (0.001 * (todo - xlast) - xper);
+    xlast = todo;
+  }
   return((fr > 0) ? 1 : 0);
 }
 
@@ -373,14 +472,17 @@ void jhcQtruck::decode_info (const char *msg)
 
 // Get smoothed heading and find characteristics of motion during last cycle.
 // sets sensor variables "head", "dt", "dm", and "dr" (also "todo" and "hvar")
+// heading prediction uses modelled rotation "dr" then corrects with compass
+// prefers recent camera motion (see VisMotion) and then trusts compass less
 // updates expected servo angles "bnow", "snow", and "gnow"
-// ignores details of transfer times and rates -- assumes perfect control
+// servo angles are those firmware actually applied (not just requested)
 // NOTE: smoothed direction "head" is still noisy and not very accurate
 
 void jhcQtruck::compute_odom ()
 {
   double diff, vm, kal, h0 = head, f = 0.1, nv = 81.0;     // compass +/- 9 degs
   unsigned long last = todo;
+  int vis;
 
   // get duration "dt" of last cycle (time since last call)
   todo = timeGetTime();
@@ -389,13 +491,19 @@ void jhcQtruck::compute_odom ()
     dt = 0.001 * (double)(todo - last);
 
   // estimate translation "dm" and rotation "dr" based on speeds 
-  dm = ips0 * dt;
-  dr = dps0 * dt;
-
-  // assume all servo targets reached (account for clipping)
-  bnow = (bc - 90.0) - boff;
-  snow = (sc - 75.0) - soff;
-  gnow = ((gc - 90.0) - g0) - goff;
+  // use measured camera speeds if fresh, else expected from commands
+  vis = (((vtime != 0) && ((todo - vtime) <= (unsigned long)(1000.0 * vfresh))) ? 1 : 0);
+  dm = ((vis > 0) ? vips : ips0) * dt;
+  dr = ((vis > 0) ? vdps : dps0) * dt;
+  if (vis > 0)
+    nv *= vnf;
+
+  // assume servos reached values firmware last applied
+  pthread_mutex_lock(xchg)
+  bnow = (sapp[0] - 90.0) - boff;
+  snow = (sapp[1] - 75.0) - soff;
+  gnow = ((sapp[2] - 90.0) - g0) - goff;
+  pthread_mutex_unlock(xchg)
 
   // possibly initialize compass filter (to cut jitter in half)
   if (h0 < 0.0)
@@ -406,7 +514,13 @@ void jhcQtruck::compute_odom ()
     return;
   }
 
-  // project from last step and estimate variance
+  // project from last step using expected rotation and estimate variance
+  hsum += dr;
+  head += dr;
+  if (head >= 360.0)
+    head -= 360.0;
+  else if (head < 0.0)
+    head += 360.0;
   diff = comp - head;
   if (diff > 180.0)
     diff -= 360.0;
@@ -414,6 +528,13 @@ void jhcQtruck::compute_odom ()
     diff += 360.0;
   vm = (1.0 - f) * hvar + f * diff * diff;
 
+  // ignore wild compass readings (e.g. near steel) if camera is working
+  if ((vis > 0) && ((diff * diff) > (cgate * cgate * (hvar + nv))))
+  {
+    hvar += f * nv;
+    return;
+  }
+
   // add in new measurement using Kalman gain
   kal = vm / (vm + nv);
   head += kal * diff;
@@ -425,6 +546,49 @@ void jhcQtruck::compute_odom ()
 }
 
 
+//= Reject sonar glitches with a running median and estimate closing speed.
+// sets "range" and "close" (positive if obstacle getting nearer)
+// only takes a new sample when fresh data has arrived from robot
+
+void jhcQtruck::filter_sonar (int fr)
+{
+  double srt[5], v, d, f = 0.3, vmax = 12.0;
+  int i, j;
+
+  // accumulate time since last sample
+  sdt += dt;
+  if (fr <= 0)
+    return;
+
+  // add new reading to circular buffer
+  sbuf[snext] = dist;
+  snext = (snext + 1) % 5;
+  sfill = __min(sfill + 1, 5);
+
+  // find median with a simple insertion sort
+  for (i = 0; i < sfill; i++)
+  {
+    d = sbuf[i];
+    for (j = i; (j > 0) && (srt[j - 1] > d); j--)
+      srt[j] = srt[j - 1];
+    srt[j] = d;
+  }
+  range = srt[sfill / 2];
+
+  // update closing speed unless no echo on either sample
+  if ((r0 > 0.0) && (r0 < 200.0) && (range < 200.0) && (sdt > 0.0))
+  {
+    v = (r0 - range) / sdt;
+    v = __max(-vmax, __min(v, vmax));
+    close += f * (v - close);
+  }
+  else
+    close = 0.0;
+  r0 = range;
+  sdt = 0.0;
+}
+
+
 //= Build transfer command string from individual command variables. 
 // NOTE: call this at end to generate valid robot command string
 
@@ -432,14 +596,16 @@ void jhcQtruck::Issue ()
 {
   char msg[15];
 
-  // slowly change servo setpoints then assemble command string
+  // slowly change servo setpoints
   ramp_arm();
   ramp_hand();
-  encode_cmds(msg, 15);
+  sonar_reflex();
  
-  // copy to persistent Bluetooth output buffer
+  // assemble command and copy to persistent Bluetooth output buffer
   //   msg[] -> cmd[] -> actuators[]
+  // NOTE: lock keeps applied servo values stable during scheduling
   pthread_mutex_lock(xchg)
+  encode_cmds(msg, 15);
   strcpy_s(cmd, msg);                   
   pthread_mutex_unlock(xchg)
 
@@ -448,55 +614,53 @@ void jhcQtruck::Issue ()
 }
 
 
-//= Change arm servo command angles based on assigned targets and rates.
+//= Change arm servo command angles by following a smooth trajectory.
+// replans from current angles and velocities whenever the goal moves
 // expects next cycle will take same amount of time as this cycle
 
 void jhcQtruck::ramp_arm ()
 {
-  double bdev, sdev, binc, sinc, clr = 0.0;
+  double gb = bnow, gs = snow;
 
   // skip if not using high-level Reach()
   if (asp <= 0.0)
     return;
 
-  // make sure arm lifts up near corners of base
-  if (fabs(bnow) >= 36.0)
-  {
-    if (snow < clr)
-      bt = bnow;                    
-    st = __max(clr, st);
-  } 
-
-  // enforce minimum speed to prevent gear binding (> 90 dps)
-  binc = __max(90.0, asp) * dt;
-  sinc = binc;
-
-  // coordinate speeds so servos finish simultaneously
-  bdev = fabs(bnow - bt);
-  sdev = fabs(snow - st);
-  if (bdev > sdev)
-    sinc *= sdev / bdev;
-  else if (sdev > 0.0)
-    binc *= bdev / sdev;
-   
-  // adjust base servo angle (avoid limit stall)
-  binc = __min(bdev, binc);
-  if (bt >= bnow)
-    base = bnow + binc;
-  else
-    base = bnow - binc;
-  base = __max(-90.0, __min(base, 90.0));
+  // possibly start a new trajectory toward goal
+  traj.Goal(gb, gs);
+  if ((fabs(bt - pbt) > 0.5) || (fabs(st - pst) > 0.5) || 
+      ((traj.Active() <= 0) && (__max(fabs(gb - bnow), fabs(gs - snow)) > 0.5)))
+    plan_arm(&bt, &st, 1, asp);
 
-  // adjust shoulder servo angle (avoid limit stall)
-  sinc = __min(sdev, sinc);
-  if (st >= snow)
-    lift = snow + sinc;
-  else
-    lift = snow - sinc;
+  // get setpoints for end of next cycle (avoid limit stall)
+  traj.Step(base, lift, dt);
+  base = __max(-90.0, __min(base, 90.0));
   lift = __max(-30.0, __min(lift, 40.0));
 }
 
 
+//= Build a smooth cruise-then-stop trajectory from current arm state through joint targets.
+// accounts for packet rate and for gripper stealing servo update slots
+// remembers requested goal (actual end may be raised near base corners)
+
+void jhcQtruck::plan_arm (const double *b, const double *s, int n, double dps)
+{
+  double db, ds;
+
+  // servos after first two in packet get delayed (only 2 updated)
+  traj.pkt = xper;
+  traj.share = 1.0;
+  if ((gsp > 0.0) && (fabs(gnow - gt) > 1.0))
+    traj.share = 2.0 / 3.0;
+
+  // start from current angles and speeds
+  traj.Vel(db, ds);
+  traj.Plan(bnow, snow, db, ds, b, s, n, dps);
+  pbt = b[n - 1];
+  pst = s[n - 1];
+}
+
+
 //= Change gripper servo command angle based on assigned target and rate.
 // expects next cycle will take same amount of time as this cycle
 
@@ -522,6 +686,49 @@ void jhcQtruck::ramp_hand ()
 }
 
 
+//= Block forward base motion if sonar predicts imminent contact.
+// uses larger of commanded speed and measured closing speed
+// sets "halt" while clamping and counts new events in "bump"
+// if Drive() is dithering then uses average effort instead of current pulse
+// stop only counts as new bump if motion was unblocked for a while before
+// NOTE: acts within one cycle, well before reasoner can react (see Bumps)
+
+void jhcQtruck::sonar_reflex ()
+{
+  double fwd, gap;
+
+  // rotation in place or backing up is always allowed
+  if ((duty > 0.0) && (duty < 1.0))
+    fwd = duty * 0.5 * (track_ips(lpul) + track_ips(rpul));
+  else
+    fwd = 0.5 * (track_ips(lf) + track_ips(rt));
+  if (fwd <= 0.0)
+  {
+    hclr += dt;
+    halt = 0;
+    return;
+  }
+
+  // predict range a few exchanges from now
+  gap = range - slook * __max(fwd, close);
+  if (gap >= sstop)
+  {
+    hclr += dt;
+    halt = 0;
+    return;
+  }
+
+  // remove forward components of track commands (no dithering)
+  if ((halt <= 0) && (hclr >= sgap))
+    bump++;
+  hclr = 0.0;
+  halt = 1;
+  lf = __min(lf, 0.0);
+  rt = __min(rt, 0.0);
+  duty = 0.0;
+}
+
+
 //= Assemble various actuator values into command string.
 // motor command string is decimal coded = LL:RR:BBB:FF:GG:C:M 
 
@@ -540,6 +747,7 @@ void jhcQtruck::encode_cmds (char *msg, int ssz)
   bc  = __max( 0.0, __min(bc, 180.0));
   sc  = __max(30.0, __min(sc, 120.0));
   gc  = __max(80.0, __min(gc, 145.0));
+  sched_servos();
   col = __max(0, __min(col, 9));
   mth = __max(0, __min(mth, 2));
 
@@ -555,24 +763,101 @@ void jhcQtruck::encode_cmds (char *msg, int ssz)
 }
 
 
+//= Choose which servos to advance when all three want to change.
+// firmware only updates 2 servos per packet (else Bluetooth crashes) and 
+// otherwise picks by size of change, so host decides based on deadlines
+// urgency is degrees left divided by time until servo should get there
+// deferred servo is sent its applied value so firmware leaves it alone
+// NOTE: expects "xchg" lock to be held by caller
+
+void jhcQtruck::sched_servos ()
+{
+  double want[3] = {bc, sc, gc}, due[3], urge[3];
+  int i, err, low = -1;
+
+  // arm follows trajectory, gripper moves at its ramp rate
+  due[0] = traj.Left();
+  due[1] = due[0];
+  due[2] = 0.0;
+  if (gsp > 0.0)
+    due[2] = fabs(gt - gnow) / __max(90.0, gsp);
+
+  // rate each servo with a pending change (all must be moving)
+  for (i = 0; i < 3; i++)
+  {
+    err = abs((int)(want[i] + 0.5) - sapp[i]);
+    if (err <= 0)
+      return;
+    urge[i] = err / __max(xper, due[i]);
+    if ((low < 0) || (urge[i] < urge[low]))
+      low = i;
+  }
+
+  // hold least urgent servo at current value for this packet
+  if (low == 0)
+    bc = sapp[0];
+  else if (low == 1)
+    sc = sapp[1];
+  else
+    gc = sapp[2];
+}
+
+
+//= Mimic firmware servo selection to learn what was actually applied.
+// looks at outgoing command string just before it goes to robot
+// same rule as qt_blulink.py "set_arm": base always, then larger of others
+// NOTE: expects "xchg" lock to be held by caller
+
+void jhcQtruck::firm_servos (const char *msg)
+{
+  char num[4];
+  int b, s, g, berr, serr, gerr;
+
+  // firmware ignores short commands
+  if (strlen(msg) < 13)
+    return;
+
+  // extract servo angles (undo lift and grip offsets)
+  strncpy_s(num, msg + 4, 3);
+  b = atoi(num);
+  strncpy_s(num, msg + 7, 2);
+  s = atoi(num) + 25;
+  strncpy_s(num, msg + 9, 2);
+  g = atoi(num) + 65;
+
+  // apply selection rule
+  berr = abs(b - sapp[0]);
+  serr = abs(s - sapp[1]);
+  gerr = abs(g - sapp[2]);
+  if (berr > 0)
+    sapp[0] = b;
+  if ((serr > 0) && ((berr <= 0) || (serr >= gerr)))
+    sapp[1] = s;
+  if ((gerr > 0) && ((berr <= 0) || (gerr > serr)))
+    sapp[2] = g;
+}
+
+
 //= Get expected rotation and translation speeds by back-computing from motor settings.
 // assumes variables "lf" and "rt" have current command values (incl. limits)
+// if Drive() is dithering then uses average effort instead of current pulse
 
 void jhcQtruck::calc_speeds ()
 {
   double lsp, rsp, lag = 0.94;         // timing fudge factor 
 
-  // convert left motor command to ips
-  lsp = (fabs(lf) - moff) / kips;         
-  lsp = __max(0.0, lsp);
-  if (lf < 0.0)
-    lsp = -lsp;
-
-  // convert left motor command to ips
-  rsp = (fabs(rt) - moff) / kips;          
-  rsp = __max(0.0, rsp);
-  if (rt < 0.0)
-    rsp = -rsp;
+  // convert motor commands to ips
+  if ((duty > 0.0) && (duty < 1.0))
+  {
+    lsp = duty * track_ips(lpul);
+    rsp = duty * track_ips(rpul);
+  }
+  else
+  {
+    lsp = track_ips(lf);
+    rsp = track_ips(rt);
+  }
+  duty = 0.0;                          // Drive() must re-assert
 
   // average is translation, scaled difference is rotation
   ips0 = lag * 0.5 * (lsp + rsp);
@@ -601,10 +886,18 @@ void jhcQtruck::Gaze (double p, double t, double dps)
 
 void jhcQtruck::CamLoc (double& x, double& y, double& z) const
 {
-  double b = bnow * M_PI / 180.0, s = snow * M_PI / 180.0;
-  double r = bs + cdot * cos(s) - crt * sin(s);
+  double b = bnow * M_PI / 180.0, s = snow * M_PI / 180.0, r;
+
+  // use interpolated table if available
+  if (kin.Ready() > 0)
+  {
+    kin.CamFK(x, y, z, bnow, snow);
+    return;
+  }
 
-  x = r * sin(b);
+  // direct computation
+  r = bs + cdot * cos(s) - crt * sin(s);
+  x = -r * sin(b);
   y = r * cos(b) + by;
   z = sz + cdot * sin(s) + crt * cos(s);
 }                    
@@ -624,6 +917,58 @@ void jhcQtruck::CamDir (double *p, double *t, double *r) const
 }
 
 
+//= Find floor location seen at some pixel in a corrected camera image.
+// pixel y is bottom-up as in image buffers, result is wrt robot center
+// returns 1 if valid, 0 if above horizon or too far away
+// NOTE: projection table only rebuilt when camera pose changes
+
+int jhcQtruck::FloorPt (double& x, double& y, double px, double py)
+{
+  floor_pose();
+  return gnd.Floor(x, y, px, py);
+}
+
+
+//= Find floor locations for a whole list of pixels (y bottom-up).
+// optional "ok" array gets 1 for each valid point, 0 otherwise
+// returns number of valid points
+
+int jhcQtruck::FloorPts (float *x, float *y, const float *px, const float *py, int n, unsigned char *ok)
+{
+  floor_pose();
+  return gnd.Batch(x, y, px, py, n, ok);
+}
+
+
+//= Find pixel (y bottom-up) in corrected camera image where some point appears.
+// point is wrt center of robot body in inches (y forward, x right, z up)
+// returns 1 if in front of camera (may be outside image), 0 if behind
+
+int jhcQtruck::CamPix (double& px, double& py, double x, double y, double z)
+{
+  floor_pose();
+  return gnd.Pixel(px, py, x, y, z);
+}
+
+
+//= Tell floor projector where camera is now (rebuilds table if moved).
+// also picks up any change in focal length (e.g. from calibration file)
+
+void jhcQtruck::floor_pose ()
+{
+  double x, y, z, p, t, r;
+
+  if (gnd.flen != flen)
+  {
+    gnd.flen = flen;
+    gnd.Reset();
+  }
+  CamLoc(x, y, z);
+  CamDir(&p, &t, &r);
+  gnd.Pose(x, y, z, p, t, r);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////
 //                            Arm Interface                              //
 ///////////////////////////////////////////////////////////////////////////
@@ -650,19 +995,83 @@ double jhcQtruck::Astray () const
 //= Move fingertips close to given location wrt center of body.
 // y points forward, x is to right, z up from floor, coordinates in inches
 // can only really move hand in thin arc (shell) in front of robot
+// if target height is off shell then goes to nearest reachable pose
+// returns 1 if fingertips will get near target, 0 if only nearest pose
 
-void jhcQtruck::Reach (double x, double y, double z, double ips)
+int jhcQtruck::Reach (double x, double y, double z, double ips)
 {
-  double dy, err;
-
-  // aim so grasp point on line from shoulder to target
-  dy = y - by;
-  bt = atan2(x, dy) * -180.0 / M_PI;
-  st = asin((z + fdn - sz) / sw) * 180.0 / M_PI;
+  double err;
 
-  // compute angular speed based on Cartesian distance
+  // find joint angles then compute angular speed based on Cartesian distance
+  solve_ik(bt, st, x, y, z);
   err = __max(fabs(bt - bnow), fabs(st - snow));
-  asp = ips * err / HandErr(x, y, z);
+  asp = ips * err / __max(0.1, HandErr(x, y, z));
+  return kin.Reachable(x, y, z);
+}
+
+
+//= Move fingertips smoothly through a series of locations wrt center of body.
+// y points forward, x is to right, z up from floor, coordinates in inches
+// speed is approximate based on current arm extension
+// skips intermediate waypoints hand cannot get near (final always kept)
+// returns number of waypoints used (max 10)
+
+int jhcQtruck::Path (const double *x, const double *y, const double *z, int n, double ips)
+{
+  float fb[10], fs[10], hx[10], hy[10], hz[10];
+  double b[10], s[10], dx, dy, dz, r, tol = 0.5;
+  int i, k, nw = __min(n, 10);
+
+  // convert all waypoints to joint angles
+  if (nw <= 0)
+    return 0;
+  for (i = 0; i < nw; i++)
+  {
+    solve_ik(b[i], s[i], x[i], y[i], z[i]);
+    fb[i] = (float) b[i];
+    fs[i] = (float) s[i];
+  }
+
+  // check where all poses actually put hand in one pass
+  if (kin.BatchFK(hx, hy, hz, fb, fs, nw) > 0)
+  {
+    for (i = 0, k = 0; i < nw; i++)
+    {
+      dx = hx[i] - x[i];
+      dy = hy[i] - y[i];
+      dz = hz[i] - z[i];
+      if ((i < (nw - 1)) && ((dx * dx + dy * dy + dz * dz) > (tol * tol)))
+        continue;
+      b[k] = b[i];
+      s[k] = s[i];
+      k++;
+    }
+    nw = k;
+  }
+
+  // plan trajectory at approximate angular speed
+  r = bs + sw * cos(snow * M_PI / 180.0) + fout + fext;
+  asp = 180.0 * ips / (M_PI * r);
+  bt = b[nw - 1];
+  st = s[nw - 1];
+  plan_arm(b, s, nw, asp);
+  return nw;
+}
+
+
+//= Find arm servo angles to put fingertips near some location.
+// aim so grasp point on line from shoulder to target at same height
+// if target height is off shell then uses nearest reachable pose
+
+void jhcQtruck::solve_ik (double& b, double& s, double x, double y, double z) const
+{
+  double sn = (z + fdn - sz) / sw;
+
+  b = atan2(x, y - by) * -180.0 / M_PI;
+  if (fabs(sn) <= 1.0)
+    s = asin(sn) * 180.0 / M_PI;
+  else
+    kin.Nearest(b, s, x, y, z);
 }                 
  
 
@@ -672,9 +1081,17 @@ void jhcQtruck::Reach (double x, double y, double z, double ips)
 
 void jhcQtruck::HandLoc (double& x, double& y, double& z) const
 {
-  double b = bnow * M_PI / 180.0, s = snow * M_PI / 180.0;
-  double r = bs + sw * cos(s) + fout + fext;
+  double b = bnow * M_PI / 180.0, s = snow * M_PI / 180.0, r;
+
+  // use interpolated table if available
+  if (kin.Ready() > 0)
+  {
+    kin.HandFK(x, y, z, bnow, snow);
+    return;
+  }
 
+  // direct computation
+  r = bs + sw * cos(s) + fout + fext;
   x = -r * sin(b);
   y =  r * cos(b) + by;
   z = sz + sw * sin(s) - fdn;
@@ -743,46 +1160,166 @@ double jhcQtruck::Width () const
 
 //= Specify desired travel (in/sec) and rotational (deg/sec) speeds.
 // sets raw base motor variables "lf" and "rt"
+// slow requests are dithered: full effort pulses on a fraction of exchanges
+// if Face() or Turn() is active then rotation comes from heading servo instead
 // generally on carpet max: ips = 5.5"/sec, dps = 90 deg/sec 
 
 void jhcQtruck::Drive (double ips, double dps)
 {  
-  double mv, rot, diff, lsp, rsp, over;
+  double mv, rot, diff, lsp, rsp, fast, vlo, vhi, sc = 1.0;
+  int adv = pkt;
 
-  // alter commands to catch-up if too slow
+  // alter commands to catch-up if too slow (heading servo overrides rotation)
+  if (hmode > 0)
+    dps = head_servo();
   servo_correct(mv, rot, ips, dps);
+  pkt = 0;
  
-  // mix translation and rotation then convert to motor commands
+  // mix translation and rotation into track speeds
   diff = rot * (tsep * M_PI) / (360.0 * scrub);
   lsp = mv - diff;
   rsp = mv + diff;
-  lf = kips * fabs(lsp) + moff;
-  rt = kips * fabs(rsp) + moff;
+  fast = __max(fabs(lsp), fabs(rsp));
+  if (fast <= 0.0)
+  {
+    lf = 0.0;
+    rt = 0.0;
+    dsum = 0.0;
+    return;
+  }
 
   // turning is unreliable unless one track is at full power (100)
-  if ((lf < 100.0) && (rt < 100.0))
+  vhi = (100.0 - moff) / kips;
+  vlo = ((diff != 0.0) ? vhi : (pmin - moff) / kips);
+
+  // normalize to scale rotation and translation the same
+  if (fast > vhi)
+    sc = vhi / fast;
+  else if (fast < vlo)
+    sc = vlo / fast;
+  duty = __min(1.0 / sc, 1.0);
+
+  // convert to pulse motor commands and squelch deadband for slow track
+  lpul = kips * fabs(sc * lsp) + moff;
+  rpul = kips * fabs(sc * rsp) + moff;
+  if (lpul < 50.0)
+    lpul = 0.0;
+  if (rpul < 50.0)
+    rpul = 0.0;
+  if (lsp < 0.0)
+    lpul = -lpul;
+  if (rsp < 0.0)
+    rpul = -rpul;
+
+  // sigma-delta modulation advances once per exchange (not per call)
+  if (duty >= 1.0)
   {
-    lf = kips * fabs(mv) + moff;
-    rt = lf;
+    dsum = 0.0;
+    pon = 1;
   }
+  else if (adv > 0)
+  {
+    dsum += duty;
+    pon = ((dsum >= 0.5) ? 1 : 0);
+    if (pon > 0)
+      dsum -= 1.0;
+  }
+  lf = ((pon > 0) ? lpul : 0.0);
+  rt = ((pon > 0) ? rpul : 0.0);
+}
 
-  // normalize to scale rotation and translation the same
-  over = __max(lf, rt) / 100.0;
-  if (over > 1.0)
+
+//= Rotate base to some absolute heading using closed-loop control.
+// heading is CCW from compass zero (like "head"), dps <= 0 cancels
+// servoing continues inside Drive() until within tolerance
+
+void jhcQtruck::Face (double h, double dps)
+{
+  hmode = 0;
+  if (dps <= 0.0)
+    return;
+  htgt = fmod(h, 360.0);
+  if (htgt < 0.0)
+    htgt += 360.0;
+  hsp = dps;
+  hrel = 0;
+  hdir = ((HeadErr() >= 0.0) ? 1 : -1);
+  hmode = 1;
+}
+
+
+//= Rotate base by some angle (CCW positive) relative to current heading.
+// closes on summed odometric rotation "dr" (no compass) and never wraps
+// so Turn(360) goes all the way around and big turns keep their direction
+// dps <= 0 cancels, servoing continues inside Drive() until within tolerance
+
+void jhcQtruck::Turn (double amt, double dps)
+{
+  hmode = 0;
+  if (dps <= 0.0)
+    return;
+  htgt = hsum + amt;
+  hsp = dps;
+  hrel = 1;
+  hdir = ((amt >= 0.0) ? 1 : -1);
+  hmode = 1;
+}
+
+
+//= Accept incremental body motion measured by some other means (e.g. camera).
+// takes forward translation (in) and CCW rotation (deg) over some interval
+// used instead of command-based speeds by odometry while still fresh
+
+void jhcQtruck::VisMotion (double fwd, double rot, double secs)
+{
+  if (secs <= 0.0)
+    return;
+  vips = fwd / secs;
+  vdps = rot / secs;
+  vtime = timeGetTime();
+}
+
+
+//= Tell how much more base must turn (CCW positive) to reach heading target.
+// error for Turn() is unwrapped, error for Face() is shortest way around
+
+double jhcQtruck::HeadErr () const
+{
+  double err = htgt - head;
+
+  if (hrel > 0)
+    return(htgt - hsum);
+  if (err > 180.0)
+    err -= 360.0;
+  else if (err <= -180.0)
+    err += 360.0;
+  return err;
+}
+
+
+//= Compute rotation speed to approach heading target without overshoot.
+// braking profile based on error predicted after actuation latency
+// motor model in Drive() then acts as feedforward for this rate
+// clears "hmode" when close enough or when target has been passed
+
+double jhcQtruck::head_servo ()
+{
+  double err, mag, dps;
+
+  // predict where heading will be when new command takes effect
+  err = HeadErr() - dps0 * hlag;
+  mag = fabs(err);
+
+  // stop if within tolerance or already swinging past target 
+  if ((mag <= htol) || (err * hdir < 0.0))
   {
-    lf /= over;
-    rt /= over;
+    hmode = 0;
+    return 0.0;
   }
-  
-  // squelch deadband (motors don't move for small cmds) then restore sign 
-  if (lf < 50.0)
-    lf = 0.0;
-  if (rt < 50.0)
-    rt = 0.0;
-  if (lsp < 0.0)
-    lf = -lf;
-  if (rsp < 0.0)
-    rt = -rt;
+
+  // limit speed so base can decelerate in remaining angle
+  dps = __min(hsp, sqrt(2.0 * hacc * mag));
+  return((err > 0.0) ? dps : -dps);
 }
 
 
@@ -818,6 +1355,17 @@ void jhcQtruck::servo_correct (double& mv, double& rot, double ips, double dps)
 }
 
 
+//= Convert a single motor command into expected track speed (ips).
+
+double jhcQtruck::track_ips (double m) const
+{
+  double sp = (fabs(m) - moff) / kips;
+
+  sp = __max(0.0, sp);
+  return((m < 0.0) ? -sp : sp);
+}
+
+
 //= Tells battery charge state in percent (0-100).
 // uses linear approximation based on measured voltage
 
@@ -26,6 +26,10 @@
 
 #include "jhc_pthread.h"
 
+#include "jhcQtFloor.h"
+#include "jhcQtReach.h"
+#include "jhcQtTraj.h"
+
 
 //= Handles text messages to/from Hiwonder Qtruck robot.
 // The easiest way to interface to Bluetooth LE is through the Python "Bleak" 
@@ -53,9 +57,42 @@ private:
   // arm servo commands, angles, targets, and speeds
   double bc, sc, bnow, snow, bt, st, asp;
 
+  // smooth arm trajectory and goal it was planned for
+  jhcQtTraj traj;
+  double pbt, pst;
+
+  // average Bluetooth exchange period
+  unsigned long xlast;
+  double xper;
+
   // hand servo command, angle, target, and speed
   double gc, gnow, gt, gsp;
 
+  // sonar median filter and closing speed estimate
+  double sbuf[5], sdt, r0;
+  int sfill, snext;
+
+  // time since sonar reflex last blocked motion
+  double hclr;
+
+  // track effort dithering
+  double duty, dsum, lpul, rpul;
+  int pkt, pon;
+
+  // heading servo target, speed, and mode (relative uses unwrapped odometry)
+  double htgt, hsp, hsum;
+  int hmode, hdir, hrel;
+
+  // servo angles actually applied by firmware (base, lift, grip)
+  int sapp[3];
+
+  // latest visual odometry speeds and when received
+  double vips, vdps;
+  unsigned long vtime;
+
+  // image to floor projection for current camera pose
+  jhcQtFloor gnd;
+
 
 // PROTECTED MEMBER PARAMETERS
 protected:
@@ -69,10 +106,22 @@ protected:
   double fout, fdn, fsep, jaw, fext, g0;
 
   // camera geometry
-  double cdot, crt, cp0, ct0, cr0;
+  double cdot, crt, cp0, ct0, cr0, flen;
+
+  // lens correction (see ocv_warp)
+  double lr2f, lr4f, lmag, lasp, ldx, ldy;
 
   // tank tracks
-  double tsep, scrub, kips, moff;
+  double tsep, scrub, kips, moff, pmin;
+
+  // sonar reflex
+  double sstop, slook, sclr, sgap;
+
+  // heading servo
+  double htol, hacc, hlag;
+
+  // visual odometry fusion
+  double vfresh, vnf, cgate;
 
 
 // PROTECTED MEMBER VARIABLES
@@ -88,6 +137,13 @@ protected:
   // derived odometric values
   double head, dt, dm, dr;
 
+  // filtered sonar range, closing speed, and reflex status
+  double range, close;
+  int halt, bump;
+
+  // precomputed arm kinematics
+  jhcQtReach kin;
+
 
 // PUBLIC MEMBER FUNCTIONS
 public:
@@ -116,11 +172,15 @@ protected:
   void Gaze (double p, double t, double dps =90.0);
   void CamLoc (double& x, double& y, double& z) const;
   void CamDir (double *p, double *t, double *r =NULL) const;
+  int FloorPt (double& x, double& y, double px, double py);
+  int FloorPts (float *x, float *y, const float *px, const float *py, int n, unsigned char *ok =NULL);
+  int CamPix (double& px, double& py, double x, double y, double z);
 
   // arm interface
   void Home (double dps =90.0);
   double Astray () const;
-  void Reach (double x, double y, double z, double ips =6.0);
+  int Reach (double x, double y, double z, double ips =6.0);
+  int Path (const double *x, const double *y, const double *z, int n, double ips =6.0);
   void HandLoc (double& x, double& y, double& z) const;
   void HandDir (double *p, double *t =NULL, double *r =NULL) const;
   double HandErr (double x, double y, double z) const;
@@ -131,6 +191,15 @@ protected:
 
   // base interface
   void Drive (double ips, double dps);
+  void Face (double h, double dps =90.0);
+  void Turn (double amt, double dps =90.0);
+  double HeadErr () const;
+  void VisMotion (double fwd, double rot, double secs);
+  int Turning () const {return hmode;}
+  int Moving () const {return(((ips0 != 0.0) || (dps0 != 0.0)) ? 1 : 0);}
+  int Blocked () const {return halt;}
+  int Bumps () const {return bump;}
+  double Sonar () const {return range;}
   double Battery () const;
 
   // utilities
@@ -151,16 +220,25 @@ private:
   // Bluetooth connection
   static pthread_ret churn_away (void *qt);
   void calib_vals (const char *id);
+  void floor_pose ();
 
   // message exchange
   void decode_info (const char *msg);
   void compute_odom ();
   void ramp_arm ();
+  void plan_arm (const double *b, const double *s, int n, double dps);
   void ramp_hand ();
+  void sched_servos ();
+  void firm_servos (const char *msg);
+  void filter_sonar (int fr);
+  void sonar_reflex ();
   void encode_cmds (char *msg, int ssz);
   void calc_speeds ();
 
   // loop helpers
+  void solve_ik (double& b, double& s, double x, double y, double z) const;
   void servo_correct (double& mv, double& rot, double ips, double dps);
+  double head_servo ();
+  double track_ips (double m) const;
 
 };
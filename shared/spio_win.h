@@ -1,4 +1,4 @@
-// spio_win.h : online Azure speech recognition and local Windows TTS
+// spio_win.h : pluggable speech recognition and local Windows TTS
 //
 // Written by Jonathan H. Connell, jconnell@alum.mit.edu
 //
@@ -25,21 +25,26 @@
 #include <stdlib.h>            // needed for NULL
 
 
-// function declarations (possibly combined with other header files)
-
-#ifndef DEXP
-  #ifdef SPIOWIN_EXPORTS
-    #define DEXP __declspec(dllexport)
-  #else
-    #define DEXP __declspec(dllimport)
+#ifdef __linux__
+  #ifndef DEXP
+    #define DEXP             // nothing special needed for Linux shared lib
+  #endif
+#else
+
+  // function declarations (possibly combined with other header files)
+  #ifndef DEXP
+    #ifdef SPIOWIN_EXPORTS
+      #define DEXP __declspec(dllexport)
+    #else
+      #define DEXP __declspec(dllimport)
+    #endif
   #endif
-#endif
-
 
-// link to library stub
+  // link to library stub
+  #ifndef SPIOWIN_EXPORTS
+    #pragma comment(lib, "spio_win.lib")
+  #endif
 
-#ifndef SPIOWIN_EXPORTS
-  #pragma comment(lib, "spio_win.lib")
 #endif
 
 
@@ -49,7 +54,8 @@
 
 //= Start recognizing speech and enable TTS output.
 // path is home dir for files, prog > 0 prints partial recognitions
-// reads required key and area from file:    config/spio_win.key
+// reads required backend spec from file:    config/spio_win.key
+//   Azure = "<key> <region>", local = "local <model file>" (always local for Linux)
 // optionally reads special names from file: config/all_names.txt
 // returns 1 if successful, 0 if cannot connect, neg for bad credentials
 // NOTE: meant to be called only once at beginning of program
@@ -64,26 +70,58 @@ extern "C" DEXP int reco_name (const char *name);
 
 
 //= Turn microphone on and off (e.g. to prevent TTS transcription).
+// optional for cached phrases since their echo is removed from microphone
 
 extern "C" DEXP void reco_mute (int doit);
 
 
+//= Set silence (ms) needed to end the next utterance, 0 for default.
+// e.g. short after a yes/no question, long utterances stretch automatically
+
+extern "C" DEXP void reco_endpoint (int ms);
+
+
+//= Only run full recognition after robot is addressed by some part of its name.
+// stays awake for a while after each utterance, or while reco_attn is set
+// call after spio_start, NULL name turns gating off
+// returns 1 if gating active, 0 if engine cannot spot name (always listening)
+
+extern "C" DEXP int reco_wake (const char *rname);
+
+
+//= Keep full recognition running regardless of wake word (e.g. while attending).
+
+extern "C" DEXP void reco_attn (int doit);
+
+
 //= Check to see if any utterances are ready for harvesting.
 // return: 2 new result, 1 speaking, 0 silence, -1 unintelligible, -2 lost connection 
 
 extern "C" DEXP int reco_status ();
 
 
-//= Gives text string of last full recognition result (changes status).
+//= Gives text string of oldest unread recognition result (changes status).
 
 extern "C" DEXP const char *reco_heard ();
 
 
-//= Gives approximate time (ms) that utterance started before notification.
+//= Gives time (ms) since speech onset when result was harvested.
 
 extern "C" DEXP int reco_delay ();
 
 
+//= Gives latest partial hypothesis while user is still speaking (empty if none).
+// can also get stability (0-1) based on how long text has remained unchanged
+// sets reco_delay to time since speech onset, text is only valid until next call
+
+extern "C" DEXP const char *reco_partial (float *stab =NULL);
+
+
+//= Gives recognizer confidence (0-1) in most recent full result.
+
+extern "C" DEXP float reco_conf ();
+
+
 //= Start speaking some message, overriding any current one (never blocks).
 // returns 1 if successful, 0 or negative for some error
 
@@ -96,6 +134,14 @@ extern "C" DEXP int tts_say (const char *msg =NULL);
 extern "C" DEXP int tts_status ();
 
 
+//= Get mouth shape timeline for current utterance so caller can schedule it locally.
+// ms gets start time of each viseme, vis gets SAPI viseme numbers (0 = silence)
+// len is total length and ago is time since playback started (both ms)
+// returns number of visemes, 0 if not talking, -1 if unknown (poll tts_status instead)
+
+extern "C" DEXP int tts_timeline (int *ms, int *vis, int vmax, int *len, int *ago);
+
+
 //= Stop talking and recognizing speech (automatically called at exit).
 
 extern "C" DEXP void spio_done ();
@@ -70,9 +70,12 @@ extern "C" DEXP int ocv_info (int& iw, int& ih, double& fps);
 //   r4f = r^4 lens radial distortion x 10^12 (pixel coords)
 //   asp = width/length of individual pixel (if not square)
 //   mag = overall magnification after correction
+//   dx, dy = lens center offset from middle of raw image (pixels)
+// lens center always ends up in middle of corrected image
 // NOTE: needs to know image size before building transform
  
-extern "C" DEXP void ocv_warp (double r2f, double r4f =0.0, double mag =1.0, double asp =1.0);
+extern "C" DEXP void ocv_warp (double r2f, double r4f =0.0, double mag =1.0, double asp =1.0, 
+                               double dx =0.0, double dy =0.0);
 
 
 //= Get next frame into supplied buffer (assumed to be big enough).
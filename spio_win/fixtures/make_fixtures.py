@@ -0,0 +1,93 @@
+# make_fixtures.py : writes speech-shaped WAV clips for spio_bench
+#
+# Written by Jonathan H. Connell, jconnell@alum.mit.edu
+#
+###########################################################################
+#
+# Copyright 2024 Etaoin Systems
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+###########################################################################
+
+# These are not real recordings: each syllable is a pitched buzz shaped by
+# two vowel formants with a smooth loudness envelope, with short gaps
+# between syllables and longer ones between words. This is enough for the
+# VAD and endpoint timing, while the matching .txt file supplies the text
+# the stand-in recognizer reports. Replace them with recorded speech (same
+# names) to time a real decoder.
+
+import math, random, struct, wave
+
+RATE = 16000
+
+# vowel formants (Hz) cycled through syllables
+VOWELS = [(730, 1090), (270, 2290), (530, 1840), (300, 870), (640, 1190)]
+
+# name, transcript, syllables per word
+CLIPS = [("waldo_come_here", "Waldo, come here.",        [2, 1, 1]),
+         ("pick_up_block",   "Pick up the red block.",   [1, 1, 1, 1, 1]),
+         ("what_do_you_see", "What do you see?",         [1, 1, 1, 1]),
+         ("stop",            "Stop.",                    [1]),
+         ("turn_left_waldo", "Turn left a little, Waldo.", [1, 1, 1, 2, 2])]
+
+
+def syllable (n, f0, vowel, rnd):
+  """Samples of one voiced syllable with falling pitch."""
+  out, ph = [], 0.0
+  for i in range(n):
+    t = i / n
+    env = math.sin(math.pi * t) ** 0.6
+    f = f0 * (1.05 - 0.15 * t)
+    ph += 2.0 * math.pi * f / RATE
+    v = 0.0
+    for h in range(1, 30):
+      fh = h * f
+      if fh > 0.45 * RATE:
+        break
+      gain = sum(1.0 / (1.0 + ((fh - fm) / 90.0) ** 2) for fm in vowel) + 0.05
+      v += gain * math.sin(h * ph) / h
+    out.append(env * v + 0.02 * rnd.uniform(-1.0, 1.0))
+  return out
+
+
+def make (name, text, words, seed):
+  rnd = random.Random(seed)
+  quiet = lambda ms: [0.0] * int(RATE * ms / 1000)
+  snd, k = quiet(300), 0
+  for w, cnt in enumerate(words):
+    for s in range(cnt):
+      snd += syllable(int(RATE * rnd.uniform(0.16, 0.26)), rnd.uniform(110, 140),
+                      VOWELS[k % len(VOWELS)], rnd)
+      k += 1
+      if s < cnt - 1:
+        snd += quiet(30)
+    if w < len(words) - 1:
+      snd += quiet(rnd.uniform(60, 110))
+  snd += quiet(400)
+
+  # normalize to about -6 dB peak with a faint noise floor everywhere
+  top = max(abs(v) for v in snd)
+  pcm = [int(16000 * v / top + rnd.gauss(0.0, 20.0)) for v in snd]
+  with wave.open(name + ".wav", "wb") as f:
+    f.setnchannels(1)
+    f.setsampwidth(2)
+    f.setframerate(RATE)
+    f.writeframes(b"".join(struct.pack("<h", max(-32768, min(32767, v))) for v in pcm))
+  with open(name + ".txt", "w") as f:
+    f.write(text + "\n")
+
+
+if __name__ == "__main__":
+  for i, (name, text, words) in enumerate(CLIPS):
+    make(name, text, words, i + 1)
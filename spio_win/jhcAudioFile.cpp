@@ -0,0 +1,369 @@
+// jhcAudioFile.cpp : plays WAV files into recognizer as if from microphone
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+
+#include "jhcAudioFile.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcAudioFile::~jhcAudioFile ()
+{
+  int i;
+
+  for (i = 0; i < nc; i++)
+    delete [] clip[i];
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcAudioFile::jhcAudioFile ()
+{
+  nc = 0;
+  play = 0;
+  pos = 0;
+  fed = 0;
+  t0 = 0;
+  nend = 0;
+  gap = 1500;                // longer than any endpoint silence
+  reps = 1;
+  edge = -30.0;              // ignores reverb tail
+}
+
+
+//= Add a WAV file to end of playlist.
+// returns 1 if successful, 0 if playlist full, negative for bad file
+
+int jhcAudioFile::Add (const char *fname)
+{
+  short *snd = NULL;
+  int n, rate;
+
+  if (nc >= cmax)
+    return 0;
+  if ((n = load_wav(&snd, rate, fname)) <= 0)
+    return n - 1;
+  clip[nc] = snd;
+  crate[nc] = rate;
+  clen[nc] = n;
+  cend[nc] = speech_end(snd, n, rate);
+  get_label(label[nc], 200, fname);
+  nc++;
+  return 1;
+}
+
+
+//= Start playlist over at given sample rate.
+// returns 1 if successful, 0 if no clips
+
+int jhcAudioFile::Open (int rate)
+{
+  Close();
+  sps = rate;
+  play = 0;
+  pos = 0;
+  fed = 0;
+  t0 = 0;
+  nend = 0;
+  return((nc > 0) ? 1 : 0);
+}
+
+
+//= Nothing to release since clips are kept for reuse.
+
+void jhcAudioFile::Close ()
+{
+}
+
+
+//= Read a 16 bit PCM WAV file and mix all channels down to mono.
+// allocates sample array which caller must delete
+// returns number of samples, 0 if empty, -1 if missing, -2 if unsupported
+
+int jhcAudioFile::load_wav (short **snd, int& rate, const char *fname) const
+{
+  unsigned char hdr[8], fmt[16];
+  unsigned char *raw;
+  FILE *in;
+  long sz;
+  int i, j, sum, chan = 0, bits = 0, n = 0;
+
+  // check RIFF header
+  if ((fname == NULL) || ((in = fopen(fname, "rb")) == NULL))
+    return -1;
+  if ((fread(hdr, 1, 8, in) != 8) || (strncmp((char *) hdr, "RIFF", 4) != 0) ||
+      (fread(hdr, 1, 4, in) != 4) || (strncmp((char *) hdr, "WAVE", 4) != 0))
+  {
+    fclose(in);
+    return -2;
+  }
+
+  // scan chunks for format and data (sizes are little-endian)
+  rate = 0;
+  while (fread(hdr, 1, 8, in) == 8)
+  {
+    sz = hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) | ((long) hdr[7] << 24);
+    if ((strncmp((char *) hdr, "fmt ", 4) == 0) && (sz >= 16))
+    {
+      if (fread(fmt, 1, 16, in) != 16)
+        break;
+      chan = fmt[2] | (fmt[3] << 8);
+      rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+      bits = fmt[14] | (fmt[15] << 8);
+      fseek(in, sz - 16 + (sz & 1), SEEK_CUR);
+    }
+    else if ((strncmp((char *) hdr, "data", 4) == 0) && (chan > 0))
+    {
+      if ((bits != 16) || (rate <= 0))
+        break;
+      n = (int)(sz / (2 * chan));
+      raw = new unsigned char [2 * chan * n];
+      n = (int) fread(raw, 2 * chan, n, in);
+      *snd = new short [(n > 0) ? n : 1];
+      for (i = 0; i < n; i++)
+      {
+        sum = 0;
+        for (j = 0; j < chan; j++)
+          sum += (short)(raw[2 * (chan * i + j)] | (raw[2 * (chan * i + j) + 1] << 8));
+        (*snd)[i] = (short)(sum / chan);
+      }
+      delete [] raw;
+      fclose(in);
+      if (n <= 0)
+      {
+        delete [] *snd;
+        *snd = NULL;
+      }
+      return n;
+    }
+    else
+      fseek(in, sz + (sz & 1), SEEK_CUR);
+  }
+  fclose(in);
+  return -2;
+}
+
+
+//= Find sample just after last 10 ms frame within "edge" dB of loudest frame.
+
+int jhcAudioFile::speech_end (const short *snd, int n, int rate) const
+{
+  double e, th, top = 0.0;
+  int i, f, fsz = rate / 100, nf = n / fsz, last = 0;
+
+  if (nf <= 0)
+    return n;
+
+  // get loudest frame energy
+  for (f = 0; f < nf; f++)
+  {
+    e = 0.0;
+    for (i = f * fsz; i < (f + 1) * fsz; i++)
+      e += (double) snd[i] * snd[i];
+    top = ((e > top) ? e : top);
+  }
+
+  // find last frame still near that level
+  th = top * pow(10.0, edge / 10.0);
+  for (f = 0; f < nf; f++)
+  {
+    e = 0.0;
+    for (i = f * fsz; i < (f + 1) * fsz; i++)
+      e += (double) snd[i] * snd[i];
+    if (e >= th)
+      last = f + 1;
+  }
+  return last * fsz;
+}
+
+
+//= Get transcript from text file with same base name, else use base name itself.
+
+void jhcAudioFile::get_label (char *txt, int ssz, const char *fname) const
+{
+  char tfn[500];
+  const char *base = fname, *s;
+  char *dot;
+  FILE *in;
+  int n;
+
+  // try reading first line of matching text file
+  strncpy(tfn, fname, 495);
+  tfn[495] = '\0';
+  if ((dot = strrchr(tfn, '.')) != NULL)
+    *dot = '\0';
+  strcat(tfn, ".txt");
+  if ((in = fopen(tfn, "r")) != NULL)
+  {
+    if (fgets(txt, ssz, in) != NULL)
+    {
+      fclose(in);
+      n = (int) strlen(txt);
+      while ((n > 0) && ((txt[n - 1] == '\n') || (txt[n - 1] == '\r')))
+        txt[--n] = '\0';
+      if (n > 0)
+        return;
+    }
+    else
+      fclose(in);
+  }
+
+  // fall back to file name without directory or extension
+  for (s = fname; *s != '\0'; s++)
+    if ((*s == '/') || (*s == '\\'))
+      base = s + 1;
+  strncpy(txt, base, ssz - 1);
+  txt[ssz - 1] = '\0';
+  if ((dot = strrchr(txt, '.')) != NULL)
+    *dot = '\0';
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get exactly n samples, waiting until they would have been captured.
+// gap of silence comes before each clip, end of speech times noted as passed
+// returns n always (silence once playlist is finished)
+
+int jhcAudioFile::Read (short *buf, int n)
+{
+  unsigned long due;
+  int i, len, quiet = (gap * sps) / 1000, ended = nend, total = Plays();
+
+  // clock starts with first request
+  if (t0 == 0)
+    t0 = Now();
+
+  // fill buffer from playlist
+  for (i = 0; i < n; i++, fed++)
+  {
+    buf[i] = 0;
+    if (play >= total)
+      continue;
+    len = out_len(play % nc);
+    if (pos >= quiet)
+      buf[i] = sample(play % nc, pos - quiet);
+    pos++;
+
+    // note when end of speech passes then go on to next play
+    if ((ended <= play) && (pos >= quiet + (int)(((long long) cend[play % nc] * sps) / crate[play % nc])))
+    {
+      if (play < emax)
+        tend[play] = t0 + (unsigned long)((1000 * (fed + 1)) / sps);
+      ended = play + 1;
+    }
+    if (pos >= quiet + len)
+    {
+      play++;
+      pos = 0;
+    }
+  }
+  if (mute > 0)
+    memset(buf, 0, n * sizeof(short));
+
+  // wait until last sample would have arrived from microphone
+  due = t0 + (unsigned long)((1000 * fed) / sps);
+  while ((long)(due - Now()) > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  nend = ended;
+  return n;
+}
+
+
+//= Length of a clip in samples at the output rate.
+
+int jhcAudioFile::out_len (int c) const
+{
+  return (int)(((long long) clen[c] * sps) / crate[c]);
+}
+
+
+//= Get a sample of a clip at the output rate using linear interpolation.
+
+short jhcAudioFile::sample (int c, int i) const
+{
+  long long num = (long long) i * crate[c];
+  int k = (int)(num / sps), f = (int)(num % sps);
+
+  if (k >= (clen[c] - 1))
+    return clip[c][clen[c] - 1];
+  return (short)(clip[c][k] + ((long long)(clip[c][k + 1] - clip[c][k]) * f) / sps);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                         Playback Information                          //
+///////////////////////////////////////////////////////////////////////////
+
+//= Transcript of clip used for some play (or empty string if none).
+
+const char *jhcAudioFile::Label (int p) const
+{
+  if ((nc <= 0) || (p < 0))
+    return "";
+  return label[p % nc];
+}
+
+
+//= Wall time (ms) when speech ended in some play, 0 if not yet (or not recorded).
+
+unsigned long jhcAudioFile::SpeechEnd (int p) const
+{
+  if ((p < 0) || (p >= nend) || (p >= emax))
+    return 0;
+  return tend[p];
+}
+
+
+//= Time (ms) from start of clip to end of its speech for some play.
+
+int jhcAudioFile::SpeechMs (int p) const
+{
+  int c = Clip(p);
+
+  if (c < 0)
+    return 0;
+  return (int)((1000LL * cend[c]) / crate[c]);
+}
+
+
+//= Monotonic time in milliseconds (same clock as recognizers).
+
+unsigned long jhcAudioFile::Now ()
+{
+  return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,106 @@
+// jhcAudioFile.h : plays WAV files into recognizer as if from microphone
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+#include "jhcAudioIn.h"
+
+
+//= Plays WAV files into recognizer as if from microphone.
+// playlist of 16 bit PCM clips (any rate, mixed to mono) separated by silence
+// samples are released in real time so endpointing behaves as with live audio
+// end of speech in each clip is found from its loudness envelope and the
+// wall time when that sample would have been captured is recorded
+// transcript for "foo.wav" is taken from "foo.txt" if present (else file name)
+// keeps giving silence after last clip so final utterance can end
+
+class jhcAudioFile : public jhcAudioIn
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int cmax = 100;         // most different clips
+  static const int emax = 1000;        // most clip plays recorded
+
+  // clip samples, rate, length, and end of speech (in clip samples)
+  short *clip[cmax];
+  int crate[cmax], clen[cmax], cend[cmax];
+  char label[cmax][200];
+  int nc;
+
+  // playback state: play count, sample within play, samples released
+  int play, pos;
+  long long fed;
+  unsigned long t0;
+
+  // wall time (ms) each play's speech ended, number of plays ended
+  unsigned long tend[emax];
+  std::atomic<int> nend;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // silence before each clip (ms) and times through playlist
+  int gap, reps;
+
+  // level below loudest frame counted as end of speech (dB)
+  double edge;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcAudioFile ();
+  jhcAudioFile ();
+  int Add (const char *fname);
+  int Clips () const {return nc;}
+  int Open (int rate =16000);
+  void Close ();
+
+  // main functions
+  int Read (short *buf, int n);
+
+  // playback information
+  int Plays () const {return(nc * reps);}
+  int Ended () const {return nend;}
+  int Done () const {return((nend >= Plays()) ? 1 : 0);}
+  int Playing () const {return play;}
+  int Clip (int p) const {return((nc > 0) ? p % nc : -1);}
+  const char *Label (int p) const;
+  unsigned long SpeechEnd (int p) const;
+  int SpeechMs (int p) const;
+  static unsigned long Now ();
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // creation and initialization
+  int load_wav (short **snd, int& rate, const char *fname) const;
+  int speech_end (const short *snd, int n, int rate) const;
+  void get_label (char *txt, int ssz, const char *fname) const;
+
+  // main functions
+  int out_len (int c) const;
+  short sample (int c, int i) const;
+
+};
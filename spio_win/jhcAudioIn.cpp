@@ -0,0 +1,276 @@
+// jhcAudioIn.cpp : blocking 16 bit mono audio capture from default microphone
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <alsa/asoundlib.h>
+#else
+  #include <windows.h>
+  #include <mmsystem.h>
+  #pragma comment(lib, "winmm.lib")
+#endif
+
+#include "jhcAudioOut.h"
+
+#include "jhcAudioIn.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcAudioIn::~jhcAudioIn ()
+{
+  jhcAudioIn::Close();
+  delete [] rbuf;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcAudioIn::jhcAudioIn ()
+{
+  dev = NULL;
+  hdr = NULL;
+  ring = NULL;
+  blen = 0;
+  next = 0;
+  sps = 16000;
+  mute = 0;
+  spk = NULL;
+  rbuf = NULL;
+  rmax = 0;
+  rsnd = 0;
+  rpos = 0;
+  lag = 0;                   // capture buffering covered by filter length
+}
+
+
+//= Connect to default capture device at given sample rate.
+// returns 1 if successful, 0 for failure
+
+int jhcAudioIn::Open (int rate)
+{
+  Close();
+  sps = rate;
+  aec.Reset(sps);
+  rsnd = 0;
+
+#ifdef __linux__
+  snd_pcm_t *pcm;
+
+  // 100ms of device buffering
+  if (snd_pcm_open(&pcm, "default", SND_PCM_STREAM_CAPTURE, 0) < 0)
+    return 0;
+  if (snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 1, sps, 1, 100000) < 0)
+  {
+    snd_pcm_close(pcm);
+    return 0;
+  }
+  dev = (void *) pcm;
+#else
+  WAVEFORMATEX fmt;
+  WAVEHDR *h;
+  HWAVEIN win;
+  int i;
+
+  // 16 bit mono PCM
+  memset(&fmt, 0, sizeof(WAVEFORMATEX));
+  fmt.wFormatTag = WAVE_FORMAT_PCM;
+  fmt.nChannels = 1;
+  fmt.nSamplesPerSec = sps;
+  fmt.wBitsPerSample = 16;
+  fmt.nBlockAlign = 2;
+  fmt.nAvgBytesPerSec = 2 * sps;
+  if (waveInOpen(&win, WAVE_MAPPER, &fmt, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+    return 0;
+
+  // queue up ring of 20ms buffers then start
+  blen = sps / 50;
+  ring = new short [nbuf * blen];
+  h = new WAVEHDR [nbuf];
+  memset(h, 0, nbuf * sizeof(WAVEHDR));
+  for (i = 0; i < nbuf; i++)
+  {
+    h[i].lpData = (LPSTR)(ring + i * blen);
+    h[i].dwBufferLength = 2 * blen;
+    waveInPrepareHeader(win, h + i, sizeof(WAVEHDR));
+    waveInAddBuffer(win, h + i, sizeof(WAVEHDR));
+  }
+  waveInStart(win);
+  dev = (void *) win;
+  hdr = (void *) h;
+  next = 0;
+#endif
+
+  return 1;
+}
+
+
+//= Disconnect from capture device (if any).
+
+void jhcAudioIn::Close ()
+{
+  if (dev == NULL)
+    return;
+
+#ifdef __linux__
+  snd_pcm_close((snd_pcm_t *) dev);
+#else
+  HWAVEIN win = (HWAVEIN) dev;
+  WAVEHDR *h = (WAVEHDR *) hdr;
+  int i;
+
+  waveInReset(win);
+  for (i = 0; i < nbuf; i++)
+    waveInUnprepareHeader(win, h + i, sizeof(WAVEHDR));
+  waveInClose(win);
+  delete [] h;
+  delete [] ring;
+#endif
+
+  dev = NULL;
+  hdr = NULL;
+  ring = NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get exactly n samples, waiting if needed.
+// returns n if successful, 0 or negative for device problem
+
+int jhcAudioIn::Read (short *buf, int n)
+{
+  int got;
+
+  if ((got = read_dev(buf, n)) <= 0)
+    return got;
+  cancel(buf, got);
+  if (mute > 0)
+    memset(buf, 0, n * sizeof(short));
+  return got;
+}
+
+
+//= Remove echo of whatever speaker is playing from new samples.
+// reference is aligned once at start of each sound then advanced by sample
+// count so capture timing jitter does not disturb the adaptive filter
+
+void jhcAudioIn::cancel (short *buf, int n)
+{
+  int snd;
+
+  // see if anything playing
+  if (spk == NULL)
+    return;
+  if ((snd = spk->Sound()) <= 0)
+  {
+    aec.Process(buf, NULL, n);
+    rsnd = 0;
+    return;
+  }
+
+  // make sure reference buffer is big enough
+  if (n > rmax)
+  {
+    delete [] rbuf;
+    rmax = n;
+    rbuf = new short [rmax];
+  }
+
+  // these samples end at current playback position (less capture delay)
+  if (snd != rsnd)
+  {
+    rpos = ((long long)(spk->Position() - lag) * sps) / 1000 - n;
+    rsnd = snd;
+  }
+  if (spk->Echo(rbuf, snd, rpos, n, sps) <= 0)
+  {
+    aec.Process(buf, NULL, n);
+    rsnd = 0;
+    return;
+  }
+  aec.Process(buf, rbuf, n);
+  rpos += n;
+}
+
+
+//= Get samples from actual device.
+
+int jhcAudioIn::read_dev (short *buf, int n)
+{
+  if (dev == NULL)
+    return -1;
+
+#ifdef __linux__
+  snd_pcm_t *pcm = (snd_pcm_t *) dev;
+  int rc, got = 0;
+
+  while (got < n)
+  {
+    if ((rc = (int) snd_pcm_readi(pcm, buf + got, n - got)) < 0)
+      if ((rc = snd_pcm_recover(pcm, rc, 1)) < 0)
+        return rc;
+    if (rc > 0)
+      got += rc;
+  }
+  return n;
+#else
+  HWAVEIN win = (HWAVEIN) dev;
+  WAVEHDR *h = (WAVEHDR *) hdr;
+  int got = 0, used = 0, cnt;
+
+  while (got < n)
+  {
+    // wait for oldest buffer to fill
+    while ((h[next].dwFlags & WHDR_DONE) == 0)
+      Sleep(1);
+
+    // copy out as much as needed (remember partial use)
+    cnt = __min(n - got, (int)(h[next].dwBytesRecorded / 2) - used);
+    memcpy(buf + got, (short *)(h[next].lpData) + used, cnt * sizeof(short));
+    got += cnt;
+    used += cnt;
+    if (used < (int)(h[next].dwBytesRecorded / 2))
+    {
+      // shift leftover samples to front of buffer for next call
+      memmove(h[next].lpData, (short *)(h[next].lpData) + used, h[next].dwBytesRecorded - 2 * used);
+      h[next].dwBytesRecorded -= 2 * used;
+      break;
+    }
+
+    // recycle buffer
+    used = 0;
+    h[next].dwFlags &= ~WHDR_DONE;
+    waveInAddBuffer(win, h + next, sizeof(WAVEHDR));
+    next = (next + 1) % nbuf;
+  }
+  return got;
+#endif
+}
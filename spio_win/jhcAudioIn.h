@@ -0,0 +1,90 @@
+// jhcAudioIn.h : blocking 16 bit mono audio capture from default microphone
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "jhcEchoCancel.h"
+
+
+// avoid pulling playback into every file
+
+class jhcAudioOut;
+
+
+//= Blocking 16 bit mono audio capture from default microphone.
+// uses ALSA under Linux and waveIn (several small buffers) under Windows
+// muting just replaces samples with silence so stream timing is kept
+// can remove echo of robot speech given speaker as reference (allows barge-in)
+// derived classes can substitute other sources (e.g. files)
+
+class jhcAudioIn
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int nbuf = 8;           // Windows capture buffers
+
+  // device handle and Windows buffer ring
+  void *dev, *hdr;
+  short *ring;
+  int blen, next;
+
+  // echo reference source, copy of its samples, and sound being tracked
+  const jhcAudioOut *spk;
+  short *rbuf;
+  int rmax, rsnd;
+  long long rpos;
+
+
+// PROTECTED MEMBER VARIABLES
+protected:
+  // sample rate and whether replacing input with silence
+  int sps, mute;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // echo remover and capture delay relative to speaker (ms)
+  jhcEchoCancel aec;
+  int lag;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  virtual ~jhcAudioIn ();
+  jhcAudioIn ();
+  virtual int Open (int rate =16000);
+  virtual void Close ();
+  int Rate () const {return sps;}
+  void Mute (int doit) {mute = ((doit > 0) ? 1 : 0);}
+  void Echo (const jhcAudioOut *ref) {spk = ref;}
+
+  // main functions
+  virtual int Read (short *buf, int n);
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  int read_dev (short *buf, int n);
+  void cancel (short *buf, int n);
+
+};
@@ -0,0 +1,297 @@
+// jhcAudioOut.cpp : plays 16 bit mono audio from memory
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef __linux__
+  #include <alsa/asoundlib.h>
+#else
+  #include <windows.h>
+  #include <mmsystem.h>
+  #pragma comment(lib, "winmm.lib")
+#endif
+
+#include "jhcAudioOut.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcAudioOut::~jhcAudioOut ()
+{
+  jhcAudioOut::Close();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcAudioOut::jhcAudioOut ()
+{
+  dev = NULL;
+  hdr = NULL;
+  src = NULL;
+  n = 0;
+  t0 = 0;
+  serial = 0;
+  run = 0;
+  sps = 16000;
+}
+
+
+//= Connect to default playback device at given sample rate.
+// returns 1 if successful, 0 for failure
+
+int jhcAudioOut::Open (int rate)
+{
+  Close();
+  sps = rate;
+
+#ifdef __linux__
+  snd_pcm_t *pcm;
+
+  // 60ms of device buffering
+  if (snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0)
+    return 0;
+  if (snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 1, sps, 1, 60000) < 0)
+  {
+    snd_pcm_close(pcm);
+    return 0;
+  }
+  dev = (void *) pcm;
+#else
+  WAVEFORMATEX fmt;
+  HWAVEOUT wout;
+
+  // 16 bit mono PCM
+  memset(&fmt, 0, sizeof(WAVEFORMATEX));
+  fmt.wFormatTag = WAVE_FORMAT_PCM;
+  fmt.nChannels = 1;
+  fmt.nSamplesPerSec = sps;
+  fmt.wBitsPerSample = 16;
+  fmt.nBlockAlign = 2;
+  fmt.nAvgBytesPerSec = 2 * sps;
+  if (waveOutOpen(&wout, WAVE_MAPPER, &fmt, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+    return 0;
+  dev = (void *) wout;
+  hdr = (void *) new WAVEHDR;
+  memset(hdr, 0, sizeof(WAVEHDR));
+#endif
+
+  return 1;
+}
+
+
+//= Disconnect from playback device (if any).
+
+void jhcAudioOut::Close ()
+{
+  if (dev == NULL)
+    return;
+  Stop();
+
+#ifdef __linux__
+  snd_pcm_close((snd_pcm_t *) dev);
+#else
+  waveOutClose((HWAVEOUT) dev);
+  delete (WAVEHDR *) hdr;
+#endif
+
+  dev = NULL;
+  hdr = NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Start playing some samples, cutting off anything currently playing.
+// returns 1 if started, 0 or negative for problem
+
+int jhcAudioOut::Play (const short *snd, int cnt)
+{
+  Stop();
+  if (dev == NULL)
+    return -1;
+  if ((snd == NULL) || (cnt <= 0))
+    return 0;
+  {
+    std::lock_guard<std::mutex> hold(slock);
+    src = snd;
+    n = cnt;
+    t0 = now_ms();
+    serial++;
+  }
+
+#ifdef __linux__
+  run = 1;
+  pthread_create(&bg, NULL, feed_loop, this);
+#else
+  HWAVEOUT wout = (HWAVEOUT) dev;
+  WAVEHDR *h = (WAVEHDR *) hdr;
+
+  // hand whole sound to driver in one buffer
+  memset(h, 0, sizeof(WAVEHDR));
+  h->lpData = (LPSTR) snd;
+  h->dwBufferLength = cnt * sizeof(short);
+  waveOutPrepareHeader(wout, h, sizeof(WAVEHDR));
+  if (waveOutWrite(wout, h, sizeof(WAVEHDR)) != MMSYSERR_NOERROR)
+  {
+    waveOutUnprepareHeader(wout, h, sizeof(WAVEHDR));
+    std::lock_guard<std::mutex> hold(slock);
+    src = NULL;
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+
+
+//= Cut off any sound in progress.
+
+void jhcAudioOut::Stop ()
+{
+  if ((dev == NULL) || (src == NULL))
+    return;
+
+#ifdef __linux__
+  run = 0;
+  pthread_join(bg, NULL);
+  snd_pcm_drop((snd_pcm_t *) dev);
+  snd_pcm_prepare((snd_pcm_t *) dev);
+#else
+  HWAVEOUT wout = (HWAVEOUT) dev;
+
+  waveOutReset(wout);
+  waveOutUnprepareHeader(wout, (WAVEHDR *) hdr, sizeof(WAVEHDR));
+#endif
+
+  std::lock_guard<std::mutex> hold(slock);
+  src = NULL;
+  n = 0;
+}
+
+
+//= How far into current sound playback has progressed (ms).
+
+int jhcAudioOut::Position () const
+{
+  if (src == NULL)
+    return 0;
+
+#ifndef __linux__
+  MMTIME pos;
+
+  // ask driver for samples actually played
+  pos.wType = TIME_SAMPLES;
+  if (waveOutGetPosition((HWAVEOUT) dev, &pos, sizeof(MMTIME)) == MMSYSERR_NOERROR)
+    if (pos.wType == TIME_SAMPLES)
+      return (int)((1000LL * pos.u.sample) / sps);
+#endif
+
+  return (int)(now_ms() - t0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Echo Reference                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Copy part of some sound at a different sample rate (e.g. microphone's).
+// snd is the sound number from Sound(), start is an offset at the new rate
+// samples before start or after end of sound are zero
+// returns 1 if sound still current, 0 if different sound or stopped (all zero)
+
+int jhcAudioOut::Echo (short *dst, int snd, long long start, int cnt, int rate) const
+{
+  std::lock_guard<std::mutex> hold(slock);
+  long long step, pos;
+  int i, k, f;
+
+  // make sure requested sound is still around
+  memset(dst, 0, cnt * sizeof(short));
+  if ((src == NULL) || (snd != serial) || (rate <= 0))
+    return 0;
+
+  // linear interpolation with 16 bit fixed point position
+  step = ((long long) sps << 16) / rate;
+  pos = start * step;
+  for (i = 0; i < cnt; i++, pos += step)
+  {
+    if (pos < 0)
+      continue;
+    if ((k = (int)(pos >> 16)) >= (n - 1))
+      break;
+    f = (int)(pos & 0xFFFF);
+    dst[i] = (short)(((long long) src[k] * (0x10000 - f) + (long long) src[k + 1] * f) >> 16);
+  }
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                           Helper Functions                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Monotonic time in milliseconds (arbitrary zero).
+
+unsigned long jhcAudioOut::now_ms ()
+{
+  return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//= Thread function for pushing samples to device.
+
+pthread_ret jhcAudioOut::feed_loop (void *out)
+{
+  ((jhcAudioOut *) out)->run_feed();
+  return 0;
+}
+
+
+//= Write samples to device in 20ms pieces so stopping is quick.
+
+void jhcAudioOut::run_feed ()
+{
+#ifdef __linux__
+  snd_pcm_t *pcm = (snd_pcm_t *) dev;
+  int rc, chunk = sps / 50, sent = 0, cnt;
+
+  while ((run > 0) && (sent < n))
+  {
+    cnt = (((n - sent) < chunk) ? n - sent : chunk);
+    if ((rc = (int) snd_pcm_writei(pcm, src + sent, cnt)) < 0)
+      if ((rc = snd_pcm_recover(pcm, rc, 1)) < 0)
+        break;
+    if (rc > 0)
+      sent += rc;
+  }
+#endif
+}
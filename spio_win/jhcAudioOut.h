@@ -0,0 +1,89 @@
+// jhcAudioOut.h : plays 16 bit mono audio from memory
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "jhc_pthread.h"
+
+
+//= Plays 16 bit mono audio from memory on default speaker.
+// uses ALSA (on a feeder thread) under Linux and a single waveOut buffer under Windows
+// samples are not copied so caller must keep them valid until done or stopped
+// other threads can get a copy of what is playing (e.g. as echo reference)
+
+class jhcAudioOut
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // device handle and Windows buffer header
+  void *dev, *hdr;
+
+  // current sound, start time (ms), and sound count
+  const short *src;
+  int n;
+  unsigned long t0;
+  std::atomic<int> serial;
+
+  // guards sound pointer for other threads
+  mutable std::mutex slock;
+
+  // Linux feeder thread
+  pthread_t bg;
+  std::atomic<int> run;
+
+
+// PROTECTED MEMBER VARIABLES
+protected:
+  // sample rate
+  int sps;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  virtual ~jhcAudioOut ();
+  jhcAudioOut ();
+  virtual int Open (int rate =16000);
+  virtual void Close ();
+  int Rate () const {return sps;}
+
+  // main functions
+  virtual int Play (const short *snd, int cnt);
+  virtual void Stop ();
+  virtual int Position () const;
+  int Busy () const {return(((src != NULL) && (Position() < (int)((1000LL * n) / sps))) ? 1 : 0);}
+
+  // echo reference
+  int Sound () const {return((src != NULL) ? serial.load() : 0);}
+  int Echo (short *dst, int snd, long long start, int cnt, int rate) const;
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  static unsigned long now_ms ();
+  static pthread_ret feed_loop (void *out);
+  void run_feed ();
+
+};
@@ -0,0 +1,181 @@
+// jhcEchoCancel.cpp : removes robot speech from microphone signal using NLMS
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+
+#include "jhcEchoCancel.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcEchoCancel::~jhcEchoCancel ()
+{
+  delete [] hist;
+  delete [] w;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcEchoCancel::jhcEchoCancel ()
+{
+  // filter
+  w = NULL;
+  hist = NULL;
+  taps = 0;
+
+  // parameters
+  mu   = 0.2;                // moderate, tolerates missed double-talk
+  dtd  = 2.0;                // speaker may be louder than reference
+  supp = 0.3;                // about -10 dB on leftover echo
+  hang = 30;                 // bridge gaps between syllables
+
+  // state
+  Reset(16000);
+}
+
+
+//= Set up for given sample rate and longest echo delay (ms).
+// forgets any echo path learned so far
+
+void jhcEchoCancel::Reset (int rate, int ms)
+{
+  int n = (rate * ms) / 1000;
+
+  // possibly resize filter
+  if (n != taps)
+  {
+    delete [] hist;
+    delete [] w;
+    taps = n;
+    w = new float [taps];
+    hist = new float [2 * taps];
+  }
+  memset(w, 0, taps * sizeof(float));
+  clr_hist();
+
+  // peak decays by half over filter length, hold time in samples
+  decay = (float) pow(0.5, 1.0 / taps);
+  hold = (rate * hang) / 1000;
+  dt = 0;
+  pd = 0.0f;
+  pe = 0.0f;
+}
+
+
+//= Clear reference history when robot is not talking.
+
+void jhcEchoCancel::clr_hist ()
+{
+  memset(hist, 0, 2 * taps * sizeof(float));
+  pos = 0;
+  pwr = 0.0f;
+  xpk = 0.0f;
+  active = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Remove echo of reference (speaker) samples from microphone samples in place.
+// ref is NULL when robot is silent so microphone passes unchanged
+// returns 1 if echo was being removed, 0 if nothing playing
+
+int jhcEchoCancel::Process (short *mic, const short *ref, int n)
+{
+  const float *x;
+  float xin, xout, mag, d, y, e, step, lim = 1e-4f * taps, sm = 0.01f;
+  int i, k;
+
+  // only adapt while robot talks (but keep path estimate)
+  if (ref == NULL)
+  {
+    if (active > 0)
+      clr_hist();
+    return 0;
+  }
+  active = 1;
+
+  for (i = 0; i < n; i++)
+  {
+    // shift reference into history (newest first) and update power
+    xin = ref[i] / 32768.0f;
+    pos = ((pos > 0) ? pos - 1 : taps - 1);
+    xout = hist[pos];
+    hist[pos] = xin;
+    hist[pos + taps] = xin;
+    pwr += xin * xin - xout * xout;
+    if (pwr < 0.0f)
+      pwr = 0.0f;
+    mag = (float) fabs(xin);
+    xpk = ((mag > xpk) ? mag : xpk * decay);
+
+    // predict echo and subtract it
+    x = hist + pos;
+    y = 0.0f;
+    for (k = 0; k < taps; k++)
+      y += w[k] * x[k];
+    d = mic[i] / 32768.0f;
+    e = d - y;
+
+    // user talking if much louder than anything robot recently said
+    if (fabs(d) > dtd * xpk)
+      dt = hold;
+    else if (dt > 0)
+      dt--;
+
+    // adapt filter only when robot alone is talking
+    if ((dt <= 0) && (pwr > lim))
+    {
+      step = (float)(mu * e / (pwr + lim));
+      for (k = 0; k < taps; k++)
+        w[k] += step * x[k];
+    }
+
+    // track attenuation then squash residual unless user talking
+    pd += sm * (d * d - pd);
+    pe += sm * (e * e - pe);
+    if (dt <= 0)
+      e *= (float) supp;
+    e *= 32768.0f;
+    mic[i] = (short)((e > 32767.0f) ? 32767 : ((e < -32768.0f) ? -32768 : e));
+  }
+  return 1;
+}
+
+
+//= Echo return loss enhancement (dB) over the last few ms of robot speech.
+// does not include extra residual suppression
+
+double jhcEchoCancel::Erle () const
+{
+  if ((pe <= 0.0f) || (pd <= 0.0f))
+    return 0.0;
+  return(10.0 * log10(pd / pe));
+}
@@ -0,0 +1,75 @@
+// jhcEchoCancel.h : removes robot speech from microphone signal using NLMS
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Removes robot speech from microphone signal using NLMS.
+// adaptive FIR filter models speaker-to-microphone echo path from reference
+// adaptation pauses when user also talks (Geigel double-talk detector)
+// residual is attenuated further while only the robot is talking
+// filter is kept between utterances since the echo path changes slowly
+
+class jhcEchoCancel
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // filter weights and reference history (stored twice to avoid wrapping)
+  float *w, *hist;
+  int taps, pos, active;
+
+  // reference power in window and decaying peak level
+  float pwr, xpk, decay;
+
+  // samples left in double-talk hold
+  int dt, hold;
+
+  // smoothed microphone and residual power (for ERLE)
+  float pd, pe;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // adaptation rate, double-talk ratio, residual gain, hold time (ms)
+  double mu, dtd, supp;
+  int hang;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcEchoCancel ();
+  jhcEchoCancel ();
+  void Reset (int rate, int ms =100);
+  int Taps () const {return taps;}
+
+  // main functions
+  int Process (short *mic, const short *ref, int n);
+  double Erle () const;
+  int Talking () const {return((dt > 0) ? 1 : 0);}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  void clr_hist ();
+
+};
@@ -0,0 +1,618 @@
+// jhcRecoAzure.cpp : online speech recognition using Microsoft Azure
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+// NOTE: must install NuGet package "Microsoft.CognitiveServices.Speech" as described at
+// https://learn.microsoft.com/en-us/azure/ai-services/speech-service/quickstarts/setup-platform
+
+#ifndef __linux__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <speechapi_cxx.h>
+
+#include "jhcRecoAzure.h"
+
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcRecoAzure::~jhcRecoAzure ()
+{
+  Stop();
+  delete [] clip;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcRecoAzure::jhcRecoAzure ()
+{
+  run = 0;
+  *otxt = '\0';
+  odone = 0;
+  oconf = 1.0f;
+  nw = 0;
+  clip = NULL;
+  nclip = 0;
+  cmax = 0;
+  nk = 0;
+  live = 1;
+  sent = 0;
+  shift = 0;
+
+  // matching parameters
+  slack = 300;               // cloud trims silence differently
+  wait  = 3000;              // slow network
+  pre   = 300;               // catch soft word starts
+}
+
+
+//= Connect to cloud service and start recognizing speech.
+// spec is Azure key and region, prog > 0 prints partial recognitions
+// returns 1 if successful, 0 if cannot connect or no microphone, neg for bad credentials
+
+int jhcRecoAzure::Start (const char *dir, const char *spec, int prog)
+{
+  std::shared_ptr<SpeechConfig> cfg;
+  char key[80] = "", reg[40] = "", fn[250];
+  FILE *in;
+  int i;
+
+  // can only be called once
+  if (svc != NULL)
+    return -4;
+  show = prog;
+
+  // check format of web credentials
+  sscanf_s(spec, "%s %s", key, 80, reg, 40);
+  if (((int) strlen(key) != 32) || (*reg == '\0'))
+    return -2;                                                 // bad format
+  for (i = 0; i < 32; i++)
+    if (isxdigit(key[i]) == 0)
+      return -2;                                               // bad format
+
+  // create instance of recognizer based on credentials
+  if ((cfg = SpeechConfig::FromSubscription(key, reg)) == NULL)
+    return -1;                                                 // invalid credentials
+  cfg->SetProfanity(ProfanityOption::Raw);
+  cfg->SetProperty(PropertyId::Speech_SegmentationSilenceTimeoutMs, "250");   // VAD joins
+  cfg->SetProperty(PropertyId::SpeechServiceResponse_StablePartialResultThreshold, "3");
+  cfg->SetOutputFormat(OutputFormat::Detailed);              // for confidence
+
+  // cloud gets audio pushed from local microphone (also goes to VAD)
+  if (mic.Open(rate) <= 0)
+    return 0;
+  push = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(rate, 16, 1));
+  if ((svc = SpeechRecognizer::FromConfig(cfg, AudioConfig::FromStreamInput(push))) == NULL)
+    return 0;                                                  // no internet?
+
+  // add proper spellings of names
+  vocab = PhraseListGrammar::FromRecognizer(svc);
+  LoadNames(dir);
+
+  // offline spotter for robot name (optional custom keyword model)
+  sprintf_s(fn, "%s/config/wake.table", ((dir == NULL) ? "." : dir));
+  if (fopen_s(&in, fn, "rb") == 0)
+  {
+    fclose(in);
+    if ((kmod = KeywordRecognitionModel::FromFile(fn)) != NULL)
+    {
+      cmax = ((wmax + pre + vad.hmax + 2000) * rate) / 1000;    // time to spot
+      clip = new short [cmax + fsz];
+      kws = 1;
+    }
+  }
+
+  // ---------------------------------------------------------------------------
+  // CALLBACK: for partial result of a piece (only words seen in several hypotheses)
+  svc->Recognizing.Connect([this] (const SpeechRecognitionEventArgs& e)
+  {
+    unsigned long s0 = (unsigned long)(e.Result->Offset() / 10000);
+    unsigned long s1 = s0 + (unsigned long)(e.Result->Duration() / 10000);
+    hyp.Push((e.Result->Text).data(), s0, s1);
+  });
+
+  // ---------------------------------------------------------------------------
+  // CALLBACK: for final result of a piece (times relative to stream start)
+  svc->Recognized.Connect([this] (const SpeechRecognitionEventArgs& e)
+  {
+    if (e.Result->Reason == ResultReason::RecognizedSpeech)
+    {
+      const char *res = (e.Result->Text).data();
+      unsigned long s0 = (unsigned long)(e.Result->Offset() / 10000);
+      unsigned long s1 = s0 + (unsigned long)(e.Result->Duration() / 10000);
+      std::string js = e.Result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult);
+      if ((*res != '\0') && (strcmp(res, "Hey, Cortana.") != 0))      // quirk
+        frag.Push(res, s0, s1, json_conf(js.c_str()));
+    }
+    else if (e.Result->Reason == ResultReason::NoMatch)
+      heard_none();                                            // unintelligible
+  });
+
+  // ---------------------------------------------------------------------------
+  // CALLBACK: for network monitoring
+  if ((net = Connection::FromRecognizer(svc)) != NULL)
+    net->Disconnected.Connect([this] (const ConnectionEventArgs& e)
+    {
+      if (live > 0)
+        net_lost();                                            // lost network
+    });
+
+  // start processing speech input right now
+  svc->StartContinuousRecognitionAsync().get();
+  run = 1;
+  pthread_create(&bg, NULL, listen_loop, this);
+  return 1;
+}
+
+
+//= Stop online speech recognition and clear results.
+
+void jhcRecoAzure::Stop ()
+{
+  if (run > 0)
+  {
+    run = 0;
+    pthread_join(bg, NULL);
+  }
+  if (kres.valid())
+    kres.wait();
+  if (push != NULL)
+    push->Close();
+  if (svc != NULL)
+    svc->StopContinuousRecognitionAsync().get();
+  mic.Close();
+  reco = 0;
+
+  // smart pointer release
+  vocab = NULL;
+  kr = NULL;
+  ks = NULL;
+  kmod = NULL;
+  net = NULL;
+  svc = NULL;
+  push = NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Configuration                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Add a particular name to grammar to increase likelihood of correct spelling.
+// can be called even when recognition is actively running
+
+int jhcRecoAzure::AddName (const char *name)
+{
+  if (vocab == NULL)
+    return -1;
+  if ((name == NULL) || (*name == '\0'))
+    return 0;
+  vocab->AddPhrase(name);                        // limit of 1024
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Listening                               //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for microphone processing.
+
+pthread_ret jhcRecoAzure::listen_loop (void *eng)
+{
+  ((jhcRecoAzure *) eng)->run_listen();
+  return 0;
+}
+
+
+//= Send audio to cloud while finding utterance boundaries locally.
+// any VAD endpoint counts since cloud decides whether there were words
+// if gated then only streams while awake, else checks utterances for wake word
+
+void jhcRecoAzure::run_listen ()
+{
+  short f[fsz];
+  char txt[500];
+  unsigned long s0, s1, now;
+  float c;
+  int i, ev;
+
+  vad.Reset(rate);
+  nw = 0;
+  *otxt = '\0';
+  nclip = 0;
+  nk = 0;
+  *ptxt = '\0';
+  ps0 = 0;
+  sent = 0;
+  shift = 0;
+  live = 1;
+  while (run > 0)
+  {
+    // get next frame and check for end of speech
+    if (mic.Read(f, fsz) <= 0)
+    {
+      net_lost();                                              // lost microphone
+      break;
+    }
+    now = Now();
+    ev = vad.Frame(f, fsz, now);
+
+    // send to cloud while awake (stop once quiet and all text is in)
+    if (live > 0)
+    {
+      send(f, fsz);
+      if (ev >= 2)
+      {
+        add_wait(vad.Onset(), vad.Offset(), vad.StreamOff());
+        stay_awake(now);
+      }
+      else if ((vad.Talking() <= 0) && (nw <= 0) && (awake(now) <= 0))
+        live = 0;
+    }
+    else if (save_clip(f, ev) > 0)
+    {
+      // robot addressed so send all saved utterances
+      go_live();
+      for (i = 0; i < nk; i++)
+        add_wait(kon[i], koff[i], ksoff[i]);
+      nk = 0;
+      stay_awake(now);
+    }
+    else if ((nclip > 0) && (nk <= 0) && (awake(now) > 0))
+      go_live();                                               // attending
+
+    // gather recognized pieces and post completed utterances
+    while (frag.Pop(txt, 500, s0, s1, c) > 0)
+      attach(txt, s0 + shift, s1 + shift, c);
+    post_part();
+    post_done(Now());
+  }
+}
+
+
+//= Save timing of utterance that ended along with text so far.
+// takes speech onset and offset (ms) plus offset in VAD stream time
+// if too many are already waiting then they are all posted as is
+
+void jhcRecoAzure::add_wait (unsigned long t0, unsigned long t1, unsigned long s1)
+{
+  int i;
+
+  if (nw >= umax)
+    post_done(0xFFFFFFFF);
+  i = nw++;
+  strcpy_s(wtxt[i], otxt);
+  wconf[i] = oconf;
+  sdone[i] = odone;
+  won[i]  = t0;
+  woff[i] = t1;
+  soff[i] = s1;
+
+  // start fresh for next utterance
+  *otxt = '\0';
+  odone = 0;
+  oconf = 1.0f;
+}
+
+
+//= Add recognized piece to the utterance it falls within.
+// s0 and s1 are piece start and end times relative to start of stream
+
+void jhcRecoAzure::attach (const char *txt, unsigned long s0, unsigned long s1, float c)
+{
+  unsigned long skew;
+  int i;
+
+  // part of oldest finished utterance it overlaps
+  for (i = 0; i < nw; i++)
+    if (s0 < (soff[i] + slack))
+    {
+      join_text(wtxt[i], txt, 500);
+      wconf[i] = __min(wconf[i], c);
+      sdone[i] = __max(sdone[i], s1);
+      return;
+    }
+
+  // part of utterance still in progress
+  if (vad.Talking() > 0)
+  {
+    join_text(otxt, txt, 500);
+    oconf = __min(oconf, c);
+    odone = __max(odone, s1);
+    return;
+  }
+
+  // VAD missed speech so estimate times from stream position
+  skew = Now() - vad.StreamNow();
+  heard_all(txt, s0 + skew, s1 + skew, c);
+}
+
+
+//= Post oldest utterances once their text reaches end of speech.
+// gives up waiting for more text after a while (e.g. cloud heard nothing)
+
+void jhcRecoAzure::post_done (unsigned long now)
+{
+  int i;
+
+  while (nw > 0)
+  {
+    if (((sdone[0] + slack) < soff[0]) && (now < (woff[0] + wait)))
+      break;
+    if (*wtxt[0] != '\0')
+      heard_all(wtxt[0], won[0], woff[0], wconf[0]);
+    else if (reco == 1)
+      reco = 0;                                                // no words
+    nw--;
+    for (i = 0; i < nw; i++)
+    {
+      strcpy_s(wtxt[i], wtxt[i + 1]);
+      wconf[i] = wconf[i + 1];
+      sdone[i] = sdone[i + 1];
+      won[i]  = won[i + 1];
+      woff[i] = woff[i + 1];
+      soff[i] = soff[i + 1];
+    }
+  }
+}
+
+
+//= Post partial hypothesis for newest utterance.
+// cloud hypothesis only covers piece being worked on, so earlier pieces go first
+// hypothesis is skipped once its piece is recognized or if from an old utterance
+
+void jhcRecoAzure::post_part ()
+{
+  char txt[500];
+  const char *done = otxt;
+  unsigned long s0, s1, tdone = odone;
+  float c;
+
+  // get latest hypothesis for piece in progress
+  while (hyp.Pop(txt, 500, s0, s1, c) > 0)
+  {
+    strcpy_s(ptxt, txt);
+    ps0 = s0 + shift;
+  }
+
+  // text recognized so far for utterance in progress or last one to end
+  if (vad.Talking() <= 0)
+  {
+    if (nw <= 0)
+      return;
+    done = wtxt[nw - 1];
+    tdone = sdone[nw - 1];
+  }
+  strcpy_s(txt, done);
+  if ((*ptxt != '\0') && (ps0 >= tdone) && ((ps0 + slack) >= vad.StreamOn()))
+    join_text(txt, ptxt, 500);
+  if (*txt != '\0')
+    heard_part(txt);
+}
+
+
+//= Append a recognized piece to utterance text.
+// cloud ends every piece as a sentence so drop period at the join
+
+void jhcRecoAzure::join_text (char *dest, const char *txt, int ssz) const
+{
+  int n = (int) strlen(dest);
+
+  if (n <= 0)
+  {
+    strcpy_s(dest, ssz, txt);
+    return;
+  }
+  if (dest[n - 1] == '.')
+    dest[--n] = '\0';
+  if (n >= (ssz - 2))
+    return;
+  dest[n++] = ' ';
+  strcpy_s(dest + n, ssz - n, txt);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                           Wake Word Gating                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Push some audio to cloud and keep track of stream length.
+
+void jhcRecoAzure::send (const short *snd, int n)
+{
+  push->Write((uint8_t *) snd, n * sizeof(short));
+  sent += n;
+}
+
+
+//= Start streaming to cloud beginning with saved audio.
+// cloud stream skips the time spent asleep so remember offset to VAD clock
+
+void jhcRecoAzure::go_live ()
+{
+  shift = (long)(vad.StreamNow() - (1000LL * nclip) / rate) - (long)((1000 * sent) / rate);
+  send(clip, nclip);
+  nclip = 0;
+  live = 1;
+}
+
+
+//= Keep audio of current utterance while asleep and check it for wake word at end.
+// only a little pre-roll is kept during silence, long utterances are abandoned
+// audio keeps being saved while spotter runs so none is lost if name was heard
+// returns 1 if robot was addressed, 0 otherwise
+
+int jhcRecoAzure::save_clip (const short *f, int ev)
+{
+  int keep = (pre * rate) / 1000;
+
+  // make room (only waits for spotter if it is very slow)
+  while ((nk > 0) && ((nclip + fsz) > cmax))
+    if (spot_done(1) > 0)
+    {
+      memcpy(clip + nclip, f, fsz * sizeof(short));          // spare frame
+      nclip += fsz;
+      return 1;
+    }
+
+  // add frame unless utterance is already too long (or no spotter)
+  if (nclip >= 0)
+  {
+    if ((nclip + fsz) > cmax)
+      nclip = -1;
+    else
+    {
+      memcpy(clip + nclip, f, fsz * sizeof(short));
+      nclip += fsz;
+    }
+  }
+
+  // see if some earlier utterance mentioned robot
+  if ((nk > 0) && (spot_done(0) > 0))
+    return 1;
+
+  // queue up new utterance for checking
+  if (ev >= 2)
+    spot_utt();
+  else if ((ev < 0) && (nk <= 0))
+    nclip = 0;                                                 // noise burst
+
+  // only retain a little pre-roll during silence
+  if ((vad.Talking() <= 0) && (nk <= 0))
+  {
+    if (nclip < 0)
+      nclip = 0;
+    else if (nclip > keep)
+    {
+      memmove(clip, clip + (nclip - keep), keep * sizeof(short));
+      nclip = keep;
+    }
+  }
+  return 0;
+}
+
+
+//= Remember utterance that just ended so spotter can check it (if short enough).
+// starts spotter right away unless it is busy with an earlier utterance
+
+void jhcRecoAzure::spot_utt ()
+{
+  if ((kmod == NULL) || (nclip <= 0) || (nk >= 2) ||
+      ((int)(vad.Offset() - vad.Onset()) > wmax))
+  {
+    if (nk <= 0)
+      nclip = 0;
+    return;
+  }
+  kend[nk] = nclip;
+  kon[nk] = vad.Onset();
+  koff[nk] = vad.Offset();
+  ksoff[nk] = vad.StreamOff();
+  if (++nk > 1)
+    return;
+  if (spot_start() <= 0)
+  {
+    nk = 0;
+    nclip = 0;
+  }
+}
+
+
+//= Start offline keyword spotter on oldest saved utterance without waiting.
+// returns 1 if running, 0 if problem
+
+int jhcRecoAzure::spot_start ()
+{
+  ks = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(rate, 16, 1));
+  if ((kr = KeywordRecognizer::FromConfig(AudioConfig::FromStreamInput(ks))) == NULL)
+    return 0;
+  ks->Write((uint8_t *) clip, kend[0] * sizeof(short));
+  ks->Close();
+  kres = kr->RecognizeOnceAsync(kmod);
+  return 1;
+}
+
+
+//= See if spotter is finished with oldest saved utterance (can wait for it).
+// if name not heard then drops that audio and starts on next utterance (if any)
+// returns 1 if robot name heard, 0 if not, -1 if still running
+
+int jhcRecoAzure::spot_done (int block)
+{
+  std::shared_ptr<KeywordRecognitionResult> res;
+  int n = kend[0];
+
+  // get answer
+  if ((block <= 0) && (kres.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+    return -1;
+  res = kres.get();
+  if ((res != NULL) && (res->Reason == ResultReason::RecognizedKeyword))
+    return 1;
+
+  // forget checked utterance but keep anything after it
+  memmove(clip, clip + n, (nclip - n) * sizeof(short));
+  nclip -= n;
+  if (--nk > 0)
+  {
+    kend[0] = kend[1] - n;
+    kon[0] = kon[1];
+    koff[0] = koff[1];
+    ksoff[0] = ksoff[1];
+    if (spot_start() <= 0)
+      nk = 0;
+  }
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Result Details                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Pull confidence of best interpretation out of detailed JSON result.
+// first "Confidence" field is in top NBest entry, returns 1 if not found
+
+float jhcRecoAzure::json_conf (const char *json) const
+{
+  const char *c;
+  float v;
+
+  if ((c = strstr(json, "\"Confidence\"")) == NULL)
+    return 1.0f;
+  if ((c = strchr(c, ':')) == NULL)
+    return 1.0f;
+  if (sscanf_s(c + 1, "%f", &v) != 1)
+    return 1.0f;
+  return __max(0.0f, __min(v, 1.0f));
+}
+
+
+#endif  // __linux__
@@ -0,0 +1,163 @@
+// jhcRecoAzure.h : online speech recognition using Microsoft Azure
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+
+#include "jhc_pthread.h"
+
+#include "jhcAudioIn.h"
+#include "jhcRecoEngine.h"
+
+
+// avoid pulling whole SDK into every file
+
+namespace Microsoft { namespace CognitiveServices { namespace Speech {
+  class SpeechRecognizer;
+  class PhraseListGrammar;
+  class Connection;
+  class KeywordRecognitionModel;
+  class KeywordRecognizer;
+  class KeywordRecognitionResult;
+  namespace Audio {class PushAudioInputStream;}
+}}}
+
+
+//= Online speech recognition using Microsoft Azure.
+// streams microphone to cloud and gets results via SDK callbacks
+// cloud segments finely, pieces are joined into utterances found by local VAD
+// callback only queues pieces, listening thread is sole producer of results
+// partial is recognized pieces of utterance plus hypothesis for current piece
+// with wake word gating nothing is streamed until the offline keyword spotter
+// (model in config/wake.table) hears robot name, then whole utterance is sent
+// spotter runs in the background so audio keeps being saved while it decides
+// spec from key file is "<32 hex digit key> <region>"
+// NOTE: Windows only (needs NuGet package "Microsoft.CognitiveServices.Speech")
+
+class jhcRecoAzure : public jhcRecoEngine
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // recognizer, special phrase list, and internet connection monitor
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> svc;
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::PhraseListGrammar> vocab;
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> net;
+
+  // audio source and stream to cloud
+  static const int rate = 16000;
+  static const int fsz  = 320;         // 20 ms analysis frame
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> push;
+  jhcAudioIn mic;
+
+  // listening thread
+  pthread_t bg;
+  int run;
+
+  // offline wake word model, audio saved while not streaming
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> kmod;
+  short *clip;
+  int nclip, cmax;
+
+  // spotter running on oldest saved utterance and its eventual result
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> ks;
+  std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognizer> kr;
+  std::future<std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionResult>> kres;
+
+  // short utterances awaiting spotter: end in clip, wall and stream times (ms)
+  int kend[2], nk;
+  unsigned long kon[2], koff[2], ksoff[2];
+
+  // whether streaming, samples sent, and VAD minus cloud stream time (ms)
+  std::atomic<int> live;
+  long long sent;
+  long shift;
+
+  // recognized pieces from callback with stream times (ms)
+  jhcUttQ frag;
+
+  // hypotheses for piece in progress from callback, latest one and start (ms)
+  jhcUttQ hyp;
+  char ptxt[500];
+  unsigned long ps0;
+
+  // text of utterance in progress
+  char otxt[500];
+  unsigned long odone;
+  float oconf;
+
+  // finished utterances awaiting text (wall and stream times in ms)
+  static const int umax = 4;
+  char wtxt[umax][500];
+  unsigned long won[umax], woff[umax], soff[umax], sdone[umax];
+  float wconf[umax];
+  int nw;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // allowed mismatch of cloud and VAD times, longest wait for text (ms)
+  int slack, wait;
+
+  // audio kept before speech onset when not streaming (ms)
+  int pre;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcRecoAzure ();
+  jhcRecoAzure ();
+  int Start (const char *dir, const char *spec, int prog =0);
+  void Stop ();
+
+  // configuration
+  int AddName (const char *name);
+  void Mute (int doit) {mic.Mute(doit);}
+  void Echo (const jhcAudioOut *spk) {mic.Echo(spk);}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // listening
+  static pthread_ret listen_loop (void *eng);
+  void run_listen ();
+  void add_wait (unsigned long t0, unsigned long t1, unsigned long s1);
+  void attach (const char *txt, unsigned long s0, unsigned long s1, float c);
+  void post_done (unsigned long now);
+  void post_part ();
+  void join_text (char *dest, const char *txt, int ssz) const;
+
+  // wake word gating
+  void send (const short *snd, int n);
+  void go_live ();
+  int save_clip (const short *f, int ev);
+  void spot_utt ();
+  int spot_start ();
+  int spot_done (int block);
+
+  // result details
+  float json_conf (const char *json) const;
+
+};
@@ -0,0 +1,309 @@
+// jhcRecoEngine.cpp : common interface for speech recognition backends
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "jhcRecoEngine.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcRecoEngine::jhcRecoEngine ()
+{
+  show = 0;
+  reco = 0;
+  pseq = 0;
+  *part = '\0';
+  pon = 0;
+  pchg = 0;
+  settle = 500;              // same as Azure silence timeout
+
+  // wake word gating (off until robot name given)
+  kws = 0;
+  *names = '\0';
+  gate = 0;
+  attn = 0;
+  wlast = 0;
+  linger = 10000;            // a few conversational turns
+  wmax = 3000;               // name plus a short command
+}
+
+
+//= Add proper spellings of names from file: config/all_names.txt
+// returns number of names added
+
+int jhcRecoEngine::LoadNames (const char *dir)
+{
+  char fn[200], name[80];
+  FILE *in;
+  int n, cnt = 0;
+
+  snprintf(fn, 200, "%s/config/all_names.txt", ((dir == NULL) ? "." : dir));
+  if ((in = fopen(fn, "r")) == NULL)
+    return 0;
+  while (fgets(name, 80, in) != NULL)
+    if ((n = (int) strlen(name)) > 0)
+    {
+      if (name[n - 1] == '\n')
+        name[n - 1] = '\0';
+      if (AddName(name) > 0)
+        cnt++;
+    }
+  fclose(in);
+  return cnt;
+}
+
+
+//= Only do full recognition after hearing some part of robot name (or if attending).
+// e.g. "Waldo Baijiu" wakes up on either "Waldo" or "Baijiu"
+// should be called once after Start since engine must support spotting
+// returns 1 if gating active, 0 if always listening (no name or no spotter)
+
+int jhcRecoEngine::Wake (const char *rname)
+{
+  const char *s = rname;
+  int n = 0;
+
+  // save lowercase words of name separated by single spaces
+  gate = 0;
+  if ((rname == NULL) || (kws <= 0))
+    return 0;
+  while ((*s != '\0') && (n < 199))
+  {
+    if (isalnum((unsigned char) *s) || (*s == '\''))
+      names[n++] = (char) tolower((unsigned char) *s);
+    else if ((n > 0) && (names[n - 1] != ' '))
+      names[n++] = ' ';
+    s++;
+  }
+  while ((n > 0) && (names[n - 1] == ' '))
+    n--;
+  names[n] = '\0';
+  if (n <= 0)
+    return 0;
+
+  // make name easier to recognize then start out asleep
+  AddName(rname);
+  wlast = 0;
+  gate = 1;
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                                Results                                //
+///////////////////////////////////////////////////////////////////////////
+
+//= Tell current recognition state.
+// return: 2 new result, 1 speaking, 0 silence, -1 unintelligible, -2 lost connection
+
+int jhcRecoEngine::Status () const
+{
+  if (q.Count() > 0)
+    return 2;
+  return reco;
+}
+
+
+//= Get text of oldest unread recognition and how long ago speech started (ms).
+// can optionally get recognizer confidence (0-1) also
+// returns 1 if something new, 0 if nothing (text unchanged)
+
+int jhcRecoEngine::Take (char *txt, int ssz, int& ms, float *conf)
+{
+  unsigned long t0, t1;
+  float c;
+
+  if (q.Pop(txt, ssz, t0, t1, c) <= 0)
+    return 0;
+  ms = (int)(Now() - t0);
+  if (conf != NULL)
+    *conf = c;
+  return 1;
+}
+
+
+//= Get latest partial hypothesis, its stability (0-1), and time since speech onset (ms).
+// stability grows as text stays unchanged, reaching 1 after "settle" ms
+// never blocks writer, just copies again if text was changing during read
+// returns 1 if some partial text, 0 if none
+
+int jhcRecoEngine::Partial (char *txt, int ssz, float& stab, int& ms) const
+{
+  unsigned long t0, tc, now;
+  unsigned int s0;
+
+  // get consistent copy of text and times
+  do
+  {
+    while (((s0 = pseq.load(std::memory_order_acquire)) & 0x01) != 0);
+    strncpy(txt, part, ssz - 1);
+    txt[ssz - 1] = '\0';
+    t0 = pon;
+    tc = pchg;
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  while (pseq.load(std::memory_order_relaxed) != s0);
+
+  // compute derived values (only valid while speaking)
+  stab = 0.0f;
+  ms = 0;
+  if ((*txt == '\0') || (reco != 1))
+  {
+    *txt = '\0';
+    return 0;
+  }
+  now = Now();
+  stab = (float)(now - tc) / settle;
+  if (stab > 1.0f)
+    stab = 1.0f;
+  ms = (int)(now - t0);
+  return 1;
+}
+
+
+//= Monotonic time in milliseconds (arbitrary zero).
+
+unsigned long jhcRecoEngine::Now ()
+{
+  return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//= Note that user is speaking and possibly record partial text.
+// text can be NULL when engine only knows that speech has started
+
+void jhcRecoEngine::heard_part (const char *txt)
+{
+  unsigned long now = Now();
+
+  // mark start of new utterance
+  if (reco != 1)
+  {
+    set_part("", now);
+    pon = now;
+  }
+  reco = 1;
+
+  // remember when text last changed
+  if ((txt == NULL) || (*txt == '\0') || (strcmp(txt, part) == 0))
+    return;
+  if (show > 0)
+    printf("  %s ...\n", txt);
+  set_part(txt, now);
+}
+
+
+//= Queue full recognition result with speech start and end times (ms).
+// never waits so safe to call from SDK callback threads
+
+void jhcRecoEngine::heard_all (const char *txt, unsigned long t0, unsigned long t1, float conf)
+{
+  q.Push(txt, t0, t1, conf);
+  reco = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                           Wake Word Gating                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Whether full recognition should be running at this time (ms).
+// always awake if no gating, else only while attending or shortly after talking
+
+int jhcRecoEngine::awake (unsigned long now) const
+{
+  if ((gate <= 0) || (attn > 0))
+    return 1;
+  if ((wlast != 0) && ((now - wlast) < (unsigned long) linger))
+    return 1;
+  return 0;
+}
+
+
+//= See if any word of text matches some word of robot name (ignoring case).
+// returns 1 if robot addressed, 0 if not
+
+int jhcRecoEngine::has_wake (const char *txt) const
+{
+  char word[80];
+  const char *s = txt, *nm;
+  int n, len;
+
+  while (*s != '\0')
+  {
+    // get next word of text
+    n = 0;
+    while ((*s != '\0') && !isalnum((unsigned char) *s))
+      s++;
+    while ((*s != '\0') && (isalnum((unsigned char) *s) || (*s == '\'')))
+    {
+      if (n < 79)
+        word[n++] = (char) tolower((unsigned char) *s);
+      s++;
+    }
+    word[n] = '\0';
+
+    // compare to each name word (strip possessive)
+    if ((n > 2) && (strcmp(word + n - 2, "'s") == 0))
+      word[n - 2] = '\0';
+    len = (int) strlen(word);
+    nm = names;
+    while ((len > 0) && (*nm != '\0'))
+    {
+      if ((strncmp(nm, word, len) == 0) && ((nm[len] == ' ') || (nm[len] == '\0')))
+        return 1;
+      nm += strcspn(nm, " ");
+      if (*nm == ' ')
+        nm++;
+    }
+  }
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                          Partial Hypothesis                           //
+///////////////////////////////////////////////////////////////////////////
+
+//= Replace partial hypothesis text and note time of change.
+// only called from heard_part, readers retry if sequence count changes
+
+void jhcRecoEngine::set_part (const char *txt, unsigned long now)
+{
+  pseq.fetch_add(1, std::memory_order_relaxed);            // now odd
+  std::atomic_thread_fence(std::memory_order_release);
+  strncpy(part, txt, 499);
+  part[499] = '\0';
+  pchg = now;
+  pseq.fetch_add(1, std::memory_order_release);            // even again
+}
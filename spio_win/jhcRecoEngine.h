@@ -0,0 +1,127 @@
+// jhcRecoEngine.h : common interface for speech recognition backends
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+#include "jhcUttQ.h"
+#include "jhcVAD.h"
+
+
+// avoid pulling playback into every file
+
+class jhcAudioOut;
+
+
+//= Common interface for speech recognition backends.
+// derived classes run on their own thread (or SDK callbacks) and report
+// through protected functions which update the shared status and queue
+// finished utterances go through a lock-free queue so none are lost
+// latest partial hypothesis is kept with a stability based on its age
+// engines reading the microphone themselves use a shared VAD for endpointing
+// and can remove robot speech from it given the speaker as echo reference
+// optional wake word gating skips full recognition unless robot was addressed
+// spio_win only talks to this interface so engines can be swapped
+
+class jhcRecoEngine
+{
+// PROTECTED MEMBER VARIABLES
+protected:
+  // whether to print partial results
+  int show;
+
+  // most recent status (written only by engine thread)
+  std::atomic<int> reco;
+
+  // finished utterances waiting for pickup
+  jhcUttQ q;
+
+  // speech onset and offset detector
+  jhcVAD vad;
+
+  // latest partial hypothesis (sequence count odd while being written)
+  std::atomic<unsigned int> pseq;
+  char part[500];
+  unsigned long pon, pchg;
+
+  // whether engine can spot wake word, words of robot name (lowercase)
+  int kws;
+  char names[200];
+
+  // wake word gating active, attention override, last utterance while awake
+  std::atomic<int> gate, attn;
+  unsigned long wlast;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // time (ms) partial must be unchanged to be fully stable
+  int settle;
+
+  // time awake after last utterance and longest wake utterance (ms)
+  int linger, wmax;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  virtual ~jhcRecoEngine () {}
+  jhcRecoEngine ();
+  virtual int Start (const char *dir, const char *spec, int prog =0) =0;
+  virtual void Stop () =0;
+  int LoadNames (const char *dir);
+
+  // configuration
+  virtual int AddName (const char *name) =0;
+  virtual void Mute (int doit) =0;
+  virtual void Echo (const jhcAudioOut *spk) {}
+  void Endpoint (int ms) {vad.NextHang(ms);}
+  int Wake (const char *rname);
+  void Attend (int doit) {attn = ((doit > 0) ? 1 : 0);}
+  int Gated () const {return gate;}
+
+  // results
+  int Status () const;
+  int Take (char *txt, int ssz, int& ms, float *conf =NULL);
+  int Partial (char *txt, int ssz, float& stab, int& ms) const;
+  int Dropped () const {return q.drop;}
+  static unsigned long Now ();
+
+
+// PROTECTED MEMBER FUNCTIONS
+protected:
+  // result reporting
+  void heard_part (const char *txt);
+  void heard_all (const char *txt, unsigned long t0, unsigned long t1, float conf =1.0f);
+  void heard_none () {reco = -1;}
+  void net_lost () {reco = -2;}
+
+  // partial hypothesis
+  void set_part (const char *txt, unsigned long now);
+
+  // wake word gating
+  int awake (unsigned long now) const;
+  void stay_awake (unsigned long now) {wlast = now;}
+  int has_wake (const char *txt) const;
+
+};
@@ -0,0 +1,565 @@
+// jhcRecoFix.cpp : corrects commonly misheard words in recognition results
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "jhcRecoFix.h"
+
+
+//= Fixups which need more context than map files allow (pattern, replacement, capitals).
+// "Dr. forward" is really "drive forward" but "Dr. Jones" is left alone
+// "Dr." at the very end is "drive." (period kept since it ends the sentence)
+
+static const char *fixed[][3] = {{"Dr.", "drive", "FB"}};
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcRecoFix::~jhcRecoFix ()
+{
+  dealloc();
+  delete [] mr;
+  delete [] me;
+  delete [] ms;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcRecoFix::jhcRecoFix ()
+{
+  // rules and automaton
+  pat = NULL;
+  rep = NULL;
+  cap = NULL;
+  plen = NULL;
+  nr = 0;
+  go = NULL;
+  hit = NULL;
+  dict = NULL;
+  nn = 0;
+
+  // match list
+  ms = NULL;
+  me = NULL;
+  mr = NULL;
+  mmax = 0;
+
+  // map files
+  *dir = '\0';
+  t0[0] = 0;
+  t0[1] = 0;
+  chk = 0;
+  poll = 1000;
+}
+
+
+//= Get rid of all rules and automaton.
+
+void jhcRecoFix::dealloc ()
+{
+  int i;
+
+  for (i = 0; i < nr; i++)
+  {
+    delete [] rep[i];
+    delete [] pat[i];
+  }
+  delete [] dict;
+  delete [] hit;
+  delete [] go;
+  delete [] plen;
+  delete [] cap;
+  delete [] rep;
+  delete [] pat;
+  pat = NULL;
+  rep = NULL;
+  cap = NULL;
+  plen = NULL;
+  go = NULL;
+  hit = NULL;
+  dict = NULL;
+  nr = 0;
+  nn = 0;
+}
+
+
+//= Compile substitutions from map files in config directory under path.
+// returns number of rules
+
+int jhcRecoFix::Load (const char *path)
+{
+  strncpy(dir, ((path == NULL) ? "." : path), 199);
+  dir[199] = '\0';
+  changed();
+  return compile();
+}
+
+
+//= See if either map file has been edited (checks only every "poll" ms).
+// returns 1 if some change, 0 if same as before
+
+int jhcRecoFix::changed ()
+{
+  char fn[250];
+  long long t;
+  unsigned long now;
+  int i, diff = 0;
+
+  // see if time to check
+  now = (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+  if ((*dir == '\0') || ((chk != 0) && ((now - chk) < (unsigned long) poll)))
+    return 0;
+  chk = now;
+
+  // compare modification times
+  for (i = 0; i < 2; i++)
+  {
+    snprintf(fn, 250, "%s/config/%s.map", dir, ((i <= 0) ? "misheard" : "pronounce"));
+    if ((t = mod_time(fn)) != t0[i])
+      diff = 1;
+    t0[i] = t;
+  }
+  return diff;
+}
+
+
+//= Get last modification time of a file (0 if missing).
+
+long long jhcRecoFix::mod_time (const char *fn)
+{
+  struct stat st;
+
+  if (stat(fn, &st) != 0)
+    return 0;
+  return (long long) st.st_mtime;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                              Compilation                              //
+///////////////////////////////////////////////////////////////////////////
+
+//= Read all substitutions and build automaton for them.
+// returns number of rules
+
+int jhcRecoFix::compile ()
+{
+  int n, len;
+
+  // count rules and pattern characters (left in nn)
+  dealloc();
+  if ((n = read_maps(0)) <= 0)
+    return 0;
+  len = nn + 1;
+
+  // make space for rules and worst case number of nodes
+  pat  = new char * [n];
+  rep  = new char * [n];
+  cap  = new const char * [n];
+  plen = new int [n];
+  go   = new int [len * nsym];
+  hit  = new int [len];
+  dict = new int [len];
+
+  // fill rules then connect nodes
+  read_maps(1);
+  build();
+  return nr;
+}
+
+
+//= Go through built-in fixups and both map files.
+// if fill <= 0 then only counts rules and pattern characters
+// returns number of rules
+
+int jhcRecoFix::read_maps (int fill)
+{
+  char fn[250];
+  int i, n = (int)(sizeof(fixed) / sizeof(fixed[0])), cnt = 0;
+
+  for (i = 0; i < n; i++)
+    cnt += add_rule(fixed[i][0], fixed[i][1], fixed[i][2], fill);
+  snprintf(fn, 250, "%s/config/misheard.map", dir);
+  cnt += read_misheard(fn, fill);
+  snprintf(fn, 250, "%s/config/pronounce.map", dir);
+  cnt += read_pronounce(fn, fill);
+  return cnt;
+}
+
+
+//= Get recognition fixes from a file with correct form first then variants.
+// = Connell
+//   canal
+//   cannelle
+// returns number of rules
+
+int jhcRecoFix::read_misheard (const char *fn, int fill)
+{
+  char line[200], target[200] = "";
+  FILE *in;
+  char *s;
+  int n, cnt = 0;
+
+  if ((in = fopen(fn, "r")) == NULL)
+    return 0;
+  while (fgets(line, 200, in) != NULL)
+  {
+    // trim both ends
+    n = (int) strlen(line);
+    while ((n > 0) && isspace((unsigned char) line[n - 1]))
+      n--;
+    line[n] = '\0';
+    s = line;
+    while (isspace((unsigned char) *s))
+      s++;
+    if (*s == '\0')
+      continue;
+
+    // new target or variant of current one
+    if (*s == '=')
+    {
+      s++;
+      while (isspace((unsigned char) *s))
+        s++;
+      strcpy(target, s);
+    }
+    else if ((s > line) && (*target != '\0'))
+      cnt += add_rule(s, target, NULL, fill);
+  }
+  fclose(in);
+  return cnt;
+}
+
+
+//= Get re-spellings for speech output from a file with word then tabs.
+// Connell		kih-nel
+// recognizer might produce the re-spelling (e.g. echo) so map back to word
+// returns number of rules
+
+int jhcRecoFix::read_pronounce (const char *fn, int fill)
+{
+  char line[200];
+  FILE *in;
+  char *s, *end;
+  int n, cnt = 0;
+
+  if ((in = fopen(fn, "r")) == NULL)
+    return 0;
+  while (fgets(line, 200, in) != NULL)
+  {
+    // split at first tab
+    if ((s = strchr(line, '\t')) == NULL)
+      continue;
+    end = s;
+    while (isspace((unsigned char) *s))
+      s++;
+    while ((end > line) && isspace((unsigned char) end[-1]))
+      end--;
+    *end = '\0';
+    n = (int) strlen(s);
+    while ((n > 0) && isspace((unsigned char) s[n - 1]))
+      n--;
+    s[n] = '\0';
+    if ((*line != '\0') && (*s != '\0'))
+      cnt += add_rule(s, line, NULL, fill);
+  }
+  fclose(in);
+  return cnt;
+}
+
+
+//= Add a substitution with normalized pattern (lowercase, single spaces).
+// if fill <= 0 then only counts characters in pattern
+// returns 1 if valid rule, 0 if ignored
+
+int jhcRecoFix::add_rule (const char *p, const char *r, const char *c, int fill)
+{
+  char norm[200];
+  const char *s = p;
+  int n = 0;
+
+  // collapse whitespace and fold case
+  while ((*s != '\0') && (n < 199))
+  {
+    if (!isspace((unsigned char) *s))
+      norm[n++] = (char) tolower((unsigned char) *s);
+    else if ((n > 0) && (norm[n - 1] != ' '))
+      norm[n++] = ' ';
+    s++;
+  }
+  while ((n > 0) && (norm[n - 1] == ' '))
+    n--;
+  norm[n] = '\0';
+  if (n <= 0)
+    return 0;
+
+  // just tally space needed
+  if (fill <= 0)
+  {
+    nn += n;
+    return 1;
+  }
+
+  // save rule
+  pat[nr] = new char [n + 1];
+  strcpy(pat[nr], norm);
+  rep[nr] = new char [strlen(r) + 1];
+  strcpy(rep[nr], r);
+  cap[nr] = c;
+  plen[nr] = n;
+  nr++;
+  return 1;
+}
+
+
+//= Build trie of patterns then add failure transitions (Aho-Corasick).
+// all transitions are precomputed so matching is one table lookup per character
+// dict gives next node along failure chain which ends some pattern
+
+void jhcRecoFix::build ()
+{
+  int *fail, *q;
+  const char *p;
+  int i, k, s, t, f, qn = 0, qi = 0;
+
+  // start with just root
+  for (k = 0; k < nsym; k++)
+    go[k] = -1;
+  hit[0] = -1;
+  nn = 1;
+
+  // add each pattern (first rule wins if duplicates)
+  for (i = 0; i < nr; i++)
+  {
+    s = 0;
+    for (p = pat[i]; *p != '\0'; p++)
+    {
+      k = s * nsym + sym(*p);
+      if (go[k] < 0)
+      {
+        for (t = 0; t < nsym; t++)
+          go[nn * nsym + t] = -1;
+        hit[nn] = -1;
+        go[k] = nn++;
+      }
+      s = go[k];
+    }
+    if (hit[s] < 0)
+      hit[s] = i;
+  }
+
+  // breadth first so failure target of each node already complete
+  fail = new int [nn];
+  q = new int [nn];
+  fail[0] = 0;
+  dict[0] = 0;
+  for (k = 0; k < nsym; k++)
+    if ((t = go[k]) < 0)
+      go[k] = 0;
+    else
+    {
+      fail[t] = 0;
+      dict[t] = 0;
+      q[qn++] = t;
+    }
+  while (qi < qn)
+  {
+    s = q[qi++];
+    for (k = 0; k < nsym; k++)
+      if ((t = go[s * nsym + k]) < 0)
+        go[s * nsym + k] = go[fail[s] * nsym + k];
+      else
+      {
+        f = go[fail[s] * nsym + k];
+        fail[t] = f;
+        dict[t] = ((hit[f] >= 0) ? f : dict[f]);
+        q[qn++] = t;
+      }
+  }
+  delete [] q;
+  delete [] fail;
+}
+
+
+//= Convert character to automaton input symbol (case-insensitive).
+
+int jhcRecoFix::sym (char c)
+{
+  int v = tolower((unsigned char) c);
+
+  if ((v >= 'a') && (v <= 'z'))
+    return(v - 'a' + 1);
+  if ((v >= '0') && (v <= '9'))
+    return(v - '0' + 27);
+  if ((v == ' ') || (v == '\t'))
+    return 37;
+  if (v == '.')
+    return 38;
+  if (v == '\'')
+    return 39;
+  if (v == '-')
+    return 40;
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Copy source to destination with all substitutions made.
+// first recompiles if map files have changed
+// keeps final period of text even if pattern swallowed it
+// returns number of substitutions
+
+int jhcRecoFix::Fix (char *dest, const char *src, int ssz)
+{
+  const char *sub;
+  int i, n, len, d = 0, pos = 0;
+
+  if (changed() > 0)
+    compile();
+  n = find_matches(src);
+  for (i = 0; i < n; i++)
+  {
+    d = append(dest, d, ssz, src + pos, ms[i] - pos);
+    sub = rep[mr[i]];
+    len = (int) strlen(sub);
+    d = append(dest, d, ssz, sub, len);
+    pos = me[i];
+    if ((src[pos] == '\0') && (src[pos - 1] == '.') && ((len <= 0) || (sub[len - 1] != '.')))
+      d = append(dest, d, ssz, ".", 1);
+  }
+  append(dest, d, ssz, src + pos, (int) strlen(src + pos));
+  return n;
+}
+
+
+//= Scan text once and find non-overlapping whole word matches.
+// at each position takes longest valid match ending there, which replaces
+// any earlier matches it contains but not one it only partially overlaps
+// returns number of matches (in ms, me, and mr arrays)
+
+int jhcRecoFix::find_matches (const char *txt)
+{
+  int i, j, m, r, st, n = (int) strlen(txt), s = 0, cnt = 0;
+
+  // make sure enough space for matches
+  if ((nr <= 0) || (n <= 0))
+    return 0;
+  if (n > mmax)
+  {
+    delete [] mr;
+    delete [] me;
+    delete [] ms;
+    mmax = n;
+    ms = new int [mmax];
+    me = new int [mmax];
+    mr = new int [mmax];
+  }
+
+  // advance automaton one character at a time
+  for (i = 0; i < n; i++)
+  {
+    s = go[s * nsym + sym(txt[i])];
+    for (m = ((hit[s] >= 0) ? s : dict[s]); m > 0; m = dict[m])
+    {
+      // check that pattern is a whole word here
+      r = hit[m];
+      st = i + 1 - plen[r];
+      if (word_ok(txt, st, i + 1, r) <= 0)
+        continue;
+
+      // drop earlier matches inside this one (unless partial overlap)
+      for (j = cnt; j > 0; j--)
+        if (st > ms[j - 1])
+          break;
+      if ((j > 0) && (st < me[j - 1]))
+        break;
+      ms[j] = st;
+      me[j] = i + 1;
+      mr[j] = r;
+      cnt = j + 1;
+      break;
+    }
+  }
+  return cnt;
+}
+
+
+//= Check that match from s up to e is not part of a larger word.
+// also checks capitalization of following word for some built-in fixups
+// these also match at end of text or just before punctuation (e.g. "Dr.,")
+// returns 1 if valid, 0 if not
+
+int jhcRecoFix::word_ok (const char *txt, int s, int e, int r) const
+{
+  const char *nxt = txt + e;
+
+  // boundaries
+  if ((s > 0) && isalnum((unsigned char) txt[s - 1]) && isalnum((unsigned char) txt[s]))
+    return 0;
+  if (isalnum((unsigned char) txt[e - 1]) && isalnum((unsigned char) *nxt))
+    return 0;
+  if (cap[r] == NULL)
+    return 1;
+
+  // no following word at all is fine
+  if ((*nxt == '\0') || ispunct((unsigned char) *nxt))
+    return 1;
+
+  // next word must not be a name (except for allowed initials)
+  if (*nxt != ' ')
+    return 0;
+  while (*nxt == ' ')
+    nxt++;
+  if (isupper((unsigned char) *nxt) && (strchr(cap[r], *nxt) == NULL))
+    return 0;
+  return 1;
+}
+
+
+//= Add up to n characters of text to destination at offset d (always terminated).
+// returns new offset
+
+int jhcRecoFix::append (char *dest, int d, int ssz, const char *txt, int n)
+{
+  int i;
+
+  for (i = 0; (i < n) && (d < (ssz - 1)); i++)
+    dest[d++] = txt[i];
+  dest[d] = '\0';
+  return d;
+}
@@ -0,0 +1,97 @@
+// jhcRecoFix.h : corrects commonly misheard words in recognition results
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Corrects commonly misheard words in recognition results.
+// substitutions come from config/misheard.map (variants indented under "= Target")
+// and config/pronounce.map (re-spelling after word, mapped back to the word)
+// all patterns are compiled into one Aho-Corasick automaton so text is fixed
+// in a single pass no matter how many entries there are
+// matches are case-insensitive whole words, longest leftmost one wins
+// maps are recompiled automatically when either file changes
+
+class jhcRecoFix
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int nsym = 41;          // letters, digits, space, . ' - and other
+
+  // substitution rules (pattern, replacement, allowed capitals in next word)
+  char **pat, **rep;
+  const char **cap;
+  int *plen, nr;
+
+  // automaton transitions, rule ending at each node, and next shorter match
+  int *go, *hit, *dict;
+  int nn;
+
+  // non-overlapping matches found (start, end, rule)
+  int *ms, *me, *mr, mmax;
+
+  // map files, their modification times, and last check (ms)
+  char dir[200];
+  long long t0[2];
+  unsigned long chk;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // how often to look for changed map files (ms)
+  int poll;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcRecoFix ();
+  jhcRecoFix ();
+  int Load (const char *path);
+  int Rules () const {return nr;}
+
+  // main functions
+  int Fix (char *dest, const char *src, int ssz);
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // creation and initialization
+  void dealloc ();
+  int changed ();
+  static long long mod_time (const char *fn);
+
+  // compilation
+  int compile ();
+  int read_maps (int fill);
+  int read_misheard (const char *fn, int fill);
+  int read_pronounce (const char *fn, int fill);
+  int add_rule (const char *p, const char *r, const char *c, int fill);
+  void build ();
+  static int sym (char c);
+
+  // main functions
+  int find_matches (const char *txt);
+  int word_ok (const char *txt, int s, int e, int r) const;
+  static int append (char *dest, int d, int ssz, const char *txt, int n);
+
+};
@@ -0,0 +1,466 @@
+// jhcRecoLocal.cpp : offline speech recognition using whisper.cpp
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+// NOTE: needs whisper.cpp library and a model (https://github.com/ggerganov/whisper.cpp)
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include "jhcRecoLocal.h"
+
+#ifdef SPIO_LOCAL
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+#include <thread>
+
+#include "whisper.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcRecoLocal::~jhcRecoLocal ()
+{
+  int i;
+
+  Stop();
+  for (i = 0; i < jmax; i++)
+    delete [] jsnd[i];
+  delete [] pcm;
+  delete [] snd;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcRecoLocal::jhcRecoLocal ()
+{
+  int i;
+
+  // buffers and state
+  snd = new short [umax];
+  pcm = new float [umax];
+  for (i = 0; i < jmax; i++)
+    jsnd[i] = new short [umax];
+  nsnd = 0;
+  jhead = 0;
+  jtail = 0;
+  jlost = -1;
+  jlk = 0;
+  ctx = NULL;
+  run = 0;
+  drun = 0;
+  *prompt = '\0';
+  *hold = '\0';
+  hconf = 0.0f;
+  tok = 0;
+
+  // segmentation parameters
+  pre   = 300;               // catch soft word starts
+  early = 200;               // well before end of pause
+
+  // decoder (also spots wake word)
+  nthr = 4;
+  kws = 1;
+}
+
+
+//= Load model and start listening to microphone.
+// spec is "local" followed by model file name (relative to dir unless absolute)
+// returns 1 if successful, 0 if no microphone, neg for bad model
+
+int jhcRecoLocal::Start (const char *dir, const char *spec, int prog)
+{
+  struct whisper_context_params cp = whisper_context_default_params();
+  char tag[40] = "", model[200] = "", fn[500];
+
+  // can only be called once
+  if (ctx != NULL)
+    return -4;
+  show = prog;
+
+  // find model file
+  if ((sscanf(spec, "%39s %199s", tag, model) != 2) || (strcmp(tag, "local") != 0))
+    return -2;                                                 // bad format
+  if ((*model == '/') || (*model == '\\') || (strchr(model, ':') != NULL))
+    snprintf(fn, 500, "%s", model);
+  else
+    snprintf(fn, 500, "%s/%s", ((dir == NULL) ? "." : dir), model);
+  if ((ctx = (void *) whisper_init_from_file_with_params(fn, cp)) == NULL)
+    return -3;                                                 // bad model
+
+  // bias toward proper spellings of names
+  LoadNames(dir);
+
+  // start decoding and listening threads
+  if (mic.Open(rate) <= 0)
+    return 0;
+  jhead = 0;
+  jtail = 0;
+  jlost = -1;
+  drun = 1;
+  pthread_create(&dbg, NULL, decode_loop, this);
+  run = 1;
+  pthread_create(&bg, NULL, listen_loop, this);
+  return 1;
+}
+
+
+//= Stop listening and release decoder.
+
+void jhcRecoLocal::Stop ()
+{
+  if (run > 0)
+  {
+    run = 0;
+    pthread_join(bg, NULL);
+  }
+  if (drun > 0)
+  {
+    drun = 0;
+    pthread_join(dbg, NULL);
+  }
+  mic.Close();
+  if (ctx != NULL)
+    whisper_free((struct whisper_context *) ctx);
+  ctx = NULL;
+  reco = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Configuration                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Add a particular name to decoder prompt to increase likelihood of correct spelling.
+// prompt is copied fresh for each utterance so can be called anytime
+// returns 1 if added, 0 if no space left
+
+int jhcRecoLocal::AddName (const char *name)
+{
+  std::lock_guard<std::mutex> guard(plock);
+  int n = (int) strlen(prompt);
+
+  if ((name == NULL) || (*name == '\0'))
+    return 0;
+  if ((n + (int) strlen(name) + 3) >= 1000)
+    return 0;
+  if (n > 0)
+    strcat(prompt, ", ");
+  strcat(prompt, name);
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Listening                               //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for microphone processing.
+
+pthread_ret jhcRecoLocal::listen_loop (void *eng)
+{
+  ((jhcRecoLocal *) eng)->run_listen();
+  return 0;
+}
+
+
+//= Collect audio into utterances found by voice activity detector.
+// keeps a little audio before onset so soft word starts are not lost
+// asks for decode partway through pause so result is ready as soon as pause ends
+// never waits for decoder so microphone buffers cannot overrun
+
+void jhcRecoLocal::run_listen ()
+{
+  short *f;
+  unsigned long now;
+  int keep = (pre * rate) / 1000, trial = 0, live = 1, ev;
+
+  vad.Reset(rate);
+  nsnd = 0;
+  while (run > 0)
+  {
+    // get next frame
+    f = snd + nsnd;
+    if (mic.Read(f, fsz) <= 0)
+    {
+      net_lost();                                              // lost microphone
+      break;
+    }
+    nsnd += fsz;
+    now = Now();
+    ev = vad.Frame(f, fsz, now);
+    if ((ev <= 0) && (vad.Talking() > 0) && ((nsnd + fsz) > umax))
+      ev = vad.Finish();                                       // too long
+
+    // handle speech start and end
+    if (ev == 1)
+    {
+      // fully recognize only if awake when speech started
+      if ((live = awake(now)) > 0)
+        add_job(1);
+      trial = 0;
+    }
+    else if (ev == 2)
+    {
+      if (live > 0)
+        add_job(3, trial);
+      else if ((int)(vad.Offset() - vad.Onset()) <= wmax)
+        add_job(4);                                            // might be name
+      nsnd = 0;
+    }
+    else if (ev < 0)
+    {
+      add_job(0);                                              // just a noise burst
+      nsnd = 0;
+    }
+    else if (vad.Talking() <= 0)
+    {
+      // only retain a little pre-roll
+      if (nsnd > keep)
+      {
+        memmove(snd, snd + (nsnd - keep), keep * sizeof(short));
+        nsnd = keep;
+      }
+    }
+    else if (vad.Quiet() <= 0)
+      trial = 0;                                               // more speech
+    else if ((live > 0) && (early > 0) && (trial == 0) && (vad.Quiet() >= early) && (vad.Voiced() >= vad.vmin))
+      trial = ((add_job(2) > 0) ? 1 : -1);                     // speculative decode
+  }
+}
+
+
+//= Queue a request for the decoder thread along with a copy of utterance so far.
+// trial says whether final result can reuse trial decode (no speech since)
+// if end of utterance cannot be queued then decoder resolves status there
+// returns 1 if queued, 0 if decoder too far behind
+
+int jhcRecoLocal::add_job (int kind, int trial)
+{
+  int i = jtail, n = (((kind >= 2) && (kind <= 4)) ? nsnd : 0);
+
+  if (((i + 1) % jmax) == jhead)
+  {
+    if (((kind == 0) || (kind == 3)) && (jlost < 0))
+    {
+      jlk = kind;
+      jlost = i;
+    }
+    return 0;
+  }
+  jkind[i] = kind;
+  jlen[i] = n;
+  jtry[i] = trial;
+  jon[i] = vad.Onset();
+  joff[i] = vad.Offset();
+  if (n > 0)
+    memcpy(jsnd[i], snd, n * sizeof(short));
+  jtail = (i + 1) % jmax;
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Decoding                                //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for decoding utterances.
+
+pthread_ret jhcRecoLocal::decode_loop (void *eng)
+{
+  ((jhcRecoLocal *) eng)->run_decode();
+  return 0;
+}
+
+
+//= Handle requests from listening thread in order, reporting all results.
+// this is the only thread that posts partial and final results
+// a dropped final counts as unintelligible once earlier jobs are done
+
+void jhcRecoLocal::run_decode ()
+{
+  int i;
+
+  while (drun > 0)
+  {
+    // resolve any utterance whose end was lost at this point in queue
+    i = jhead;
+    if (jlost == i)
+    {
+      if (jlk == 3)
+        heard_none();
+      else
+        reco = 0;
+      jlost = -1;
+    }
+
+    // wait for something to do
+    if (i == jtail)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+
+    // dispatch on kind of request
+    if (jkind[i] == 1)
+    {
+      tok = 0;
+      heard_part(NULL);
+    }
+    else if (jkind[i] == 2)
+    {
+      // speculatively decode a little way into pause (shown as partial)
+      tok = ((decode(hold, 500, hconf, jsnd[i], jlen[i]) > 0) ? 1 : -1);
+      if (tok > 0)
+        heard_part(hold);
+    }
+    else if (jkind[i] == 3)
+      post_utt(i);
+    else if (jkind[i] == 4)
+      wake_utt(i);
+    else
+      reco = 0;
+    jhead = (i + 1) % jmax;
+  }
+}
+
+
+//= Decode finished utterance (unless trial is still valid) and post result.
+// uses precise speech onset and offset times from VAD
+
+void jhcRecoLocal::post_utt (int i)
+{
+  int ok = 1;
+
+  if ((jtry[i] <= 0) || (tok <= 0))
+    if ((ok = decode(hold, 500, hconf, jsnd[i], jlen[i])) < 0)
+      ok = 0;
+  if (ok > 0)
+    heard_all(hold, jon[i], joff[i], hconf);
+  else
+    heard_none();                                              // unintelligible
+  stay_awake(Now());
+  tok = 0;
+}
+
+
+//= Check whether short utterance heard while asleep mentions robot name.
+// posted as a normal result if robot addressed
+
+void jhcRecoLocal::wake_utt (int i)
+{
+  tok = 0;
+  if ((decode(hold, 500, hconf, jsnd[i], jlen[i]) <= 0) || (has_wake(hold) <= 0))
+    return;
+  stay_awake(Now());
+  heard_all(hold, jon[i], joff[i], hconf);
+}
+
+
+//= Run local recognizer on n samples of an utterance.
+// confidence is mean token probability
+// returns 1 if some text, 0 if only noise annotations, -1 for decoder error
+
+int jhcRecoLocal::decode (char *res, int ssz, float& conf, const short *wav, int n)
+{
+  struct whisper_context *wc = (struct whisper_context *) ctx;
+  struct whisper_full_params wp = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+  char txt[500] = "", names[1000];
+  float psum = 0.0f;
+  int i, j, len, ns, nt, cnt = 0;
+
+  // get consistent copy of names (AddName may be running)
+  plock.lock();
+  strcpy(names, prompt);
+  plock.unlock();
+
+  // convert samples to float
+  for (i = 0; i < n; i++)
+    pcm[i] = wav[i] / 32768.0f;
+
+  // English only, no timestamps, no console output
+  wp.language         = "en";
+  wp.translate        = false;
+  wp.no_context       = true;
+  wp.no_timestamps    = true;
+  wp.single_segment   = false;
+  wp.print_progress   = false;
+  wp.print_realtime   = false;
+  wp.print_timestamps = false;
+  wp.print_special    = false;
+  wp.suppress_blank   = true;
+  wp.n_threads        = nthr;
+  wp.initial_prompt   = ((*names != '\0') ? names : NULL);
+  if (whisper_full(wc, wp, pcm, n) != 0)
+    return -1;
+
+  // concatenate all segments and average token probabilities
+  ns = whisper_full_n_segments(wc);
+  for (i = 0; i < ns; i++)
+  {
+    len = (int) strlen(txt);
+    snprintf(txt + len, 500 - len, "%s", whisper_full_get_segment_text(wc, i));
+    nt = whisper_full_n_tokens(wc, i);
+    for (j = 0; j < nt; j++, cnt++)
+      psum += whisper_full_get_token_p(wc, i, j);
+  }
+
+  // check that something besides noise annotations
+  conf = ((cnt > 0) ? psum / cnt : 0.0f);
+  if (clean_text(res, txt, ssz) <= 0)
+    return 0;
+  return 1;
+}
+
+
+//= Remove bracketed annotations (e.g. "[BLANK_AUDIO]") and extra spaces.
+// returns length of remaining text
+
+int jhcRecoLocal::clean_text (char *dest, const char *src, int ssz) const
+{
+  const char *s = src;
+  int depth = 0, n = 0;
+
+  while ((*s != '\0') && (n < (ssz - 1)))
+  {
+    if ((*s == '[') || (*s == '('))
+      depth++;
+    else if (((*s == ']') || (*s == ')')) && (depth > 0))
+      depth--;
+    else if ((depth <= 0) && (!isspace((unsigned char) *s) || ((n > 0) && (dest[n - 1] != ' '))))
+      dest[n++] = (isspace((unsigned char) *s) ? ' ' : *s);
+    s++;
+  }
+  while ((n > 0) && (dest[n - 1] == ' '))
+    n--;
+  dest[n] = '\0';
+  return n;
+}
+
+
+#endif  // SPIO_LOCAL
@@ -0,0 +1,134 @@
+// jhcRecoLocal.h : offline speech recognition using whisper.cpp
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "jhc_pthread.h"
+
+#include "jhcAudioIn.h"
+#include "jhcRecoEngine.h"
+
+
+// always available under Linux, optional for Windows (needs whisper.lib)
+
+#if defined(__linux__) && !defined(SPIO_LOCAL)
+  #define SPIO_LOCAL
+#endif
+
+
+//= Offline speech recognition using whisper.cpp.
+// listens to microphone on own thread and cuts out utterances with VAD
+// each utterance is decoded locally (no network) once speaker pauses
+// decoding runs on a second thread fed by a queue so microphone never stalls
+// trial decode early in pause gives partial result, reused if no more speech
+// when gated by wake word only short utterances are decoded (to look for name)
+// names are passed as decoder prompt which biases toward their spellings
+// spec from key file is "local <model file>" (e.g. "local models/ggml-base.en.bin")
+
+class jhcRecoLocal : public jhcRecoEngine
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int rate = 16000;       // whisper requires 16 kHz
+  static const int fsz  = 320;         // 20 ms analysis frame
+  static const int umax = 15 * rate;   // longest utterance
+  static const int jmax = 4;           // pending decoder jobs
+
+  // audio source and decoder
+  jhcAudioIn mic;
+  void *ctx;
+
+  // names for decoder prompt (changed by control, read by decoder)
+  char prompt[1000];
+  std::mutex plock;
+
+  // current utterance (listening thread only)
+  short *snd;
+  int nsnd;
+
+  // jobs for decoder: kind (0 = noise, 1 = onset, 2 = trial, 3 = final,
+  // 4 = wake check), copied audio, speech times, and whether trial still valid
+  short *jsnd[jmax];
+  int jkind[jmax], jlen[jmax], jtry[jmax];
+  unsigned long jon[jmax], joff[jmax];
+  std::atomic<int> jhead, jtail;
+
+  // slot where an utterance end was dropped (queue full) and kind of job
+  std::atomic<int> jlost;
+  int jlk;
+
+  // decoder input, trial decode result, and its confidence (decoder thread only)
+  float *pcm;
+  char hold[500];
+  float hconf;
+  int tok;
+
+  // listening and decoding threads
+  pthread_t bg, dbg;
+  int run, drun;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // audio kept before speech onset (ms)
+  int pre;
+
+  // silence before trial decode (ms), 0 = only decode at end
+  int early;
+
+  // decoder threads
+  int nthr;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcRecoLocal ();
+  jhcRecoLocal ();
+  int Start (const char *dir, const char *spec, int prog =0);
+  void Stop ();
+
+  // configuration
+  int AddName (const char *name);
+  void Mute (int doit) {mic.Mute(doit);}
+  void Echo (const jhcAudioOut *spk) {mic.Echo(spk);}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // listening
+  static pthread_ret listen_loop (void *eng);
+  void run_listen ();
+  int add_job (int kind, int trial =0);
+
+  // decoding
+  static pthread_ret decode_loop (void *eng);
+  void run_decode ();
+  void post_utt (int i);
+  void wake_utt (int i);
+  int decode (char *res, int ssz, float& conf, const short *wav, int n);
+  int clean_text (char *dest, const char *src, int ssz) const;
+
+};
@@ -0,0 +1,277 @@
+// jhcRecoStub.cpp : stand-in recognizer for timing tests with WAV files
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#ifndef __linux__
+  #include <windows.h>
+#endif
+
+#include "jhcRecoStub.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcRecoStub::~jhcRecoStub ()
+{
+  Stop();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcRecoStub::jhcRecoStub ()
+{
+  src = NULL;
+  nlog = 0;
+  jhead = 0;
+  jtail = 0;
+  jlost = -1;
+  jlk = 0;
+  run = 0;
+  drun = 0;
+
+  // roughly a small local model
+  cost = 150;
+  rtf = 0.1;
+
+  // transcripts can be checked for robot name
+  kws = 1;
+}
+
+
+//= Start listening to file source given earlier.
+// spec is "stub" optionally followed by decode cost (ms) and real time factor
+// returns 1 if successful, 0 if no source, neg for bad spec
+
+int jhcRecoStub::Start (const char *dir, const char *spec, int prog)
+{
+  char tag[40] = "";
+
+  // can only be called once
+  if (run > 0)
+    return -4;
+  show = prog;
+
+  // get decode timing
+  if ((spec == NULL) || (sscanf(spec, "%39s %d %lf", tag, &cost, &rtf) < 1) || (strcmp(tag, "stub") != 0))
+    return -2;
+
+  // start decoding and listening threads
+  if ((src == NULL) || (src->Open(rate) <= 0))
+    return 0;
+  nlog = 0;
+  jhead = 0;
+  jtail = 0;
+  jlost = -1;
+  drun = 1;
+  pthread_create(&dbg, NULL, decode_loop, this);
+  run = 1;
+  pthread_create(&bg, NULL, listen_loop, this);
+  return 1;
+}
+
+
+//= Stop listening and decoding.
+
+void jhcRecoStub::Stop ()
+{
+  if (run > 0)
+  {
+    run = 0;
+    pthread_join(bg, NULL);
+  }
+  if (drun > 0)
+  {
+    drun = 0;
+    pthread_join(dbg, NULL);
+  }
+  if (src != NULL)
+    src->Close();
+  reco = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Listening                               //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for file source processing.
+
+pthread_ret jhcRecoStub::listen_loop (void *eng)
+{
+  ((jhcRecoStub *) eng)->run_listen();
+  return 0;
+}
+
+
+//= Cut audio into utterances with voice activity detector and queue transcripts.
+// play whose speech started the utterance supplies the text
+// never waits for decoder so file source keeps real time pacing
+
+void jhcRecoStub::run_listen ()
+{
+  short f[fsz];
+  unsigned long now;
+  int p = 0, live = 1, ev;
+
+  vad.Reset(rate);
+  while (run > 0)
+  {
+    // get next frame
+    if (src->Read(f, fsz) <= 0)
+    {
+      net_lost();
+      break;
+    }
+    now = Now();
+    ev = vad.Frame(f, fsz, now);
+
+    // handle speech start and end
+    if (ev == 1)
+    {
+      p = src->Playing();
+      if ((live = awake(now)) > 0)
+        add_job(1);
+    }
+    else if (ev == 2)
+      add_job(3, p, live, now);
+    else if (ev < 0)
+      add_job(0);                                              // just a noise burst
+  }
+}
+
+
+//= Queue a request for the decoder thread along with utterance details.
+// if end of utterance cannot be queued then decoder resolves status there
+// returns 1 if queued, 0 if decoder too far behind
+
+int jhcRecoStub::add_job (int kind, int p, int live, unsigned long det)
+{
+  int i = jtail;
+
+  if (((i + 1) % jmax) == jhead)
+  {
+    if (((kind == 0) || (kind == 3)) && (jlost < 0))
+    {
+      jlk = kind;
+      jlost = i;
+    }
+    return 0;
+  }
+  jkind[i] = kind;
+  jplay[i] = p;
+  jlive[i] = live;
+  jon[i] = vad.Onset();
+  joff[i] = vad.Offset();
+  jdet[i] = det;
+  jtail = (i + 1) % jmax;
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Decoding                                //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for simulated decoding.
+
+pthread_ret jhcRecoStub::decode_loop (void *eng)
+{
+  ((jhcRecoStub *) eng)->run_decode();
+  return 0;
+}
+
+
+//= Handle requests from listening thread in order, reporting all results.
+// this is the only thread that posts partial and final results
+// a dropped final counts as unintelligible once earlier jobs are done
+
+void jhcRecoStub::run_decode ()
+{
+  int i;
+
+  while (drun > 0)
+  {
+    // resolve any utterance whose end was lost at this point in queue
+    i = jhead;
+    if (jlost == i)
+    {
+      if (jlk == 3)
+        heard_none();
+      else
+        reco = 0;
+      jlost = -1;
+    }
+
+    // wait for something to do
+    if (i == jtail)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+
+    // dispatch on kind of request
+    if (jkind[i] == 1)
+      heard_part(NULL);
+    else if (jkind[i] == 3)
+      post_utt(i);
+    else
+      reco = 0;
+    jhead = (i + 1) % jmax;
+  }
+}
+
+
+//= Simulate decoding then post transcript and log timing.
+// when asleep only short utterances mentioning robot name are posted
+
+void jhcRecoStub::post_utt (int i)
+{
+  const char *txt = src->Label(jplay[i]);
+  int len = (int)(joff[i] - jon[i]), n = nlog;
+
+  // ignore if not addressed
+  if ((jlive[i] <= 0) && ((len > wmax) || (has_wake(txt) <= 0)))
+    return;
+
+  // pretend to run decoder
+  std::this_thread::sleep_for(std::chrono::milliseconds(cost + (int)(rtf * len)));
+  if (n < lmax)
+  {
+    lplay[n] = jplay[i];
+    ldet[n] = jdet[i];
+    lpost[n] = Now();
+    nlog = n + 1;                                              // before reader sees result
+  }
+  heard_all(txt, jon[i], joff[i]);
+  stay_awake(Now());
+}
@@ -0,0 +1,113 @@
+// jhcRecoStub.h : stand-in recognizer for timing tests with WAV files
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+#include "jhc_pthread.h"
+
+#include "jhcAudioFile.h"
+#include "jhcRecoEngine.h"
+
+
+//= Stand-in recognizer for timing tests with WAV files.
+// same listening loop and VAD endpointing as the local engine but reads from
+// a file source and "decodes" by waiting then reporting the clip transcript
+// decoding runs on a second thread fed by a queue so source never stalls
+// decode time is a fixed cost plus a fraction of the utterance length
+// logs when each utterance was endpointed and posted (and for which play)
+// spec is "stub [<cost ms> [<real time factor>]]" (e.g. "stub 150 0.1")
+
+class jhcRecoStub : public jhcRecoEngine
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int rate = 16000;       // same as local engine
+  static const int fsz  = 320;         // 20 ms analysis frame
+  static const int lmax = 1000;        // most utterances logged
+  static const int jmax = 4;           // pending decoder jobs
+
+  // audio source
+  jhcAudioFile *src;
+
+  // per-utterance log: play, endpoint time, and post time (ms)
+  int lplay[lmax];
+  unsigned long ldet[lmax], lpost[lmax];
+  std::atomic<int> nlog;
+
+  // jobs for decoder: kind (0 = noise, 1 = onset, 3 = final), play,
+  // whether awake, speech times, and endpoint time
+  int jkind[jmax], jplay[jmax], jlive[jmax];
+  unsigned long jon[jmax], joff[jmax], jdet[jmax];
+  std::atomic<int> jhead, jtail;
+
+  // slot where an utterance end was dropped (queue full) and kind of job
+  std::atomic<int> jlost;
+  int jlk;
+
+  // listening and decoding threads
+  pthread_t bg, dbg;
+  int run, drun;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // fixed decode time (ms) and extra per ms of utterance
+  int cost;
+  double rtf;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcRecoStub ();
+  jhcRecoStub ();
+  void Source (jhcAudioFile *s) {src = s;}
+  int Start (const char *dir, const char *spec, int prog =0);
+  void Stop ();
+
+  // configuration
+  int AddName (const char *name) {return 1;}
+  void Mute (int doit) {if (src != NULL) src->Mute(doit);}
+  void Echo (const jhcAudioOut *spk) {if (src != NULL) src->Echo(spk);}
+
+  // utterance log
+  int Logged () const {return nlog;}
+  int LogPlay (int i) const {return(((i >= 0) && (i < nlog)) ? lplay[i] : -1);}
+  unsigned long LogEnd (int i) const  {return(((i >= 0) && (i < nlog)) ? ldet[i] : 0);}
+  unsigned long LogPost (int i) const {return(((i >= 0) && (i < nlog)) ? lpost[i] : 0);}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // listening
+  static pthread_ret listen_loop (void *eng);
+  void run_listen ();
+  int add_job (int kind, int p =0, int live =0, unsigned long det =0);
+
+  // decoding
+  static pthread_ret decode_loop (void *eng);
+  void run_decode ();
+  void post_utt (int i);
+
+};
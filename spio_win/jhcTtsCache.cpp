@@ -0,0 +1,237 @@
+// jhcTtsCache.cpp : least recently used store of synthesized phrases
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <string.h>
+
+#include "jhcTtsCache.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcTtsCache::~jhcTtsCache ()
+{
+  Clear();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcTtsCache::jhcTtsCache ()
+{
+  nc = 0;
+  tick = 0;
+  total = 0;
+  bmax = 32000000;           // about 15 minutes at 16 kHz
+}
+
+
+//= Get rid of all stored clips (none should be pinned).
+
+void jhcTtsCache::Clear ()
+{
+  std::lock_guard<std::mutex> hold(lock);
+
+  while (nc > 0)
+    drop(nc - 1);
+}
+
+
+//= Build lookup key from voice name and text of phrase.
+// ignores case, punctuation, and spacing but notes if question (intonation)
+// returns length of key
+
+int jhcTtsCache::MakeKey (char *key, int ksz, const char *txt, const char *voice)
+{
+  const char *s;
+  int n = 0, q = 0;
+
+  // voice name first
+  for (s = voice; (s != NULL) && (*s != '\0') && (n < (ksz - 3)); s++)
+    key[n++] = *s;
+  key[n++] = '|';
+
+  // words in lowercase with single spaces (room for space, letter, '?', and end)
+  for (s = txt; (*s != '\0') && (n < (ksz - 3)); s++)
+    if (isalnum((unsigned char) *s) || (*s == '\''))
+    {
+      if ((q > 0) && (key[n - 1] != '|'))
+        key[n++] = ' ';
+      key[n++] = (char) tolower((unsigned char) *s);
+      q = 0;
+    }
+    else
+      q = 1;
+
+  // mark questions
+  while ((s > txt) && isspace((unsigned char) s[-1]))
+    s--;
+  if ((s > txt) && (s[-1] == '?'))
+    key[n++] = '?';
+  key[n] = '\0';
+  return n;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Tell if some phrase is already stored.
+
+int jhcTtsCache::Has (const char *key)
+{
+  std::lock_guard<std::mutex> hold(lock);
+
+  return((find(key) >= 0) ? 1 : 0);
+}
+
+
+//= Get stored clip for key (if any) and pin it until released.
+// returns NULL if not found
+
+jhcTtsClip *jhcTtsCache::Grab (const char *key)
+{
+  std::lock_guard<std::mutex> hold(lock);
+  int i;
+
+  if ((i = find(key)) < 0)
+    return NULL;
+  pin[i] += 1;
+  used[i] = ++tick;
+  return clip[i];
+}
+
+
+//= Allow a previously grabbed clip to be evicted again.
+
+void jhcTtsCache::Release (const jhcTtsClip *c)
+{
+  std::lock_guard<std::mutex> hold(lock);
+  int i;
+
+  for (i = 0; i < nc; i++)
+    if (clip[i] == c)
+    {
+      if (pin[i] > 0)
+        pin[i] -= 1;
+      return;
+    }
+}
+
+
+//= Store a new clip (cache takes ownership).
+// replaces any clip with same key, evicts least recently used if needed
+// returns 1 if added, 0 if no room (clip deleted)
+
+int jhcTtsCache::Add (jhcTtsClip *c)
+{
+  std::lock_guard<std::mutex> hold(lock);
+  int i;
+
+  // get rid of old version (if not in use)
+  if ((i = find(c->key)) >= 0)
+  {
+    if (pin[i] > 0)
+    {
+      delete c;
+      return 0;
+    }
+    drop(i);
+  }
+
+  // make space then add at end
+  if (evict(c->Bytes()) <= 0)
+  {
+    delete c;
+    return 0;
+  }
+  clip[nc] = c;
+  pin[nc] = 0;
+  used[nc] = ++tick;
+  total += c->Bytes();
+  nc++;
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                           Helper Functions                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get index of clip with given key, -1 if none.
+// NOTE: expects lock to be held by caller
+
+int jhcTtsCache::find (const char *key) const
+{
+  int i;
+
+  for (i = 0; i < nc; i++)
+    if (strcmp(clip[i]->key, key) == 0)
+      return i;
+  return -1;
+}
+
+
+//= Remove least recently used unpinned clips until new one fits.
+// returns 1 if enough space, 0 if everything remaining is pinned
+// NOTE: expects lock to be held by caller
+
+int jhcTtsCache::evict (long need)
+{
+  int i, old;
+
+  while ((nc >= cmax) || ((nc > 0) && ((total + need) > bmax)))
+  {
+    old = -1;
+    for (i = 0; i < nc; i++)
+      if ((pin[i] <= 0) && ((old < 0) || (used[i] < used[old])))
+        old = i;
+    if (old < 0)
+      return 0;
+    drop(old);
+  }
+  return 1;
+}
+
+
+//= Delete a clip and close up the gap in the list.
+// NOTE: expects lock to be held by caller
+
+void jhcTtsCache::drop (int i)
+{
+  int j;
+
+  total -= clip[i]->Bytes();
+  delete clip[i];
+  nc--;
+  for (j = i; j < nc; j++)
+  {
+    clip[j] = clip[j + 1];
+    pin[j]  = pin[j + 1];
+    used[j] = used[j + 1];
+  }
+}
@@ -0,0 +1,86 @@
+// jhcTtsCache.h : least recently used store of synthesized phrases
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <mutex>
+
+#include "jhcTtsClip.h"
+
+
+//= Least recently used store of synthesized phrases.
+// clips are found by a key made from normalized text and voice name
+// a clip being played is pinned so it will not be evicted underneath
+// safe to share between a synthesis thread and the main thread
+
+class jhcTtsCache
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int cmax = 256;         // most clips held
+
+  // clips with pin counts and last use
+  jhcTtsClip *clip[cmax];
+  int pin[cmax];
+  unsigned long used[cmax];
+  int nc;
+
+  // use counter and total audio size
+  unsigned long tick;
+  long total;
+
+  // access control
+  std::mutex lock;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // largest total audio size (bytes)
+  long bmax;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcTtsCache ();
+  jhcTtsCache ();
+  void Clear ();
+  static int MakeKey (char *key, int ksz, const char *txt, const char *voice);
+
+  // main functions
+  int Has (const char *key);
+  jhcTtsClip *Grab (const char *key);
+  void Release (const jhcTtsClip *c);
+  int Add (jhcTtsClip *c);
+
+  // statistics
+  int Count () const {return nc;}
+  long Bytes () const {return total;}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  int find (const char *key) const;
+  int evict (long need);
+  void drop (int i);
+
+};
@@ -0,0 +1,108 @@
+// jhcTtsClip.cpp : synthesized speech audio with viseme timeline
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "jhcTtsClip.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcTtsClip::~jhcTtsClip ()
+{
+  delete [] snd;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcTtsClip::jhcTtsClip ()
+{
+  snd = NULL;
+  n = 0;
+  sps = 16000;
+  nv = 0;
+  *key = '\0';
+}
+
+
+//= Copy in audio samples at given rate.
+// returns 1 if successful, 0 for problem
+
+int jhcTtsClip::SetAudio (const short *s, int cnt, int rate)
+{
+  delete [] snd;
+  snd = NULL;
+  n = 0;
+  if ((s == NULL) || (cnt <= 0))
+    return 0;
+  snd = new short [cnt];
+  memcpy(snd, s, cnt * sizeof(short));
+  n = cnt;
+  sps = rate;
+  return 1;
+}
+
+
+//= Add next mouth shape starting at given time (ms) in audio.
+// consecutive duplicates are merged, returns 0 if timeline full
+
+int jhcTtsClip::AddViseme (int ms, int id)
+{
+  if ((nv > 0) && (vid[nv - 1] == id))
+    return 1;
+  if (nv >= vmax)
+    return 0;
+  vt[nv] = ms;
+  vid[nv] = id;
+  nv++;
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Timeline                                //
+///////////////////////////////////////////////////////////////////////////
+
+//= Find mouth shape at some time (ms) from start of audio.
+// returns 0 (silence) before first viseme or after end of audio
+
+int jhcTtsClip::VisemeAt (int ms) const
+{
+  int lo = 0, hi = nv - 1, mid;
+
+  if ((nv <= 0) || (ms < vt[0]) || (ms >= Length()))
+    return 0;
+  while (lo < hi)
+  {
+    mid = (lo + hi + 1) / 2;
+    if (vt[mid] <= ms)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return vid[lo];
+}
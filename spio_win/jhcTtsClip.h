@@ -0,0 +1,71 @@
+// jhcTtsClip.h : synthesized speech audio with viseme timeline
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+
+//= Synthesized speech audio with viseme timeline.
+// holds 16 bit mono samples and the start time of each mouth shape
+// viseme numbers follow SAPI (0 = silence, 1-21 = shapes)
+
+class jhcTtsClip
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int vmax = 1000;        // max visemes in timeline
+
+  // audio samples
+  short *snd;
+  int n, sps;
+
+  // viseme start times (ms) and shapes
+  int vt[vmax], vid[vmax], nv;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // normalized text and voice used for lookup
+  char key[300];
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcTtsClip ();
+  jhcTtsClip ();
+  int SetAudio (const short *s, int cnt, int rate);
+  int AddViseme (int ms, int id);
+
+  // audio
+  const short *Audio () const {return snd;}
+  int Samples () const {return n;}
+  int Rate () const {return sps;}
+  int Length () const {return((sps > 0) ? (int)((1000LL * n) / sps) : 0);}
+  int Bytes () const {return(n * (int) sizeof(short));}
+
+  // timeline
+  int Visemes () const {return nv;}
+  int VisemeTime (int i) const {return(((i >= 0) && (i < nv)) ? vt[i] : -1);}
+  int VisemeShape (int i) const {return(((i >= 0) && (i < nv)) ? vid[i] : 0);}
+  int VisemeAt (int ms) const;
+
+};
@@ -0,0 +1,465 @@
+// jhcTtsEngine.cpp : common interface for text-to-speech backends
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+  #include <dirent.h>
+#else
+  #include <windows.h>
+  #include <io.h>
+#endif
+
+#include "jhcTtsEngine.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+// derived classes should call Done in their own destructors
+
+jhcTtsEngine::~jhcTtsEngine ()
+{
+  Done();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcTtsEngine::jhcTtsEngine ()
+{
+  now = NULL;
+  *pend = '\0';
+  pt0 = 0;
+  direct = 0;
+  run = 0;
+  *home = '\0';
+  warm = 0;
+  nreq = 0;
+  *vname = '\0';
+  sps = 16000;
+  wait = 3000;
+}
+
+
+//= Prepare backend and open speaker for phrases played from memory.
+// returns 1 if successful, 0 for problem
+
+int jhcTtsEngine::Init ()
+{
+  if (setup() <= 0)
+    return 0;
+  if (out.Open(sps) <= 0)
+    return 0;
+  return 1;
+}
+
+
+//= Render stock phrases found in KB2 operator files in the background.
+// returns 1 if started, 0 if already requested
+
+int jhcTtsEngine::Prewarm (const char *dir)
+{
+  if (warm > 0)
+    return 0;
+  strncpy(home, ((dir == NULL) ? "." : dir), 199);
+  home[199] = '\0';
+  warm = 1;
+  launch();
+  return 1;
+}
+
+
+//= Stop talking and background synthesis then release resources.
+
+void jhcTtsEngine::Done ()
+{
+  stop_all();
+  if (run > 0)
+  {
+    run = 0;
+    pthread_join(bg, NULL);
+  }
+  out.Close();
+  cache.Clear();
+  cleanup();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Start speaking some message, overriding any current one (never blocks).
+// plays from memory if cached, else speaks directly if backend can,
+// otherwise starts playing as soon as background synthesis finishes
+// returns 1 if successful, 0 or negative for some error
+
+int jhcTtsEngine::Say (const char *msg)
+{
+  char key[300];
+  jhcTtsClip *c;
+  int queued;
+
+  // stop any talking currently in progress
+  stop_all();
+  if ((msg == NULL) || (*msg == '\0'))
+    return 1;
+
+  // play from memory if already synthesized
+  jhcTtsCache::MakeKey(key, 300, msg, vname);
+  if ((c = cache.Grab(key)) != NULL)
+  {
+    if (out.Play(c->Audio(), c->Samples()) > 0)
+    {
+      now = c;
+      return 1;
+    }
+    cache.Release(c);
+  }
+
+  // have background thread synthesize it (skipped if too busy)
+  launch();
+  queued = add_req(msg, 0);
+
+  // speak directly this time (if possible) else wait for synthesis
+  if (direct_say(msg) > 0)
+  {
+    direct = 1;
+    return 1;
+  }
+  if (queued <= 0)
+    add_req(msg, 1);
+  strcpy(pend, key);
+  pt0 = Now();
+  return 1;
+}
+
+
+//= Tells if system has completed emitting utterance yet.
+// cached phrases use viseme timeline and current playback position
+// also starts playback once a pending phrase has been synthesized
+// returns viseme+1 if talking, 0 if done, negative for some error
+
+int jhcTtsEngine::Status ()
+{
+  int rc;
+
+  // playing from memory
+  if (now != NULL)
+  {
+    if (out.Busy() > 0)
+      return(now->VisemeAt(out.Position()) + 1);
+    cache.Release(now);
+    now = NULL;
+    return 0;
+  }
+
+  // waiting for synthesis (counts as talking)
+  if (*pend != '\0')
+  {
+    if ((now = cache.Grab(pend)) != NULL)
+    {
+      *pend = '\0';
+      if (out.Play(now->Audio(), now->Samples()) > 0)
+        return(now->VisemeAt(0) + 1);
+      cache.Release(now);
+      now = NULL;
+      return -1;
+    }
+    if ((Now() - pt0) > (unsigned long) wait)
+    {
+      *pend = '\0';
+      return -1;
+    }
+    return 1;
+  }
+
+  // speaking directly
+  if (direct <= 0)
+    return 0;
+  if ((rc = direct_status()) <= 0)
+    direct = 0;
+  return rc;
+}
+
+
+//= Get mouth shape timeline of current phrase so caller can schedule it.
+// ms gets start time of each viseme, vis gets shapes (SAPI numbering, 0 = silence)
+// len is total length and ago is how long since playback started (both ms)
+// returns number of visemes, 0 if not talking, -1 if unknown (yet)
+
+int jhcTtsEngine::Timeline (int *ms, int *vis, int vmax, int& len, int& ago)
+{
+  int i, n;
+
+  len = 0;
+  ago = 0;
+  if (Status() <= 0)
+    return 0;
+  if (now == NULL)
+    return -1;
+  n = now->Visemes();
+  if (n > vmax)
+    n = vmax;
+  for (i = 0; i < n; i++)
+  {
+    ms[i]  = now->VisemeTime(i);
+    vis[i] = now->VisemeShape(i);
+  }
+  len = now->Length();
+  ago = out.Position();
+  return n;
+}
+
+
+//= Monotonic time in milliseconds (arbitrary zero).
+
+unsigned long jhcTtsEngine::Now ()
+{
+  return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//= Cut off any output and forget about pending phrase.
+
+void jhcTtsEngine::stop_all ()
+{
+  out.Stop();
+  if (now != NULL)
+    cache.Release(now);
+  now = NULL;
+  *pend = '\0';
+  direct_stop();
+  direct = 0;
+}
+
+
+//= Make sure background synthesis thread is running.
+
+void jhcTtsEngine::launch ()
+{
+  if (run > 0)
+    return;
+  run = 1;
+  pthread_create(&bg, NULL, synth_loop, this);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                         Background Synthesis                          //
+///////////////////////////////////////////////////////////////////////////
+
+//= Thread function for synthesizing phrases.
+
+pthread_ret jhcTtsEngine::synth_loop (void *tts)
+{
+  ((jhcTtsEngine *) tts)->run_synth();
+  return 0;
+}
+
+
+//= Render requested phrases as they arrive, stock phrases when idle.
+// backend can set up its own per-thread rendering context
+
+void jhcTtsEngine::run_synth ()
+{
+  char txt[500];
+  void *ctx;
+
+  if ((ctx = thread_start()) == NULL)
+    return;
+  while (run > 0)
+    if (get_req(txt, 500) > 0)
+      synth(ctx, txt);
+    else if (warm == 1)
+    {
+      warm_dir(ctx);
+      warm = 2;
+    }
+    else
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  thread_end(ctx);
+}
+
+
+//= Render fixed output strings from all operator files in KB2 directory.
+// returns number of new phrases cached
+
+int jhcTtsEngine::warm_dir (void *ctx)
+{
+  char fn[500];
+  int cnt = 0;
+
+#ifdef __linux__
+  struct dirent *f;
+  DIR *d;
+  int n;
+
+  snprintf(fn, 500, "%s/KB2", home);
+  if ((d = opendir(fn)) == NULL)
+    return 0;
+  while ((run > 0) && ((f = readdir(d)) != NULL))
+    if (((n = (int) strlen(f->d_name)) > 4) && (strcmp(f->d_name + n - 4, ".ops") == 0))
+    {
+      snprintf(fn, 500, "%s/KB2/%s", home, f->d_name);
+      cnt += warm_file(ctx, fn);
+    }
+  closedir(d);
+#else
+  struct _finddata_t f;
+  intptr_t h;
+
+  snprintf(fn, 500, "%s/KB2/*.ops", home);
+  if ((h = _findfirst(fn, &f)) == -1)
+    return 0;
+  do
+  {
+    snprintf(fn, 500, "%s/KB2/%s", home, f.name);
+    cnt += warm_file(ctx, fn);
+  }
+  while ((run > 0) && (_findnext(h, &f) == 0));
+  _findclose(h);
+#endif
+
+  return cnt;
+}
+
+
+//= Render fixed output strings from one operator file.
+// looks for lines like: txt-1 -str-  I don't understand ]
+// skips strings with substitutions (e.g. "?0"), serves requests in between
+// returns number of new phrases cached
+
+int jhcTtsEngine::warm_file (void *ctx, const char *fn)
+{
+  char line[500], txt[500];
+  FILE *in;
+  const char *s;
+  int i, n, arg, cnt = 0;
+
+  if ((in = fopen(fn, "r")) == NULL)
+    return 0;
+  while ((run > 0) && (fgets(line, 500, in) != NULL))
+  {
+    // find start of literal string
+    if ((s = strstr(line, "-str")) == NULL)
+      continue;
+    s += 4;
+    if (*s == '-')
+      s++;
+    while (isspace((unsigned char) *s))
+      s++;
+
+    // trim trailing whitespace and closing bracket
+    strcpy(txt, s);
+    n = (int) strlen(txt);
+    while ((n > 0) && (isspace((unsigned char) txt[n - 1]) || (txt[n - 1] == ']')))
+      n--;
+    txt[n] = '\0';
+
+    // only whole phrases without argument slots
+    arg = 0;
+    for (i = 0; i < (n - 1); i++)
+      if ((txt[i] == '?') && isdigit((unsigned char) txt[i + 1]))
+        arg = 1;
+    if ((n > 0) && (arg <= 0))
+      cnt += synth(ctx, txt);
+
+    // urgent requests take priority
+    while (get_req(txt, 500) > 0)
+      synth(ctx, txt);
+  }
+  fclose(in);
+  return cnt;
+}
+
+
+//= Add request for background synthesis of some phrase.
+// if queue is full then only added when forced (replaces newest request)
+// returns 1 if queued, 0 if no room
+
+int jhcTtsEngine::add_req (const char *txt, int force)
+{
+  std::lock_guard<std::mutex> hold(qlock);
+
+  if (nreq >= rmax)
+  {
+    if (force <= 0)
+      return 0;
+    nreq = rmax - 1;
+  }
+  strncpy(req[nreq], txt, 499);
+  req[nreq][499] = '\0';
+  nreq++;
+  return 1;
+}
+
+
+//= Get oldest request for synthesis (if any).
+// returns 1 if something, 0 if nothing pending
+
+int jhcTtsEngine::get_req (char *txt, int ssz)
+{
+  std::lock_guard<std::mutex> hold(qlock);
+  int i;
+
+  if (nreq <= 0)
+    return 0;
+  strncpy(txt, req[0], ssz - 1);
+  txt[ssz - 1] = '\0';
+  nreq--;
+  for (i = 0; i < nreq; i++)
+    strcpy(req[i], req[i + 1]);
+  return 1;
+}
+
+
+//= Render phrase with viseme timing and add it to cache.
+// returns 1 if newly added, 0 if already cached or problem
+
+int jhcTtsEngine::synth (void *ctx, const char *txt)
+{
+  char key[300];
+  jhcTtsClip *c;
+
+  jhcTtsCache::MakeKey(key, 300, txt, vname);
+  if (cache.Has(key) > 0)
+    return 0;
+  c = new jhcTtsClip;
+  strcpy(c->key, key);
+  if ((render(ctx, txt, c) <= 0) || (c->Samples() <= 0))
+  {
+    delete c;
+    return 0;
+  }
+  return cache.Add(c);
+}
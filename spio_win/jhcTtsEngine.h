@@ -0,0 +1,131 @@
+// jhcTtsEngine.h : common interface for text-to-speech backends
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "jhc_pthread.h"
+
+#include "jhcAudioOut.h"
+#include "jhcTtsCache.h"
+
+
+//= Common interface for text-to-speech backends.
+// phrases are rendered to PCM plus viseme timeline on a background thread,
+// kept in a cache, and played from memory so the timeline is known up front
+// stock phrases from KB operator files can be rendered ahead of time
+// derived classes supply rendering and optionally direct (uncached) speech
+
+class jhcTtsEngine
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int rmax = 8;           // pending synthesis requests
+
+  // stored phrases and playback
+  jhcTtsCache cache;
+  jhcAudioOut out;
+  jhcTtsClip *now;
+
+  // phrase waiting for synthesis and when requested (ms)
+  char pend[300];
+  unsigned long pt0;
+
+  // whether speaking directly
+  int direct;
+
+  // background synthesis thread, file directory, and pre-warm request
+  pthread_t bg;
+  int run;
+  char home[200];
+  std::atomic<int> warm;
+
+  // requests for background synthesis
+  std::mutex qlock;
+  char req[rmax][500];
+  int nreq;
+
+
+// PROTECTED MEMBER VARIABLES
+protected:
+  // name of voice and rendering sample rate
+  char vname[200];
+  int sps;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // longest wait for a phrase to be synthesized (ms)
+  int wait;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  virtual ~jhcTtsEngine ();
+  jhcTtsEngine ();
+  int Init ();
+  int Prewarm (const char *dir);
+  void Done ();
+
+  // main functions
+  int Say (const char *msg);
+  int Status ();
+  int Timeline (int *ms, int *vis, int vmax, int& len, int& ago);
+  int Cached () const {return cache.Count();}
+  const jhcAudioOut *Speaker () const {return &out;}
+  static unsigned long Now ();
+
+
+// PROTECTED MEMBER FUNCTIONS
+protected:
+  // backend specific (called on main thread)
+  virtual int setup () =0;
+  virtual void cleanup () {}
+  virtual int direct_say (const char *msg) {return 0;}
+  virtual int direct_status () {return 0;}
+  virtual void direct_stop () {}
+
+  // backend specific (called on synthesis thread)
+  virtual void *thread_start () {return this;}
+  virtual void thread_end (void *ctx) {}
+  virtual int render (void *ctx, const char *txt, jhcTtsClip *c) =0;
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // main functions
+  void stop_all ();
+  void launch ();
+
+  // background synthesis
+  static pthread_ret synth_loop (void *tts);
+  void run_synth ();
+  int warm_dir (void *ctx);
+  int warm_file (void *ctx, const char *fn);
+  int add_req (const char *txt, int force);
+  int get_req (char *txt, int ssz);
+  int synth (void *ctx, const char *txt);
+
+};
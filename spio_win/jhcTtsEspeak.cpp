@@ -0,0 +1,186 @@
+// jhcTtsEspeak.cpp : text-to-speech with phoneme timeline using espeak-ng
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+// NOTE: needs espeak-ng library and data (https://github.com/espeak-ng/espeak-ng)
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include "jhcTtsEspeak.h"
+
+#ifdef SPIO_ESPEAK
+
+#include <stdio.h>
+#include <string.h>
+
+#include <espeak-ng/speak_lib.h>
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcTtsEspeak::~jhcTtsEspeak ()
+{
+  Done();
+  delete [] acc;
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcTtsEspeak::jhcTtsEspeak ()
+{
+  amax = 10 * 22050;
+  acc = new short [amax];
+  na = 0;
+  clip = NULL;
+  strcpy(voice, "en-us");
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                         Main Thread Functions                         //
+///////////////////////////////////////////////////////////////////////////
+
+//= Start synthesizer in memory-only mode with phoneme events.
+// only the synthesis thread renders afterwards (library is not reentrant)
+// returns 1 if successful, 0 for problem
+
+int jhcTtsEspeak::setup ()
+{
+  int rate;
+
+  if ((rate = espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 200, NULL, espeakINITIALIZE_PHONEME_EVENTS)) <= 0)
+    return 0;
+  if (espeak_SetVoiceByName(voice) != EE_OK)
+    return 0;
+  espeak_SetSynthCallback((t_espeak_callback *) synth_cb);
+  sps = rate;
+  snprintf(vname, 200, "espeak-%s", voice);
+  return 1;
+}
+
+
+//= Shut down synthesizer.
+
+void jhcTtsEspeak::cleanup ()
+{
+  espeak_Terminate();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Rendering                               //
+///////////////////////////////////////////////////////////////////////////
+
+//= Synthesize phrase into memory along with viseme timing.
+// returns 1 if successful, 0 for problem
+
+int jhcTtsEspeak::render (void *ctx, const char *txt, jhcTtsClip *c)
+{
+  clip = c;
+  na = 0;
+  if (espeak_Synth(txt, strlen(txt) + 1, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, NULL, this) != EE_OK)
+    na = 0;
+  clip = NULL;
+  if (na <= 0)
+    return 0;
+  c->AddViseme((int)((1000LL * na) / sps), 0);           // mouth closed at end
+  return c->SetAudio(acc, na, sps);
+}
+
+
+//= Library callback with next block of samples and associated events.
+// event list ends with a terminator, user data points to this object
+// returns 0 to continue synthesis
+
+int jhcTtsEspeak::synth_cb (short *wav, int cnt, void *evs)
+{
+  espeak_EVENT *ev = (espeak_EVENT *) evs;
+  jhcTtsEspeak *me = (jhcTtsEspeak *) ev->user_data;
+
+  if ((me == NULL) || (me->clip == NULL))
+    return 0;
+  for (; ev->type != espeakEVENT_LIST_TERMINATED; ev++)
+    if (ev->type == espeakEVENT_PHONEME)
+      me->clip->AddViseme(ev->audio_position, viseme(ev->id.string));
+  if ((wav != NULL) && (cnt > 0))
+    me->add_samples(wav, cnt);
+  return 0;
+}
+
+
+//= Append samples to accumulator, enlarging it if needed.
+// returns number of samples so far
+
+int jhcTtsEspeak::add_samples (const short *wav, int cnt)
+{
+  short *big;
+
+  if ((na + cnt) > amax)
+  {
+    amax = 2 * (na + cnt);
+    big = new short [amax];
+    memcpy(big, acc, na * sizeof(short));
+    delete [] acc;
+    acc = big;
+  }
+  memcpy(acc + na, wav, cnt * sizeof(short));
+  na += cnt;
+  return na;
+}
+
+
+//= Convert espeak phoneme mnemonic into a SAPI viseme number.
+// stress and length marks are ignored, unknown phonemes use first character
+
+int jhcTtsEspeak::viseme (const char *ph)
+{
+  // multi-character phonemes (more specific first)
+  const char *multi[] = {"a#", "A:", "A@", "O:", "O@", "e@", "eI", "3:", "i@",
+                         "i:", "u:", "U@", "oU", "aU", "OI", "aI", "tS", "dZ"};
+  const int mvis[]    = {1,    2,    2,    3,    3,    4,    4,    5,    6,
+                         6,    7,    7,    8,    9,    10,   11,   16,   16};
+  // single characters
+  const char *single  = "a@VA0OEeU3iIjuwohrlszSZTDfvtdnkgNpbm_";
+  const int svis[]    = {1, 1, 1, 2, 3, 3, 4, 4, 4, 5, 6, 6, 6, 7, 7, 8, 12, 13, 14, 15, 15,
+                         16, 16, 17, 17, 18, 18, 19, 19, 19, 20, 20, 20, 21, 21, 21, 0};
+  const char *s = ph;
+  const char *hit;
+  int i, n = (int)(sizeof(mvis) / sizeof(int));
+
+  while ((*s == '\'') || (*s == ',') || (*s == '%') || (*s == '='))
+    s++;
+  if ((*s == '\0') || (*s == ' '))
+    return 0;
+  for (i = 0; i < n; i++)
+    if (strncmp(s, multi[i], strlen(multi[i])) == 0)
+      return mvis[i];
+  if ((hit = strchr(single, *s)) != NULL)
+    return svis[hit - single];
+  return 0;
+}
+
+
+#endif  // SPIO_ESPEAK
@@ -0,0 +1,82 @@
+// jhcTtsEspeak.h : text-to-speech with phoneme timeline using espeak-ng
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "jhcTtsEngine.h"
+
+
+// always available under Linux, optional for Windows (needs espeak-ng.lib)
+
+#if defined(__linux__) && !defined(SPIO_ESPEAK)
+  #define SPIO_ESPEAK
+#endif
+
+
+//= Text-to-speech with phoneme timeline using espeak-ng.
+// renders each phrase to memory in synchronous mode on the synthesis thread
+// phoneme events are mapped to SAPI viseme numbers so mouth code is shared
+// no direct speech: uncached phrases start once rendered (a few tens of ms)
+
+class jhcTtsEspeak : public jhcTtsEngine
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // samples collected for phrase being rendered
+  short *acc;
+  int na, amax;
+
+  // phrase being rendered
+  jhcTtsClip *clip;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // espeak voice to use
+  char voice[40];
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcTtsEspeak ();
+  jhcTtsEspeak ();
+
+
+// PROTECTED MEMBER FUNCTIONS
+protected:
+  // backend specific (called on main thread)
+  int setup ();
+  void cleanup ();
+
+  // backend specific (called on synthesis thread)
+  int render (void *ctx, const char *txt, jhcTtsClip *c);
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  // rendering
+  static int synth_cb (short *wav, int cnt, void *evs);
+  int add_samples (const short *wav, int cnt);
+  static int viseme (const char *ph);
+
+};
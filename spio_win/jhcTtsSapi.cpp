@@ -0,0 +1,236 @@
+// jhcTtsSapi.cpp : cached Windows text-to-speech played from memory
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef __linux__
+
+#include <windows.h>
+#include <sapi.h>
+#include <string.h>
+
+#include "jhcTtsSapi.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default destructor does necessary cleanup.
+
+jhcTtsSapi::~jhcTtsSapi ()
+{
+  Done();
+}
+
+
+//= Default constructor initializes certain values.
+
+jhcTtsSapi::jhcTtsSapi ()
+{
+  voice = NULL;
+  sps = 16000;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                         Main Thread Functions                         //
+///////////////////////////////////////////////////////////////////////////
+
+//= Get voice for direct speech and its short name.
+// expects COM to already be initialized on this thread
+// returns 1 if successful, 0 for problem
+
+int jhcTtsSapi::setup ()
+{
+  ISpObjectToken *tok = NULL;
+  WCHAR *id = NULL;
+  char full[500];
+  const char *tail;
+
+  // make direct speech engine
+  if (voice != NULL)
+    return 1;
+  CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, IID_ISpVoice, (void **)(&voice));
+  if (voice == NULL)
+    return 0;
+
+  // get short name of current voice (e.g. "TTS_MS_EN-US_ZIRA_11.0")
+  if (SUCCEEDED(voice->GetVoice(&tok)))
+  {
+    if (SUCCEEDED(tok->GetId(&id)))
+    {
+      WideCharToMultiByte(CP_UTF8, 0, id, -1, full, 500, NULL, NULL);
+      tail = strrchr(full, '\\');
+      strncpy_s(vname, ((tail != NULL) ? tail + 1 : full), _TRUNCATE);
+      CoTaskMemFree(id);
+    }
+    tok->Release();
+  }
+  return 1;
+}
+
+
+//= Release direct speech engine.
+
+void jhcTtsSapi::cleanup ()
+{
+  if (voice != NULL)
+    voice->Release();
+  voice = NULL;
+}
+
+
+//= Speak an uncached phrase directly (asynchronously).
+// returns 1 if started, 0 for problem
+
+int jhcTtsSapi::direct_say (const char *msg)
+{
+  WCHAR wide[500];
+
+  if (voice == NULL)
+    return 0;
+  MultiByteToWideChar(CP_UTF8, 0, msg, -1, wide, 500);
+  if (FAILED(voice->Speak(wide, SPF_ASYNC, NULL)))
+    return 0;
+  return 1;
+}
+
+
+//= Tells whether direct speech is still going.
+// returns viseme+1 if talking, 0 if done, negative for some error
+
+int jhcTtsSapi::direct_status ()
+{
+  SPVOICESTATUS info;
+
+  if (voice == NULL)
+    return 0;
+  if (FAILED(voice->GetStatus(&info, NULL)))
+    return -1;
+  if (info.dwRunningState == SPRS_DONE)
+    return 0;
+  return(info.VisemeId + 1);
+}
+
+
+//= Cut off any direct speech.
+
+void jhcTtsSapi::direct_stop ()
+{
+  if (voice != NULL)
+    voice->Speak(NULL, SPF_PURGEBEFORESPEAK, NULL);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Synthesis Thread Functions                       //
+///////////////////////////////////////////////////////////////////////////
+
+//= Make a separate voice for rendering since SAPI objects belong to one thread.
+// returns voice to pass to render, NULL for problem
+
+void *jhcTtsSapi::thread_start ()
+{
+  ISpVoice *v = NULL;
+
+  CoInitialize(NULL);
+  CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, IID_ISpVoice, (void **)(&v));
+  if (v == NULL)
+    CoUninitialize();
+  return v;
+}
+
+
+//= Release rendering voice.
+
+void jhcTtsSapi::thread_end (void *ctx)
+{
+  ((ISpVoice *) ctx)->Release();
+  CoUninitialize();
+}
+
+
+//= Synthesize phrase into memory along with viseme timing.
+// returns 1 if successful, 0 for problem
+
+int jhcTtsSapi::render (void *ctx, const char *txt, jhcTtsClip *c)
+{
+  ISpVoice *v = (ISpVoice *) ctx;
+  WAVEFORMATEX fmt;
+  STATSTG st;
+  LARGE_INTEGER zero;
+  SPEVENT ev;
+  WCHAR wide[500];
+  IStream *mem = NULL;
+  ISpStream *ss = NULL;
+  short *pcm;
+  ULONG got;
+  int n;
+
+  // memory stream of 16 bit mono PCM
+  memset(&fmt, 0, sizeof(WAVEFORMATEX));
+  fmt.wFormatTag = WAVE_FORMAT_PCM;
+  fmt.nChannels = 1;
+  fmt.nSamplesPerSec = sps;
+  fmt.wBitsPerSample = 16;
+  fmt.nBlockAlign = 2;
+  fmt.nAvgBytesPerSec = 2 * sps;
+  if (FAILED(CreateStreamOnHGlobal(NULL, TRUE, &mem)))
+    return 0;
+  if (FAILED(CoCreateInstance(CLSID_SpStream, NULL, CLSCTX_ALL, IID_ISpStream, (void **)(&ss))) ||
+      FAILED(ss->SetBaseStream(mem, SPDFID_WaveFormatEx, &fmt)))
+  {
+    if (ss != NULL)
+      ss->Release();
+    mem->Release();
+    return 0;
+  }
+
+  // render whole phrase and note when each mouth shape starts
+  v->SetOutput(ss, TRUE);
+  v->SetInterest(SPFEI(SPEI_VISEME), SPFEI(SPEI_VISEME));
+  MultiByteToWideChar(CP_UTF8, 0, txt, -1, wide, 500);
+  if (SUCCEEDED(v->Speak(wide, SPF_DEFAULT, NULL)))
+  {
+    while (SUCCEEDED(v->GetEvents(1, &ev, &got)) && (got > 0))
+      if (ev.eEventId == SPEI_VISEME)
+        c->AddViseme((int)(ev.ullAudioStreamOffset / fmt.nBlockAlign * 1000 / sps), LOWORD(ev.lParam));
+
+    // copy out samples
+    if (SUCCEEDED(mem->Stat(&st, STATFLAG_NONAME)))
+      if ((n = (int)(st.cbSize.QuadPart / 2)) > 0)
+      {
+        zero.QuadPart = 0;
+        mem->Seek(zero, STREAM_SEEK_SET, NULL);
+        pcm = new short [n];
+        if (SUCCEEDED(mem->Read(pcm, 2 * n, &got)))
+          c->SetAudio(pcm, (int)(got / 2), sps);
+        delete [] pcm;
+      }
+  }
+  v->SetOutput(NULL, TRUE);
+  ss->Release();
+  mem->Release();
+  return((c->Samples() > 0) ? 1 : 0);
+}
+
+
+#endif  // __linux__
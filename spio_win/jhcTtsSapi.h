@@ -0,0 +1,67 @@
+// jhcTtsSapi.h : cached Windows text-to-speech played from memory
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "jhcTtsEngine.h"
+
+
+// avoid pulling SAPI into every file
+
+struct ISpVoice;
+
+
+//= Cached Windows text-to-speech played from memory.
+// phrases are rendered to PCM with viseme timing on the background thread
+// a phrase not yet cached is spoken directly (and cached for next time)
+// NOTE: Windows only (SAPI)
+
+class jhcTtsSapi : public jhcTtsEngine
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // direct speech
+  ISpVoice *voice;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  ~jhcTtsSapi ();
+  jhcTtsSapi ();
+
+
+// PROTECTED MEMBER FUNCTIONS
+protected:
+  // backend specific (called on main thread)
+  int setup ();
+  void cleanup ();
+  int direct_say (const char *msg);
+  int direct_status ();
+  void direct_stop ();
+
+  // backend specific (called on synthesis thread)
+  void *thread_start ();
+  void thread_end (void *ctx);
+  int render (void *ctx, const char *txt, jhcTtsClip *c);
+
+};
@@ -0,0 +1,108 @@
+// jhcUttQ.cpp : lock-free queue of recognized utterances
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <string.h>
+
+#include "jhcUttQ.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcUttQ::jhcUttQ ()
+{
+  head = 0;
+  tail = 0;
+  drop = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Producer Side                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Add an utterance with start and end times (ms) and confidence.
+// only call from a single thread (never blocks)
+// returns 1 if queued, 0 if full (dropped)
+
+int jhcUttQ::Push (const char *msg, unsigned long start, unsigned long end, float c)
+{
+  int t = tail.load(std::memory_order_relaxed), t2 = (t + 1) % qmax;
+  int i;
+
+  // full if writing would catch up with reader
+  if (t2 == head.load(std::memory_order_acquire))
+  {
+    drop++;
+    return 0;
+  }
+
+  // fill slot completely before publishing it
+  for (i = 0; i < (tmax - 1); i++)
+    if ((txt[t][i] = msg[i]) == '\0')
+      break;
+  txt[t][i] = '\0';
+  t0[t] = start;
+  t1[t] = end;
+  conf[t] = c;
+  tail.store(t2, std::memory_order_release);
+  return 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Consumer Side                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Number of utterances waiting.
+
+int jhcUttQ::Count () const
+{
+  int h = head.load(std::memory_order_relaxed), t = tail.load(std::memory_order_acquire);
+
+  return((t - h + qmax) % qmax);
+}
+
+
+//= Remove oldest utterance and get its text, times, and confidence.
+// only call from a single thread (never blocks)
+// returns 1 if something retrieved, 0 if queue empty
+
+int jhcUttQ::Pop (char *msg, int ssz, unsigned long& start, unsigned long& end, float& c)
+{
+  int h = head.load(std::memory_order_relaxed);
+
+  if (h == tail.load(std::memory_order_acquire))
+    return 0;
+  strncpy(msg, txt[h], ssz - 1);
+  msg[ssz - 1] = '\0';
+  start = t0[h];
+  end = t1[h];
+  c = conf[h];
+  head.store((h + 1) % qmax, std::memory_order_release);
+  return 1;
+}
@@ -0,0 +1,68 @@
+// jhcUttQ.h : lock-free queue of recognized utterances
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+
+//= Lock-free queue of recognized utterances.
+// single producer (recognizer thread or SDK callback) and single consumer
+// (control loop) so only needs atomic head and tail indices
+// each record has text, speech start and end times, and confidence
+// producer never waits: if queue is full newest utterance is counted and dropped
+
+class jhcUttQ
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  static const int qmax = 16;          // max pending utterances
+  static const int tmax = 500;         // longest text
+
+  // utterance records
+  char txt[qmax][tmax];
+  unsigned long t0[qmax], t1[qmax];
+  float conf[qmax];
+
+  // next slot to read (consumer) and next to write (producer)
+  std::atomic<int> head, tail;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // utterances lost because queue was full
+  std::atomic<int> drop;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  jhcUttQ ();
+
+  // producer side
+  int Push (const char *msg, unsigned long start, unsigned long end, float c =1.0f);
+
+  // consumer side
+  int Count () const;
+  int Pop (char *msg, int ssz, unsigned long& start, unsigned long& end, float& c);
+
+};
@@ -0,0 +1,175 @@
+// jhcVAD.cpp : frame-level voice activity detector with adaptive endpointing
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#include "jhcVAD.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+//                      Creation and Initialization                      //
+///////////////////////////////////////////////////////////////////////////
+
+//= Default constructor initializes certain values.
+
+jhcVAD::jhcVAD ()
+{
+  // detection parameters
+  on_db  = 12.0;             // well above background
+  off_db = 8.0;              // trailing soft consonants
+  vmin   = 100;              // ignore clicks and thumps
+
+  // endpointing parameters
+  hang    = 500;             // same as Azure default
+  vlong   = 3000;            // a couple of sentences
+  stretch = 0.1;             // +100 ms after 4 sec
+  hmax    = 1200;            // natural dictation pauses
+
+  // state
+  req = 0;
+  Reset(16000);
+}
+
+
+//= Start fresh on a new audio stream.
+
+void jhcVAD::Reset (int rate)
+{
+  sps = rate;
+  cnt = 0;
+  noise = 40.0;
+  talk = 0;
+  quiet = 0;
+  voiced = 0;
+  won = 0;
+  woff = 0;
+  son = 0;
+  soff = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Main Functions                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Process next frame of audio which finished arriving at wall time "now" (ms).
+// returns 1 at speech onset, 2 at end of utterance, -1 at end of noise burst, 0 otherwise
+
+int jhcVAD::Frame (const short *s, int n, unsigned long now)
+{
+  double db = frame_db(s, n);
+  int ms = (1000 * n) / sps;
+  unsigned long s0 = StreamNow();
+
+  cnt += n;
+
+  // waiting for speech to start
+  if (talk <= 0)
+  {
+    // track background level (falls quickly, rises slowly)
+    noise += ((db < noise) ? 0.2 : 0.01) * (db - noise);
+    if (db <= (noise + on_db))
+      return 0;
+
+    // record beginning of frame as start of speech
+    talk = 1;
+    quiet = 0;
+    voiced = ms;
+    won = now - ms;
+    son = s0;
+    woff = now;
+    soff = s0 + ms;
+    return 1;
+  }
+
+  // extend utterance while loud enough
+  if (db > (noise + off_db))
+  {
+    voiced += ms;
+    quiet = 0;
+    woff = now;
+    soff = s0 + ms;
+    return 0;
+  }
+
+  // check for long enough pause
+  quiet += ms;
+  if (quiet < Hang())
+    return 0;
+  return end_utt();
+}
+
+
+//= Force end of current utterance (e.g. buffer full).
+// returns 2 if real utterance, -1 if noise burst, 0 if not talking
+
+int jhcVAD::Finish ()
+{
+  if (talk <= 0)
+    return 0;
+  return end_utt();
+}
+
+
+//= Silence needed to end current utterance (ms).
+// uses one-time override if set, extends for long utterances
+
+int jhcVAD::Hang () const
+{
+  int r = req, h0 = ((r > 0) ? r : hang), h = h0;
+
+  if (voiced > vlong)
+    h += (int)(stretch * (voiced - vlong));
+  if (h > hmax)
+    h = ((h0 > hmax) ? h0 : hmax);
+  return h;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                           Helper Functions                            //
+///////////////////////////////////////////////////////////////////////////
+
+//= Loudness of a frame in dB (full scale about 90).
+
+double jhcVAD::frame_db (const short *s, int n) const
+{
+  double sum = 0.0;
+  int i;
+
+  for (i = 0; i < n; i++)
+    sum += s[i] * (double) s[i];
+  return(10.0 * log10(sum / n + 1.0));
+}
+
+
+//= Close off current utterance and clear any one-time silence override.
+// returns 2 if real utterance, -1 if just a noise burst
+
+int jhcVAD::end_utt ()
+{
+  talk = 0;
+  if (voiced < vmin)
+    return -1;
+  req = 0;
+  return 2;
+}
@@ -0,0 +1,94 @@
+// jhcVAD.h : frame-level voice activity detector with adaptive endpointing
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+
+//= Frame-level voice activity detector with adaptive endpointing.
+// compares frame loudness to a tracked background level with hysteresis
+// gives onset and offset times on both the wall clock and the stream clock
+// silence needed to end an utterance is lengthened for long utterances
+// (e.g. dictation) and can be shortened for one turn (e.g. yes/no answer)
+
+class jhcVAD
+{
+// PRIVATE MEMBER VARIABLES
+private:
+  // sample rate and samples processed so far
+  int sps;
+  long long cnt;
+
+  // background estimate (dB) and current state
+  double noise;
+  int talk, quiet, voiced;
+
+  // utterance timing (ms) on wall and stream clocks
+  unsigned long won, woff, son, soff;
+
+  // silence override for next utterance (ms)
+  std::atomic<int> req;
+
+
+// PUBLIC MEMBER VARIABLES
+public:
+  // speech start and continuation levels above noise (dB)
+  double on_db, off_db;
+
+  // normal silence at end (ms), extra fraction and limit for long utterances
+  int hang, hmax;
+  double stretch;
+
+  // least speech for an utterance and speech before stretching (ms)
+  int vmin, vlong;
+
+
+// PUBLIC MEMBER FUNCTIONS
+public:
+  // creation and initialization
+  jhcVAD ();
+  void Reset (int rate);
+  void NextHang (int ms) {req = ((ms > 0) ? ms : 0);}
+
+  // main functions
+  int Frame (const short *s, int n, unsigned long now);
+  int Finish ();
+
+  // state
+  int Talking () const {return talk;}
+  int Quiet () const {return quiet;}
+  int Voiced () const {return voiced;}
+  int Hang () const;
+  unsigned long Onset () const   {return won;}
+  unsigned long Offset () const  {return woff;}
+  unsigned long StreamOn () const  {return son;}
+  unsigned long StreamOff () const {return soff;}
+  unsigned long StreamNow () const {return (unsigned long)((1000 * cnt) / sps);}
+
+
+// PRIVATE MEMBER FUNCTIONS
+private:
+  double frame_db (const short *s, int n) const;
+  int end_utt ();
+
+};
@@ -0,0 +1,417 @@
+// spio_bench.cpp : latency benchmark for speech pipeline using WAV fixtures
+//
+// Written by Jonathan H. Connell, jconnell@alum.mit.edu
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2024 Etaoin Systems
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+
+// Linux build: g++ -O2 -I../shared spio_bench.cpp jhcAudioFile.cpp jhcRecoStub.cpp jhcRecoEngine.cpp
+//   jhcUttQ.cpp jhcVAD.cpp jhcAudioIn.cpp jhcEchoCancel.cpp jhcAudioOut.cpp jhcTtsClip.cpp
+//   jhcTtsCache.cpp jhcTtsEngine.cpp jhcTtsEspeak.cpp -o spio_bench -lespeak-ng -lasound -lpthread
+
+#define _CRT_SECURE_NO_WARNINGS       // plain C string calls for portability
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+#include <thread>
+
+#ifndef __linux__
+  #include <windows.h>
+  #include <mmsystem.h>
+  #include <combaseapi.h>
+  #pragma comment(lib, "winmm.lib")
+#endif
+
+#include "jhcAudioFile.h"
+#include "jhcRecoStub.h"
+#include "jhcTtsEspeak.h"
+
+#ifndef SPIO_ESPEAK
+  #include "jhcTtsSapi.h"
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Global Variables                           //
+///////////////////////////////////////////////////////////////////////////
+
+// stages timed for each recognized utterance
+
+static const int nst = 4;
+static const char *stage[nst] = {"endpoint", "decode", "pickup", "total"};
+
+static const int rmax = 1000;
+static double lat[nst][rmax];
+
+
+// phrases timed for text-to-speech
+
+static const char *phrase[] = {"Hello there.",
+                               "I am not sure what you mean.",
+                               "Okay, I will go to the kitchen and get it for you.",
+                               "The red block is on top of the green one.",
+                               "See you later."};
+
+static const int np = (int)(sizeof(phrase) / sizeof(phrase[0]));
+static double cold[np], warm[np];
+
+
+///////////////////////////////////////////////////////////////////////////
+//                               Statistics                              //
+///////////////////////////////////////////////////////////////////////////
+
+//= Comparison function for sorting latencies.
+
+static int by_val (const void *a, const void *b)
+{
+  double va = *((const double *) a), vb = *((const double *) b);
+
+  return((va < vb) ? -1 : ((va > vb) ? 1 : 0));
+}
+
+
+//= Nearest rank percentile of a sorted list.
+
+static double pct (const double *v, int n, double p)
+{
+  int i = (int)(0.01 * p * n + 0.999) - 1;
+
+  return v[(i < 0) ? 0 : ((i >= n) ? n - 1 : i)];
+}
+
+
+//= Print summary line for some set of latencies (sorted in place).
+
+static void report (const char *tag, double *v, int n)
+{
+  double sum = 0.0;
+  int i;
+
+  if (n <= 0)
+  {
+    printf("  %-10s %4d\n", tag, 0);
+    return;
+  }
+  qsort(v, n, sizeof(double), by_val);
+  for (i = 0; i < n; i++)
+    sum += v[i];
+  printf("  %-10s %4d %7.0f %7.0f %7.0f %7.0f %7.0f\n", tag, n, sum / n,
+         pct(v, n, 50.0), pct(v, n, 90.0), pct(v, n, 99.0), v[n - 1]);
+}
+
+
+//= Print column headers for summary lines.
+
+static void header ()
+{
+  printf("  %-10s %4s %7s %7s %7s %7s %7s   (ms)\n", "stage", "n", "mean", "p50", "p90", "p99", "max");
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                              Recognition                              //
+///////////////////////////////////////////////////////////////////////////
+
+//= Feed WAV files through stand-in recognizer and time each stage.
+// endpoint = end of speech in file to VAD deciding utterance is over
+// decode = VAD endpoint to result queued, pickup = queued to caller seeing it
+// returns number of results timed
+
+static int time_reco (jhcAudioFile& src, const char *spec, int poll, int hang,
+                      const char *rname, int show)
+{
+  jhcRecoStub eng;
+  char txt[500];
+  unsigned long tend, take, last = 0;
+  int i, p, ms, rc, n = 0, k = 0, miss = 0;
+
+  // start recognizer on file source
+  eng.Source(&src);
+  if ((rc = eng.Start(NULL, spec, 0)) <= 0)
+  {
+    printf("Could not start recognizer -> %d\n", rc);
+    return 0;
+  }
+  if ((rname != NULL) && (eng.Wake(rname) > 0))
+    printf("Gated by wake word: %s\n", rname);
+  eng.Endpoint(hang);
+
+  // poll for results like a control loop would
+  while (1)
+  {
+    if (eng.Status() == 2)
+    {
+      eng.Take(txt, 500, ms);
+      take = jhcRecoEngine::Now();
+      eng.Endpoint(hang);
+      while (eng.Logged() <= k)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      p = eng.LogPlay(k);
+      tend = src.SpeechEnd(p);
+      if (show > 0)
+        printf("  [%d] %s\n", p, txt);
+      if ((tend != 0) && (n < rmax))
+      {
+        lat[0][n] = (double)(long)(eng.LogEnd(k) - tend);
+        lat[1][n] = (double)(long)(eng.LogPost(k) - eng.LogEnd(k));
+        lat[2][n] = (double)(long)(take - eng.LogPost(k));
+        lat[3][n] = (double)(long)(take - tend);
+        n++;
+      }
+      k++;
+      continue;
+    }
+
+    // stop once last clip recognized (or a while after it finished)
+    if (src.Done() > 0)
+    {
+      if ((k > 0) && (eng.LogPlay(k - 1) >= (src.Plays() - 1)))
+        break;
+      if (last == 0)
+        last = jhcRecoEngine::Now();
+      else if ((jhcRecoEngine::Now() - last) > 5000)
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(poll));
+  }
+  eng.Stop();
+
+  // summarize results
+  for (i = 0; i < src.Plays(); i++)
+  {
+    for (p = 0; p < k; p++)
+      if (eng.LogPlay(p) == i)
+        break;
+    if (p >= k)
+      miss++;
+  }
+  printf("\nRecognition: %d plays -> %d results (%d missed, %d dropped)\n",
+         src.Plays(), k, miss, eng.Dropped());
+  header();
+  for (i = 0; i < nst; i++)
+    report(stage[i], lat[i], n);
+  return n;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                            Text to Speech                             //
+///////////////////////////////////////////////////////////////////////////
+
+//= Wait until speech output starts playing from memory.
+// returns latency (ms), -1 if direct (uncached) speech, -2 if failed
+
+static double first_audio (jhcTtsEngine& tts, const char *msg)
+{
+  int ms[500], vis[500];
+  unsigned long t0 = jhcTtsEngine::Now();
+  int n, len, ago;
+
+  if (tts.Say(msg) <= 0)
+    return -2.0;
+  while ((n = tts.Timeline(ms, vis, 500, len, ago)) < 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  if (n > 0)
+    return (double)(jhcTtsEngine::Now() - t0);
+  if ((jhcTtsEngine::Now() - t0) >= (unsigned long) tts.wait)
+    return -2.0;                                     // synthesis timed out
+  return -1.0;                                       // finished speaking directly
+}
+
+
+//= Time each phrase the first time (synthesis) and again (from cache).
+// phrases are cut off once started so timing is not affected by length
+
+static void time_tts (int show)
+{
+#ifdef SPIO_ESPEAK
+  jhcTtsEspeak tts;
+#else
+  jhcTtsSapi tts;
+#endif
+  unsigned long t0;
+  double v;
+  int i, nc = 0, nw = 0, direct = 0, fail = 0;
+
+  if (tts.Init() <= 0)
+  {
+    printf("\nText to speech: could not start engine\n");
+    return;
+  }
+  for (i = 0; i < np; i++)
+  {
+    // new phrase
+    if ((v = first_audio(tts, phrase[i])) >= 0.0)
+      cold[nc++] = v;
+    else if (v > -2.0)
+      direct++;
+    else
+      fail++;
+    if (show > 0)
+      printf("  cold %4.0f ms: %s\n", v, phrase[i]);
+
+    // wait for synthesis to finish then repeat
+    tts.Say(NULL);
+    t0 = jhcTtsEngine::Now();
+    while ((tts.Status() > 0) || ((tts.Cached() <= i) && ((jhcTtsEngine::Now() - t0) < (unsigned long) tts.wait)))
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if ((v = first_audio(tts, phrase[i])) >= 0.0)
+      warm[nw++] = v;
+    else
+      fail++;
+    if (show > 0)
+      printf("  warm %4.0f ms: %s\n", v, phrase[i]);
+    tts.Say(NULL);
+  }
+  tts.Done();
+
+  // summarize results
+  printf("\nText to speech: %d phrases (%d direct, %d failed)\n", np, direct, fail);
+  header();
+  report("synth", cold, nc);
+  report("cached", warm, nw);
+}
+
+
+//= Load default clips named (one per line) in playlist file of some directory.
+// returns number of clips added
+
+static int add_fixtures (jhcAudioFile& src, const char *dir)
+{
+  char line[200], fn[500];
+  FILE *in;
+  int n, cnt = 0;
+
+  snprintf(fn, 500, "%s/playlist.txt", dir);
+  if ((in = fopen(fn, "r")) == NULL)
+    return 0;
+  while (fgets(line, 200, in) != NULL)
+  {
+    n = (int) strlen(line);
+    while ((n > 0) && isspace((unsigned char) line[n - 1]))
+      line[--n] = '\0';
+    if ((n <= 0) || (*line == '#'))
+      continue;
+    snprintf(fn, 500, "%s/%s", dir, line);
+    if (src.Add(fn) > 0)
+      cnt++;
+    else
+      printf("Could not load: %s\n", fn);
+  }
+  fclose(in);
+  return cnt;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//                             Main Program                              //
+///////////////////////////////////////////////////////////////////////////
+
+//= Latency benchmark for speech pipeline using WAV fixtures.
+// usage: spio_bench [options] file1.wav file2.wav ...
+// plays the clips listed in fixtures/playlist.txt if no files given
+//   -r <n>      times through playlist (default 10)
+//   -g <ms>     silence before each clip (default 1500)
+//   -c <ms>     fixed decode time of stand-in recognizer (default 150)
+//   -f <x>      extra decode time per ms of speech (default 0.1)
+//   -e <ms>     endpoint silence for every utterance (default VAD setting)
+//   -p <ms>     result polling period (default 33 like control loop)
+//   -w <name>   gate recognition with robot name (transcripts via foo.txt)
+//   -t          also time text to speech
+//   -v          print each result
+//   -d <dir>    directory with playlist.txt of default clips (default "fixtures")
+
+int main (int argc, char *argv[])
+{
+  jhcAudioFile src;
+  char spec[80];
+  const char *rname = NULL, *fdir = "fixtures";
+  double rtf = 0.1;
+  int i, cost = 150, hang = 0, poll = 33, tts = 0, show = 0, nf = 0, rc = 0;
+
+  // parse options
+  src.reps = 10;
+  for (i = 1; i < argc; i++)
+    if ((argv[i][0] != '-') || (argv[i][1] == '\0'))
+    {
+      if (src.Add(argv[i]) <= 0)
+        printf("Could not load: %s\n", argv[i]);
+      nf++;
+    }
+    else if (argv[i][1] == 't')
+      tts = 1;
+    else if (argv[i][1] == 'v')
+      show = 1;
+    else if (++i >= argc)
+      break;
+    else if (argv[i - 1][1] == 'r')
+      src.reps = atoi(argv[i]);
+    else if (argv[i - 1][1] == 'g')
+      src.gap = atoi(argv[i]);
+    else if (argv[i - 1][1] == 'c')
+      cost = atoi(argv[i]);
+    else if (argv[i - 1][1] == 'f')
+      rtf = atof(argv[i]);
+    else if (argv[i - 1][1] == 'e')
+      hang = atoi(argv[i]);
+    else if (argv[i - 1][1] == 'p')
+      poll = atoi(argv[i]);
+    else if (argv[i - 1][1] == 'w')
+      rname = argv[i];
+    else if (argv[i - 1][1] == 'd')
+      fdir = argv[i];
+  if (nf <= 0)
+    add_fixtures(src, fdir);
+  if ((src.Clips() <= 0) && (tts <= 0))
+  {
+    printf("Usage: spio_bench [-r reps] [-g gap] [-c cost] [-f rtf] [-e hang] [-p poll]\n");
+    printf("                  [-w name] [-t] [-v] [-d dir] file1.wav file2.wav ...\n");
+    return 0;
+  }
+
+  // recognition timing (file source paced with 1 ms sleeps)
+#ifndef __linux__
+  timeBeginPeriod(1);
+#endif
+  if (src.Clips() > 0)
+  {
+    printf("Playing %d clips x %d in real time ...\n", src.Clips(), src.reps);
+    snprintf(spec, 80, "stub %d %g", cost, rtf);
+    if (time_reco(src, spec, ((poll > 0) ? poll : 1), hang, rname, show) <= 0)
+      rc = 1;
+  }
+
+  // speech output timing
+  if (tts > 0)
+  {
+#ifndef __linux__
+    CoInitialize(NULL);
+#endif
+    time_tts(show);
+#ifndef __linux__
+    CoUninitialize();
+#endif
+  }
+#ifndef __linux__
+  timeEndPeriod(1);
+#endif
+  return rc;
+}
@@ -1,4 +1,4 @@
-// spio_win.cpp : online Azure speech recognition and local Windows TTS
+// spio_win.cpp : pluggable speech recognition and local Windows TTS
 //
 // Written by Jonathan H. Connell, jconnell@alum.mit.edu
 //
@@ -20,19 +20,41 @@
 // 
 ///////////////////////////////////////////////////////////////////////////
 
-// NOTE: must install NuGet package "Microsoft.CognitiveServices.Speech" as described at
-// https://learn.microsoft.com/en-us/azure/ai-services/speech-service/quickstarts/setup-platform
-
-#include <combaseapi.h>
-#include <mmdeviceapi.h>
-#include <endpointvolume.h>
-#include <speechapi_cxx.h>
-#include <sapi.h>
+// NOTE: Azure backend needs NuGet package "Microsoft.CognitiveServices.Speech"
+// local backend needs whisper.cpp (always used under Linux, see jhcRecoLocal)
+// TTS uses SAPI under Windows and espeak-ng under Linux (see jhcTtsEspeak)
+// Linux build: g++ -shared -fPIC -O2 -DSPIOWIN_EXPORTS -I../shared spio_win.cpp jhcReco*.cpp
+//   jhcAudioIn.cpp jhcEchoCancel.cpp jhcUttQ.cpp jhcVAD.cpp jhcAudioOut.cpp jhcTtsClip.cpp jhcTtsCache.cpp
+//   jhcTtsEngine.cpp jhcTtsEspeak.cpp -o libspio_win.so -lwhisper -lespeak-ng -lasound -lpthread
+
+#ifdef __linux__
+  #include <ctype.h>
+  #include <stdio.h>
+  #include <string.h>
+
+  // stand-ins for Windows types and bounds-checked string functions
+  typedef int BOOL;
+  #define TRUE 1
+  #define strcat_s(dst, src)      strncat(dst, src, sizeof(dst) - strlen(dst) - 1)
+  #define strncat_s(dst, src, n)  strncat(dst, src, n)
+  #define sprintf_s               snprintf
+  #define fopen_s(pf, fn, mode)   ((*(pf) = fopen(fn, mode)) == NULL)
+#else
+  #include <combaseapi.h>
+  #include <mmdeviceapi.h>
+  #include <endpointvolume.h>
+  #include <sapi.h>
+
+  #include "jhcRecoAzure.h"
+  #include "jhcTtsSapi.h"
+#endif
+
+#include "jhcRecoFix.h"
+#include "jhcRecoLocal.h"
+#include "jhcTtsEspeak.h"
 
 #include "spio_win.h"
 
-using namespace Microsoft::CognitiveServices::Speech;
-
 
 // Local function prototypes
 
@@ -45,34 +67,28 @@ void next_chunk ();
 //                          Global Variables                             //
 ///////////////////////////////////////////////////////////////////////////
 
-//= Local Windows Text-to-Speech engine.
-
-static ISpVoice *voice = NULL;
-
+//= Text-to-speech backend (with phrase cache).
 
-//= Microsoft Azure speech recognizer instance.
+static jhcTtsEngine *tts = NULL;
 
-static std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> svc = NULL;
 
+#ifndef __linux__
 
-//= Special phrase list for adding people's names.
-
-static std::shared_ptr<Microsoft::CognitiveServices::Speech::PhraseListGrammar> vocab = NULL;
-
+//= COM object for controlling microphone muting.
 
-//= Interface for determining if internet connection is working.
+static IAudioEndpointVolume *mic = NULL;
 
-static std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> net = NULL;
+#endif
 
 
-//= COM object for controlling microphone muting.
+//= Speech recognition backend (Azure or local).
 
-static IAudioEndpointVolume *mic = NULL;
+static jhcRecoEngine *eng = NULL;
 
 
-//= Whether to print partial recognition results.
+//= Corrections for commonly misheard words.
 
-static int show = 0;
+static jhcRecoFix fix;
 
 
 //= Microphone muting status.
@@ -80,7 +96,7 @@ static int show = 0;
 static int deaf = 0;
 
 
-//= Most recent status from recognizer.
+//= Whether chunks of last result remain to be harvested.
 
 static int reco = 0;
 
@@ -90,11 +106,21 @@ static int reco = 0;
 static char heard[500];
 
 
-//= Result duration plus endpoint silence (ms);
+//= Time since speech onset when result was taken (ms).
 
 static int delay = 0;
 
 
+//= Recognizer confidence in most recent result (0-1).
+
+static float conf = 1.0f;
+
+
+//= Latest partial recognition hypothesis.
+
+static char part[500] = "";
+
+
 //= Run-on utterance chunking variables.
 
 static char blob[500] = "";
@@ -105,6 +131,43 @@ static const char *read = blob;
 //                            Initialization                             //
 ///////////////////////////////////////////////////////////////////////////
 
+#ifdef __linux__
+
+//= Shared library load and unload.
+
+__attribute__((constructor)) static void lib_load () {init();}
+__attribute__((destructor))  static void lib_free () {shutdown();}
+
+
+//= Do all system initializations.
+
+BOOL init ()
+{
+  // get a TTS engine
+#ifdef SPIO_ESPEAK
+  tts = new jhcTtsEspeak;
+  if (tts->Init() <= 0)
+  {
+    delete tts;
+    tts = NULL;
+  }
+#endif
+  return TRUE;
+}
+
+
+//= Do all clean up activities.
+
+BOOL shutdown ()
+{
+  spio_done();
+  delete tts;
+  tts = NULL;
+  return TRUE;
+}
+
+#else
+
 //= DLL entry point.
 
 BOOL APIENTRY DllMain (HANDLE hModule,
@@ -143,7 +206,8 @@ BOOL init ()
   }
 
   // get a TTS engine
-  CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, IID_ISpVoice, (void **)(&voice));
+  tts = new jhcTtsSapi;
+  tts->Init();
   return TRUE;
 }
 
@@ -158,14 +222,16 @@ BOOL shutdown ()
   // get rid of mic control and TTS engine
   if (mic != NULL)
     mic->Release();
-  if (voice != NULL)
-    voice->Release();
+  delete tts;
+  tts = NULL;
 
   // release COM
   CoUninitialize();
   return TRUE;
 }
 
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////
 //                             Main Functions                            //
@@ -173,96 +239,64 @@ BOOL shutdown ()
 
 //= Start recognizing speech and enable TTS output.
 // path is home dir for files, prog > 0 prints partial recognitions
-// reads required key and area from file:    config/spio_win.key
+// reads required backend spec from file:    config/spio_win.key
+//   Azure = "<key> <region>", local = "local <model file>" (always local for Linux)
 // optionally reads special names from file: config/all_names.txt
 // returns 1 if successful, 0 if cannot connect, neg for bad credentials
 // NOTE: meant to be called only once at beginning of program
 
 extern "C" DEXP int spio_start (const char *path, int prog)
 {
-  std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> cfg;
-  char fn[200], name[80], key[80] = "", reg[40] = "";
+  char fn[200], line[200], spec[200] = "";
   FILE *in;
-  int i, n;
+  int n, rc;
 
   // can only be called once
-  if (svc != NULL)
+  if (eng != NULL)
     return -4;
-  show = prog;
 
-  // read Azure web credentials from file and check format
-  sprintf_s(fn, "%s/config/spio_win.key", ((path == NULL) ? "." : path));
+  // read backend specification from file (all lines joined)
+  sprintf_s(fn, 200, "%s/config/spio_win.key", ((path == NULL) ? "." : path));
   if (fopen_s(&in, fn, "r") != 0)
     return -3;                                                 // bad file
-  fscanf_s(in, "%s %s", key, 80, reg, 40);
+  while (fgets(line, 200, in) != NULL)
+  {
+    if ((n = (int) strlen(line)) > 0)
+      if (line[n - 1] == '\n')
+        line[n - 1] = ' ';
+    strcat_s(spec, line);
+  }
   fclose(in);
-  if (((int) strlen(key) != 32) || (*reg == '\0'))             
+
+  // compile corrections for misheard words
+  fix.Load(path);
+
+  // pick backend
+#ifdef SPIO_LOCAL
+  if (strncmp(spec, "local", 5) == 0)
+    eng = new jhcRecoLocal;
+#endif
+#ifndef __linux__
+  if (eng == NULL)
+    eng = new jhcRecoAzure;
+#endif
+  if (eng == NULL)
     return -2;                                                 // bad format
-  for (i = 0; i < 32; i++)
-    if (isxdigit(key[i]) == 0)
-      return -2;                                               // bad format
-
-  // create instance of recognizer based on credentials
-  if ((cfg = SpeechConfig::FromSubscription(key, reg)) == NULL)
-    return -1;                                                 // invalid credentials
-  cfg->SetProfanity(ProfanityOption::Raw);
-  cfg->SetProperty(PropertyId::Speech_SegmentationSilenceTimeoutMs, "500");
-  if ((svc = SpeechRecognizer::FromConfig(cfg)) == NULL)
-    return 0;                                                  // no internet?
-
-  // add proper spellings of names from file: config/all_names.txt
-  vocab = PhraseListGrammar::FromRecognizer(svc);       
-  sprintf_s(fn, "%s/config/all_names.txt", ((path == NULL) ? "." : path));
-  if (fopen_s(&in, fn, "r") == 0)
+
+  // synthesize stock phrases in background and cancel their echo
+  if (tts != NULL)
   {
-    while (fgets(name, 80, in) != NULL)
-      if ((n = (int) strlen(name)) > 0)
-      {
-        name[n - 1] = '\0';
-        vocab->AddPhrase(name);                        // limit of 1024
-      }
-    fclose(in);
+    tts->Prewarm(path);
+    eng->Echo(tts->Speaker());
   }
 
-  // ---------------------------------------------------------------------------
-  // CALLBACK: for partial result
-  svc->Recognizing.Connect([] (const SpeechRecognitionEventArgs& e)
-  {
-    if (show > 0)
-      printf("  %s ...\n", (e.Result->Text).data());
-    reco = 1;                                                  // speaking
-  });
-
-  // ---------------------------------------------------------------------------
-  // CALLBACK: for final result
-  svc->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
+  // start recognition (also loads names)
+  if ((rc = eng->Start(path, spec, prog)) <= 0)
   {
-    if (e.Result->Reason == ResultReason::RecognizedSpeech)
-    {
-      const char *res = (e.Result->Text).data(); 
-      if ((*res != '\0') && (strcmp(res, "Hey, Cortana.") != 0))      // quirk
-      {
-        delay = (int)(0.0001 * e.Result->Duration());
-        strcpy_s(blob, res); 
-        read = blob;
-        reco = 2;
-      }
-    }
-    else if (e.Result->Reason == ResultReason::NoMatch)
-      reco = -1;                                               // unintelligible
-  });
-
-  // ---------------------------------------------------------------------------
-  // CALLBACK: for network monitoring
-  if ((net = Connection::FromRecognizer(svc)) != NULL)
-    net->Disconnected.Connect([] (const ConnectionEventArgs& e)
-    {
-      reco = -2;                                               // lost network
-    });
-
-  // start processing speech input right now
-  svc->StartContinuousRecognitionAsync().get();
-  return 1;
+    delete eng;
+    eng = NULL;
+  }
+  return rc;
 }
 
 
@@ -271,24 +305,60 @@ extern "C" DEXP int spio_start (const char *path, int prog)
 
 extern "C" DEXP int reco_name (const char *name)
 {
-  if ((svc == NULL) || (vocab == NULL))
+  if (eng == NULL)
     return -1;
-  if ((name == NULL) || (*name == '\0'))
-    return 0;
-  vocab->AddPhrase(name);                        // limit of 1024
-  return 1;
+  return eng->AddName(name);
 }
 
 
 //= Turn microphone on and off (e.g. to prevent TTS transcription).
+// optional for cached phrases since their echo is removed from microphone
 
 extern "C" DEXP void reco_mute (int doit)
 {
   int prev = deaf;
 
   deaf = ((doit > 0) ? 1 : 0);
-  if (deaf != prev)
+  if (deaf == prev)
+    return;
+#ifndef __linux__
+  if (mic != NULL)
     mic->SetMute((deaf > 0), NULL);
+#endif
+  if (eng != NULL)
+    eng->Mute(deaf);
+}
+
+
+//= Set silence (ms) needed to end the next utterance, 0 for default.
+// e.g. short after a yes/no question, long utterances stretch automatically
+
+extern "C" DEXP void reco_endpoint (int ms)
+{
+  if (eng != NULL)
+    eng->Endpoint(ms);
+}
+
+
+//= Only run full recognition after robot is addressed by some part of its name.
+// stays awake for a while after each utterance, or while reco_attn is set
+// call after spio_start, NULL name turns gating off
+// returns 1 if gating active, 0 if engine cannot spot name (always listening)
+
+extern "C" DEXP int reco_wake (const char *rname)
+{
+  if (eng == NULL)
+    return -1;
+  return eng->Wake(rname);
+}
+
+
+//= Keep full recognition running regardless of wake word (e.g. while attending).
+
+extern "C" DEXP void reco_attn (int doit)
+{
+  if (eng != NULL)
+    eng->Attend(doit);
 }
 
 
@@ -297,20 +367,36 @@ extern "C" DEXP void reco_mute (int doit)
 
 extern "C" DEXP int reco_status ()
 {
-  return reco;
+  if (reco >= 2)
+    return reco;                       // chunks remaining
+  if (eng == NULL)
+    return 0;
+  return eng->Status();
 }
 
 
-//= Gives text string of last full recognition result (changes status).
+//= Gives text string of oldest unread recognition result (changes status).
+// backend queues whole utterances so none are lost if caller is slow
+// commonly misheard words are corrected before chunking
 
 extern "C" DEXP const char *reco_heard ()
 {
+  char raw[500];
+
+  // possibly get next result from backend
+  if ((reco < 2) && (eng != NULL))
+    if (eng->Take(raw, 500, delay, &conf) > 0)
+    {
+      fix.Fix(blob, raw, 500);
+      read = blob;
+      reco = 2;
+    }
   next_chunk();
   return heard;
 }
  
 
-//= Gives approximate time (ms) that utterance started before notification.
+//= Gives time (ms) since speech onset when result was harvested.
 
 extern "C" DEXP int reco_delay ()
 {
@@ -318,23 +404,41 @@ extern "C" DEXP int reco_delay ()
 }
 
 
+//= Gives latest partial hypothesis while user is still speaking (empty if none).
+// can also get stability (0-1) based on how long text has remained unchanged
+// sets reco_delay to time since speech onset, text is only valid until next call
+
+extern "C" DEXP const char *reco_partial (float *stab)
+{
+  char raw[500];
+  float s = 0.0f;
+
+  *part = '\0';
+  if (eng != NULL)
+    if (eng->Partial(raw, 500, s, delay) > 0)
+      fix.Fix(part, raw, 500);
+  if (stab != NULL)
+    *stab = s;
+  return part;
+}
+
+
+//= Gives recognizer confidence (0-1) in most recent full result.
+
+extern "C" DEXP float reco_conf ()
+{
+  return conf;
+}
+
+
 //= Start speaking some message, overriding any current one (never blocks).
 // returns 1 if successful, 0 or negative for some error
 
 extern "C" DEXP int tts_say (const char *msg)
 {
-  WCHAR wide[200];
-
-  // stop any talking currently in progress
-  voice->Speak(NULL, SPF_PURGEBEFORESPEAK, NULL);
-  if ((msg == NULL) || (*msg == '\0'))
-    return 1;
-
-  // start speaking new message
-  MultiByteToWideChar(CP_UTF8, 0, msg, -1, wide, 200);
-  if (FAILED(voice->Speak(wide, SPF_ASYNC, NULL)))
-    return 0;
-  return 1;
+  if (tts == NULL)
+    return -1;
+  return tts->Say(msg);
 }
 
 
@@ -343,13 +447,29 @@ extern "C" DEXP int tts_say (const char *msg)
 
 extern "C" DEXP int tts_status ()
 {
-  SPVOICESTATUS info;
+  if (tts == NULL)
+    return 0;
+  return tts->Status();
+}
 
-  if (FAILED(voice->GetStatus(&info, NULL)))
-    return -1;
-  if (info.dwRunningState == SPRS_DONE)
+
+//= Get mouth shape timeline for current utterance so caller can schedule it locally.
+// ms gets start time of each viseme, vis gets SAPI viseme numbers (0 = silence)
+// len is total length and ago is time since playback started (both ms)
+// returns number of visemes, 0 if not talking, -1 if unknown (poll tts_status instead)
+
+extern "C" DEXP int tts_timeline (int *ms, int *vis, int vmax, int *len, int *ago)
+{
+  int n, total, since;
+
+  if (tts == NULL)
     return 0;
-  return(info.VisemeId + 1);
+  n = tts->Timeline(ms, vis, vmax, total, since);
+  if (len != NULL)
+    *len = total;
+  if (ago != NULL)
+    *ago = since;
+  return n;
 }
 
 
@@ -361,15 +481,14 @@ extern "C" DEXP void spio_done ()
   tts_say();
   reco_mute(0);
 
-  // stop online speech recognition and clear results
-  if (svc != NULL)
-    svc->StopContinuousRecognitionAsync().get();
+  // stop speech recognition and clear results
+  if (eng != NULL)
+  {
+    eng->Stop();
+    delete eng;
+  }
+  eng = NULL;
   reco = 0;
-
-  // smart pointer release
-  vocab = NULL;    
-  net = NULL;      
-  svc = NULL;      
 }
 
 
@@ -406,22 +525,6 @@ void next_chunk ()
     }
     n = (int)(end - read);
 
-    // possibly expand "Dr" to "drive" (not if "Dr. Jones")
-    if ((n >= 2) && (strncmp(end - 2, "Dr", 2) == 0))   
-      if ((end[1] != ' ') || !isupper(end[2]) || (strchr("FB", end[2]) != NULL))       
-      {
-        // copy string without "Dr" then add replacement
-        strncat_s(heard, read, n - 2);  
-        strcat_s(heard, "drive");
-        if (end[1] == '\0')             // end of blob
-          strcat_s(heard, ".");         
-
-        // keep scanning after any trailing space
-        read = end + 1;
-        scan = read;
-        continue;
-      }
-
     // check for allowable abbreviations
     for (i = 0; i < 6; i++)
       if ((bk = (int) strlen(abbr[i])) <= n)
@@ -127,15 +127,17 @@ extern "C" DEXP int ocv_info (int& iw, int& ih, double& fps)
 //   r4f = r^4 lens radial distortion x 10^12 (pixel coords)
 //   mag = overall magnification after correction
 //   asp = width/length of individual pixel (if not square)
+//   dx, dy = lens center offset from middle of raw image (pixels)
+// lens center always ends up in middle of corrected image
 // NOTE: needs to know image size before building transform
  
-extern "C" DEXP void ocv_warp (double r2f, double r4f, double mag, double asp)
+extern "C" DEXP void ocv_warp (double r2f, double r4f, double mag, double asp, double dx, double dy)
 {
   cv::Size sz = img.size(); 
   int iw = sz.width, ih = sz.height, xlim = iw - 1, ylim = ih - 1, ln = 3 * iw;
   int x, y, ix, iy, fx, fy;
   double f2 = r2f * 1e-6, f4 = r4f * 1e-12, ysc = 1.0 / mag, xsc = asp * ysc;
-  double dx, dy, dy2, r2, r4, warp, wx, wy, x0 = 0.5 * xlim, y0 = 0.5 * ylim;
+  double ox, oy, oy2, r2, r4, warp, wx, wy, x0 = 0.5 * xlim, y0 = 0.5 * ylim;
   unsigned long *b;
   unsigned short *m;
 
@@ -148,7 +150,7 @@ extern "C" DEXP void ocv_warp (double r2f, double r4f, double mag, double asp)
 
   // make new cached value arrays if needed (and possible)
   if ((mag <= 0.0) || (iw <= 0) || (ih <= 0) ||
-      ((mag == 1.0) && (r2f == 0.0) && (r4f == 0.0)))
+      ((mag == 1.0) && (r2f == 0.0) && (r4f == 0.0) && (dx == 0.0) && (dy == 0.0)))
     return;
   npel = iw * ih;
   base = new unsigned long [4 * npel];
@@ -160,19 +162,19 @@ extern "C" DEXP void ocv_warp (double r2f, double r4f, double mag, double asp)
   for (y = 0; y < ih; y++)
   {
     // get central offset adjusted for pixel aspect ratio
-    dy = ysc * (y - y0);
-    dy2 = dy * dy;
+    oy = ysc * (y - y0);
+    oy2 = oy * oy;
     for (x = 0; x < iw; x++, b++, m++)
     {
       // compute radial offset from center
-      dx = xsc * (x - x0);
-      r2 = dx * dx + dy2;
+      ox = xsc * (x - x0);
+      r2 = ox * ox + oy2;
       r4 = r2 * r2;
 
-      // determine lens warped coordinates
+      // determine lens warped coordinates (wrt true lens center)
       warp = 1.0 + f2 * r2 + f4 * r4;
-      wx = x0 + warp * dx;
-      wy = y0 + warp * dy;
+      wx = x0 + dx + warp * ox;
+      wy = y0 + dy + warp * oy;
 
       // check for valid input pixel location
       if ((wx < 0.0) || (wx >= xlim) || (wy < 0.0) || (wy >= ylim))